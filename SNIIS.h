@@ -16,6 +16,10 @@
 #include <ctime>
 #include <cstdint>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <cstddef>
 
 /// -------------------------------------------------------------------------------------------------------------------
 #if defined(_WIN32) || defined(USE_WINE)
@@ -32,6 +36,11 @@
 
 namespace SNIIS
 {
+class InputSystem;
+class InputRecorder;
+class InputReplay;
+class InputTracer;
+
 /// -------------------------------------------------------------------------------------------------------------------
 /// Keyboard scan codes
 enum KeyCode
@@ -202,6 +211,221 @@ struct KeyRepeatCfg
   KeyRepeatCfg() { enable = true; delay = 0.7f; interval = 0.1f; }
 };
 
+/// -------------------------------------------------------------------------------------------------------------------
+/// Memory interface. Implement it and pass it in InitOptions to have SNIIS take its memory from your arena or pool.
+/// Free() gets the same size that was passed to Allocate(). Allocate() may throw or return Null if it's out of memory.
+class Allocator
+{
+  friend void* AllocateMemory( Allocator* alloc, size_t size, size_t alignment);
+  friend void FreeMemory( Allocator* alloc, void* ptr, size_t size) noexcept;
+  std::atomic<size_t> mAllocatedBytes; ///< bytes SNIIS currently holds from this allocator
+
+public:
+  Allocator() noexcept : mAllocatedBytes( 0) { }
+  Allocator( const Allocator&) noexcept : mAllocatedBytes( 0) { }
+  Allocator& operator = ( const Allocator&) noexcept { return *this; }
+  virtual ~Allocator() { }
+  virtual void* Allocate( size_t size, size_t alignment) = 0;
+  virtual void Free( void* ptr, size_t size) noexcept = 0;
+
+  /// Returns the number of bytes SNIIS currently holds from this allocator
+  size_t GetAllocatedBytes() const noexcept { return mAllocatedBytes.load( std::memory_order_relaxed); }
+};
+
+/// Allocator for new allocations on the current thread, or Null for the default heap. Each InputSystem installs its
+/// own while it creates objects, so several systems with different allocators can coexist.
+extern thread_local Allocator* gAllocator;
+
+/// Memory functions used for everything SNIIS allocates, except for the containers exposed in the public API as
+/// std::vector - the device list and the sources of a channel - which stay on the default heap and aren't counted.
+/// A Null allocator means the default heap. Memory is always returned to the allocator it came from.
+void* AllocateMemory( Allocator* alloc, size_t size, size_t alignment);
+void FreeMemory( Allocator* alloc, void* ptr, size_t size) noexcept;
+/// Same for single objects: the allocator is stored alongside, so the object can be freed from anywhere
+void* AllocateObject( size_t size);
+void FreeObject( void* ptr) noexcept;
+/// Returns the number of bytes currently allocated by SNIIS, no matter through which allocator
+size_t GetAllocatedBytes() noexcept;
+/// Returns the number of bytes SNIIS currently holds from the default heap
+size_t GetHeapAllocatedBytes() noexcept;
+
+/// Standard library allocator on top of the SNIIS memory functions. It sticks to the allocator which was current when
+/// it was created, so containers created before initialization keep using the heap.
+template <typename T>
+struct StlAllocator
+{
+  typedef T value_type;
+  Allocator* mAlloc;
+
+  StlAllocator() noexcept : mAlloc( gAllocator) { }
+  template <typename U> StlAllocator( const StlAllocator<U>& other) noexcept : mAlloc( other.mAlloc) { }
+  T* allocate( size_t n) { return static_cast<T*> (AllocateMemory( mAlloc, n * sizeof( T), alignof( T))); }
+  void deallocate( T* ptr, size_t n) noexcept { FreeMemory( mAlloc, ptr, n * sizeof( T)); }
+  template <typename U> bool operator == ( const StlAllocator<U>& other) const noexcept { return mAlloc == other.mAlloc; }
+  template <typename U> bool operator != ( const StlAllocator<U>& other) const noexcept { return mAlloc != other.mAlloc; }
+};
+
+template <typename T> using Vector = std::vector<T, StlAllocator<T>>;
+template <typename K, typename V> using Map = std::map<K, V, std::less<K>, StlAllocator<std::pair<const K, V>>>;
+
+/// Class-level allocation for the objects SNIIS creates, so that those end up in SNIIS memory as well
+#define SNIIS_CLASS_ALLOCATION \
+  static void* operator new( size_t size) { return SNIIS::AllocateObject( size); } \
+  static void operator delete( void* ptr) noexcept { SNIIS::FreeObject( ptr); }
+
+/// Options for InputSystem::Initialize() and InputSystem::Create()
+struct InitOptions
+{
+  Allocator* mAllocator; ///< where SNIIS takes its memory from. Null for the default heap. Must outlive the system.
+  /// Also use devices which only exist to inject synthetic input, like the XTEST devices on X11. Those are ignored by
+  /// default because they'd show up as an extra mouse and keyboard on every X server. Enable it to drive SNIIS with
+  /// injected input, for example in automated tests against a virtual X server.
+  bool mUseSyntheticDevices;
+
+  InitOptions() { mAllocator = nullptr; mUseSyntheticDevices = false; }
+};
+
+/// Time spent in each phase of creating an input system, in microseconds. Phases a backend doesn't have stay zero.
+struct StartupTimings
+{
+  uint64_t mConnect; ///< connecting to the OS: opening the X display and querying its extensions, creating DirectInput
+  uint64_t mDeviceEnumeration; ///< listing the mice and keyboards and registering for their input
+  uint64_t mKeyboardTables; ///< building the key translation tables of all keyboards
+  uint64_t mControllerProbing; ///< finding and opening controllers
+  uint64_t mTotal; ///< everything, including the phases above
+
+  StartupTimings() { mConnect = mDeviceEnumeration = mKeyboardTables = mControllerProbing = mTotal = 0; }
+};
+
+/// Counters of the work done by the last Update(), see InputSystem::SetUpdateStatsEnabled(). Each backend counts what
+/// it has, the rest stays zero.
+struct UpdateStats
+{
+  /// Levels of InputHandler calls: the device specific ones like OnKey(), then OnDigitalEvent() / OnAnalogEvent(), then
+  /// the channels
+  enum HandlerLayer { Layer_Device, Layer_Generic, Layer_Channel, Layer_Count };
+  /// Stages of an Update()
+  enum Stage
+  {
+    Stage_Reset, ///< key repetition and resetting last frame's transition counts and channel modifications
+    Stage_StartUpdate, ///< devices reading their own input, e.g. controllers reading their evdev files
+    Stage_Pump, ///< processing the OS event queue, e.g. the X events, or the input fed to a VirtualInput
+    Stage_EndUpdate, ///< devices finishing the update, e.g. mice signalling their accumulated movement
+    Stage_Finish, ///< collecting the button edges, recording and publishing the frame
+    Stage_Count
+  };
+
+  uint64_t mOsEvents; ///< events taken from the OS event queue
+  uint64_t mDeviceEvents; ///< events read from device files
+  uint64_t mSyscalls; ///< calls to the OS to fetch input: device file reads, X event queue polls
+  uint64_t mHandlerCalls[Layer_Count];
+  uint64_t mChannelsEvaluated; ///< channels recomputed because one of their sources changed
+  uint64_t mStageTime[Stage_Count]; ///< nanoseconds spent in each stage
+
+  UpdateStats() { Clear(); }
+  void Clear()
+  {
+    mOsEvents = mDeviceEvents = mSyscalls = mChannelsEvaluated = 0;
+    std::fill_n( mHandlerCalls, size_t( Layer_Count), uint64_t( 0));
+    std::fill_n( mStageTime, size_t( Stage_Count), uint64_t( 0));
+  }
+};
+
+/// Kinds of devices, for statistics which are kept per kind
+enum DeviceKind { DeviceKind_Mouse, DeviceKind_Keyboard, DeviceKind_Joystick, DeviceKind_Count };
+/// Where an input latency is measured to, see InputSystem::SetLatencyTrackingEnabled()
+enum LatencyStage
+{
+  Latency_Dispatch, ///< the input being signalled to the handler, the event queue and the channels
+  Latency_UpdateEnd, ///< the end of the Update() which signalled the input
+  Latency_Count
+};
+
+/// How controllers which send their input in reports deliver it, see InputSystem::SetReportMode()
+enum ReportMode
+{
+  Report_Latest, ///< each Update() signals the axes as of the last complete report. Buttons signal every transition.
+  Report_Each ///< every report is signalled on its own, so an axis can be signalled several times per Update()
+};
+
+/// Histogram of latencies in microseconds with fixed buckets: one per microsecond up to 16us, above that four per
+/// power of two up to a second. So percentiles are accurate within 25%, the maximum is exact.
+struct LatencyHistogram
+{
+  static const size_t NumBuckets = 80;
+  uint64_t mCounts[NumBuckets];
+  uint64_t mNumSamples;
+  uint64_t mMax;
+
+  LatencyHistogram() { Clear(); }
+  void Clear() { std::fill_n( mCounts, NumBuckets, uint64_t( 0)); mNumSamples = mMax = 0; }
+  void Add( uint64_t latency);
+
+  uint64_t GetNumSamples() const { return mNumSamples; }
+  uint64_t GetMax() const { return mMax; }
+  /// Returns the latency which the given fraction of samples doesn't exceed, e.g. 0.99 for the p99. Zero without samples.
+  uint64_t GetPercentile( double fraction) const;
+
+  /// Returns the bucket a latency is counted in, and the largest latency counted in a bucket
+  static size_t GetBucket( uint64_t latency);
+  static uint64_t GetBucketLimit( size_t bucket);
+};
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// Read-only view of a contiguous array owned by SNIIS. Only valid until the next call to InputSystem::Update()
+template <typename T>
+struct Span
+{
+  const T* mData; size_t mSize;
+
+  Span() noexcept : mData( nullptr), mSize( 0) { }
+  Span( const T* pData, size_t pSize) noexcept : mData( pData), mSize( pSize) { }
+  const T* begin() const noexcept { return mData; }
+  const T* end() const noexcept { return mData + mSize; }
+  size_t size() const noexcept { return mSize; }
+  bool empty() const noexcept { return mSize == 0; }
+  const T& operator [] (size_t idx) const noexcept { return mData[idx]; }
+};
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// Read-only view of a device's button bits in the state arena. Buttons past the end read as released. Only valid
+/// until the next call to InputSystem::Update()
+struct ButtonBits
+{
+  const uint64_t* mWords; size_t mNumWords;
+
+  ButtonBits() noexcept : mWords( nullptr), mNumWords( 0) { }
+  ButtonBits( const uint64_t* pWords, size_t pNumWords) noexcept : mWords( pWords), mNumWords( pNumWords) { }
+  bool Test( size_t idx) const noexcept { return idx / 64 < mNumWords && (mWords[idx / 64] & (1ull << (idx & 63))) != 0; }
+  bool operator [] (size_t idx) const noexcept { return Test( idx); }
+  /// number of bits in the view, which is the number of buttons rounded up to a multiple of 64
+  size_t size() const noexcept { return mNumWords * 64; }
+  /// returns true if any button is down
+  bool Any() const noexcept { for( size_t a = 0; a < mNumWords; ++a ) if( mWords[a] ) return true; return false; }
+};
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// State of all controls of all devices, packed into a single block of memory. It holds four sections: the button bits
+/// of all devices, the button bits at the start of the frame, all axis values and all axis values at the start of the
+/// frame. Each device owns a range of words in the button sections and a range of floats in the axis sections, in the
+/// order of InputSystem::GetDevices(). Copying the whole input state is a single memcpy of mData.
+struct StateArena
+{
+  Vector<uint64_t> mData;
+  size_t mNumButtonWords; ///< size of each button section in uint64_t
+  size_t mNumAxisSlots; ///< size of each axis section in floats, always even so that everything stays 8-byte-aligned
+
+  StateArena() : mNumButtonWords( 0), mNumAxisSlots( 0) { }
+  uint64_t* Buttons() noexcept { return mData.data(); }
+  const uint64_t* Buttons() const noexcept { return mData.data(); }
+  uint64_t* PrevButtons() noexcept { return mData.data() + mNumButtonWords; }
+  const uint64_t* PrevButtons() const noexcept { return mData.data() + mNumButtonWords; }
+  float* Axes() noexcept { return reinterpret_cast<float*> (mData.data() + 2*mNumButtonWords); }
+  const float* Axes() const noexcept { return reinterpret_cast<const float*> (mData.data() + 2*mNumButtonWords); }
+  float* PrevAxes() noexcept { return Axes() + mNumAxisSlots; }
+  const float* PrevAxes() const noexcept { return Axes() + mNumAxisSlots; }
+};
+
 /// -------------------------------------------------------------------------------------------------------------------
 /// An abstract input device has a number of buttons and axes. You can ask for a human-readable description of it via
 /// the Get*Text() set of functions, but the string will be empty if the operating system does not offer such a text.
@@ -210,39 +434,110 @@ struct KeyRepeatCfg
 class Device
 {
   friend struct InputSystemHelper;
+  friend class InputSystem;
 
 protected:
+  InputSystem* mOwner; ///< the input system this device belongs to, Null until it was added
   size_t mId;   ///< Device ID
   size_t mCount; ///< we're the n-th device of our specific kind
   bool mIsFirstUpdate; ///< true if the device is queried for the first time. First state does not trigger updates to evade devices with perm_on controls
-  bool mIsAssembled; ///< true marks an abstract device that collects the system-wide state of all devices of this kind. Only mice and keyboard have one.
-
+  bool mIsAssembled; ///< true marks an abstract device that collects the system-wide state of all devices of this kind. Only mice and keyboard have one.
+  bool mIsEnabled; ///< false if the application disabled this device. Disabled devices don't signal anything.
+  uint64_t mNumInputDrops; ///< how often the OS lost input of this device, see GetNumInputDrops()
+  Vector<size_t> mPressedButtons, mReleasedButtons; ///< buttons which changed during the last Update()
+  Vector<uint8_t> mPressCounts, mReleaseCounts; ///< transitions per button since the last Update(), saturating
+  Vector<size_t> mCountedButtons; ///< buttons with nonzero counters, so that the reset only touches those
+  StateArena* mArena; ///< where our state lives, or Null until the device was added to the InputSystem
+  size_t mButtonOffset, mNumButtonWords; ///< our range in the button sections of the state arena, in uint64_t
+  size_t mAxisOffset, mNumAxisSlots; ///< our range in the axis sections of the state arena, in floats
+  mutable Vector<char> mNameChars; ///< texts of all buttons and then all axes, zero-terminated, see GetButtonName()
+  mutable Vector<size_t> mNameOffsets; ///< start of each text in mNameChars, empty if not collected yet
+
 public:
-  Device(size_t pId, bool isAssembled) noexcept : mId(pId), mCount( 0), mIsFirstUpdate( true), mIsAssembled( isAssembled) { }
+  Device(size_t pId, bool isAssembled) noexcept : mOwner( nullptr), mId(pId), mCount( 0), mIsFirstUpdate( true), mIsAssembled( isAssembled),
+    mIsEnabled( true), mNumInputDrops( 0), mArena( nullptr), mButtonOffset( 0), mNumButtonWords( 0), mAxisOffset( 0), mNumAxisSlots( 0) { }
   virtual ~Device() { }
+  SNIIS_CLASS_ALLOCATION
 
-  /// ID
+  /// Returns the input system this device belongs to
+  InputSystem* GetSystem() const noexcept { return mOwner; }
+  /// ID
   size_t GetId() const noexcept { return mId; }
   /// Count - our index in the sequence of devices of our kind, zero-based. Like: we're the 0th mouse, or the 2nd controller
   size_t GetCount() const noexcept { return mCount; }
   /// Returns true if this is an abstract device designed to collect all events of all devices of this kind.
   bool IsAssembled() const noexcept { return mIsAssembled; }
+  /// Returns false if the device was disabled by InputSystem::SetDeviceEnabled()
+  bool IsEnabled() const noexcept { return mIsEnabled; }
+  /// Returns how often the OS lost input of this device while it was enabled because we didn't read it in time, see
+  /// InputHandler::OnInputDropped()
+  uint64_t GetNumInputDrops() const noexcept { return mNumInputDrops; }
 
   /// Query controls of that device
   virtual size_t GetNumButtons() const { return 0; }
   virtual std::string GetButtonText(size_t idx) const { SNIIS_UNUSED( idx); return std::string(); }
   virtual size_t GetNumAxes() const { return 0; }
   virtual std::string GetAxisText(size_t idx) const { SNIIS_UNUSED( idx); return std::string(); }
+  /// Same texts, but kept by the device so that asking repeatedly doesn't allocate. The texts of all controls are
+  /// collected on the first call and stay valid until the controls or the keyboard layout change. Not thread-safe.
+  const char* GetButtonName(size_t idx) const;
+  const char* GetAxisName(size_t idx) const;
 
   /// Query current state
-  virtual bool IsButtonDown(size_t idx) const { SNIIS_UNUSED( idx); return false; }
-  virtual bool WasButtonPressed(size_t idx) const { SNIIS_UNUSED( idx); return false; }
-  virtual bool WasButtonReleased(size_t idx) const { SNIIS_UNUSED( idx); return false; }
-  virtual float GetAxisAbsolute(size_t idx) const { SNIIS_UNUSED( idx); return 0.0f; }
-  virtual float GetAxisDifference(size_t idx) const { SNIIS_UNUSED( idx); return 0.0f; }
+  virtual bool IsButtonDown(size_t idx) const { return IsButtonBitSet( idx); }
+  virtual bool WasButtonPressed(size_t idx) const { return IsButtonBitSet( idx) && !WasButtonBitSet( idx); }
+  virtual bool WasButtonReleased(size_t idx) const { return !IsButtonBitSet( idx) && WasButtonBitSet( idx); }
+  virtual float GetAxisAbsolute(size_t idx) const { return GetAxisValue( idx); }
+  virtual float GetAxisDifference(size_t idx) const { return GetAxisValue( idx) - GetPrevAxisValue( idx); }
+
+  /// Direct view of the current state and the state at the start of the frame. Non-virtual and inline, meant for hot
+  /// loops; the virtual queries above give the same results.
+  ButtonBits Buttons() const noexcept { return ButtonBits( mArena ? mArena->Buttons() + mButtonOffset : nullptr, mNumButtonWords); }
+  ButtonBits PrevButtons() const noexcept { return ButtonBits( mArena ? mArena->PrevButtons() + mButtonOffset : nullptr, mNumButtonWords); }
+  Span<float> Axes() const noexcept { return Span<float>( mArena ? mArena->Axes() + mAxisOffset : nullptr, mNumAxisSlots); }
+  Span<float> PrevAxes() const noexcept { return Span<float>( mArena ? mArena->PrevAxes() + mAxisOffset : nullptr, mNumAxisSlots); }
+
+  /// Lists all buttons which went down or up during the last Update(), in ascending order. Iterate these instead of
+  /// asking WasButtonPressed() for every button you're interested in.
+  Span<size_t> GetPressedButtons() const noexcept { return Span<size_t>( mPressedButtons.data(), mPressedButtons.size()); }
+  Span<size_t> GetReleasedButtons() const noexcept { return Span<size_t>( mReleasedButtons.data(), mReleasedButtons.size()); }
+
+  /// Returns how often the button went down or up since the last Update(), capped at 255. Other than WasButtonPressed()
+  /// these also catch quick taps which started and ended between two updates.
+  size_t GetButtonPressCount(size_t idx) const noexcept { return idx < mPressCounts.size() ? mPressCounts[idx] : 0; }
+  size_t GetButtonReleaseCount(size_t idx) const noexcept { return idx < mReleaseCounts.size() ? mReleaseCounts[idx] : 0; }
 
   /// Bookkeeping. Sorry for the public
   void ResetFirstUpdateFlag() { mIsFirstUpdate = false; }
+
+protected:
+  /// Access to our range of the state arena. Controls outside of the range read as zero and ignore writes, which also
+  /// covers the time before the device was added to the InputSystem.
+  bool IsButtonBitSet( size_t idx) const noexcept
+  {
+    return idx / 64 < mNumButtonWords && (mArena->Buttons()[mButtonOffset + idx / 64] & (1ull << (idx & 63))) != 0;
+  }
+  bool WasButtonBitSet( size_t idx) const noexcept
+  {
+    return idx / 64 < mNumButtonWords && (mArena->PrevButtons()[mButtonOffset + idx / 64] & (1ull << (idx & 63))) != 0;
+  }
+  void SetButtonBit( size_t idx, bool set) noexcept { SetBit( mArena ? mArena->Buttons() : nullptr, idx, set); }
+  void SetPrevButtonBit( size_t idx, bool set) noexcept { SetBit( mArena ? mArena->PrevButtons() : nullptr, idx, set); }
+  float GetAxisValue( size_t idx) const noexcept { return idx < mNumAxisSlots ? mArena->Axes()[mAxisOffset + idx] : 0.0f; }
+  float GetPrevAxisValue( size_t idx) const noexcept { return idx < mNumAxisSlots ? mArena->PrevAxes()[mAxisOffset + idx] : 0.0f; }
+  void SetAxisValue( size_t idx, float value) noexcept { if( idx < mNumAxisSlots ) mArena->Axes()[mAxisOffset + idx] = value; }
+  /// Drops the collected control texts, to be called by implementations whose texts change
+  void InvalidateNames() noexcept { mNameOffsets.clear(); }
+
+private:
+  const char* GetName( size_t idx) const;
+  void SetBit( uint64_t* section, size_t idx, bool set) noexcept
+  {
+    if( idx / 64 >= mNumButtonWords )
+      return;
+    uint64_t& word = section[mButtonOffset + idx / 64];
+    word = set ? (word | (1ull << (idx & 63))) : (word & ~(1ull << (idx & 63)));
+  }
 };
 
 /// a mouse is an abstract input device
@@ -266,6 +561,8 @@ public:
   virtual bool IsKeyDown(KeyCode key) const { return IsButtonDown(size_t(key)); }
   virtual bool WasKeyReleased(KeyCode key) const { return WasButtonReleased(size_t(key)); }
   virtual bool WasKeyPressed(KeyCode key) const { return WasButtonPressed(size_t(key)); }
+  size_t GetKeyPressCount(KeyCode key) const noexcept { return GetButtonPressCount(size_t(key)); }
+  size_t GetKeyReleaseCount(KeyCode key) const noexcept { return GetButtonReleaseCount(size_t(key)); }
 };
 
 /// A joystick is also a Device, but a pretty useless one except for the type.
@@ -288,8 +585,10 @@ struct DigitalChannel
 
   /// current state and change since last Update()
   bool mIsPressed, mIsModified;
+  /// number of times the channel switched on or off since last Update(), capped at 255
+  uint8_t mPressCount, mReleaseCount;
 
-  DigitalChannel() { mId = SIZE_MAX; mIsPressed = mIsModified = false; }
+  DigitalChannel() { mId = SIZE_MAX; mIsPressed = mIsModified = false; mPressCount = mReleaseCount = 0; }
   size_t GetId() const { return mId; }
   void AddDigitalSource( size_t pDeviceId, size_t pButtonId);
   void AddAnalogSource( size_t pDeviceId, size_t pAxisId, float pLimit);
@@ -300,7 +599,9 @@ struct DigitalChannel
   bool IsOn() const { return mIsPressed; }
   bool WasSwitchedOn() const { return mIsPressed && mIsModified; }
   bool WasSwitchedOff() const { return !mIsPressed && mIsModified; }
-  void Update() { mIsModified = false; }
+  size_t GetPressCount() const { return mPressCount; }
+  size_t GetReleaseCount() const { return mReleaseCount; }
+  void Update() { mIsModified = false; mPressCount = mReleaseCount = 0; }
 };
 
 /// Analog event channel - zero to multiple event sources connected to an analog input event
@@ -331,6 +632,122 @@ struct AnalogChannel
   void Update() { mDiff = 0.0f; }
 };
 
+/// -------------------------------------------------------------------------------------------------------------------
+/// A discrete input event as recorded in the event queue, see InputSystem::SetEventQueueCapacity()
+enum InputEventKind : uint32_t
+{
+  Event_ButtonDown, ///< a mouse or joystick button went down. mControl is the button index
+  Event_ButtonUp,
+  Event_KeyDown, ///< a key went down. mControl is the KeyCode
+  Event_KeyUp,
+  Event_KeyRepeat, ///< the held key was repeated
+  Event_Text, ///< a character was entered. mControl is the unicode character
+  Event_Axis, ///< a mouse or joystick axis changed. mControl is the axis index, mValue the new absolute value
+  Event_Wheel ///< the mouse wheel was turned. mValue is the amount
+};
+
+struct InputEvent
+{
+  uint32_t mKind; ///< one of InputEventKind
+  uint32_t mDevice; ///< device ID
+  uint32_t mControl;
+  float mValue;
+  uint64_t mTimestamp; ///< microseconds since the InputSystem was created
+};
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// An immutable copy of the complete input state at the end of an InputSystem::Update(): the state arena, this frame's
+/// pressed and released buttons and the values of all channels. Devices are indexed by their ID. Get one through an
+/// InputFrameReader to read input from other threads while the main thread keeps on updating.
+struct InputFrame
+{
+  /// Per device: its ranges in the state arena and in the edge lists
+  struct DeviceRange
+  {
+    size_t mButtonOffset, mNumButtonWords, mAxisOffset, mNumAxes;
+    size_t mFirstPressed, mNumPressed, mFirstReleased, mNumReleased;
+  };
+  struct DigitalState { size_t mId; bool mIsOn, mIsModified; uint8_t mPressCount, mReleaseCount; };
+  struct AnalogState { size_t mId; float mValue, mDiff; };
+
+  uint64_t mUpdateCount; ///< number of the Update() which produced this frame, starting at 1. Zero for an empty frame
+  StateArena mState;
+  Vector<DeviceRange> mDevices;
+  Vector<size_t> mPressedButtons, mReleasedButtons;
+  Vector<DigitalState> mDigitalChannels; ///< sorted by ID
+  Vector<AnalogState> mAnalogChannels; ///< sorted by ID
+
+  InputFrame() : mUpdateCount( 0) { }
+
+  size_t GetNumDevices() const noexcept { return mDevices.size(); }
+  bool IsButtonDown( size_t dev, size_t idx) const noexcept { return TestBit( mState.Buttons(), dev, idx); }
+  bool WasButtonPressed( size_t dev, size_t idx) const noexcept { return IsButtonDown( dev, idx) && !TestBit( mState.PrevButtons(), dev, idx); }
+  bool WasButtonReleased( size_t dev, size_t idx) const noexcept { return !IsButtonDown( dev, idx) && TestBit( mState.PrevButtons(), dev, idx); }
+  float GetAxisAbsolute( size_t dev, size_t idx) const noexcept
+  {
+    return dev < mDevices.size() && idx < mDevices[dev].mNumAxes ? mState.Axes()[mDevices[dev].mAxisOffset + idx] : 0.0f;
+  }
+  float GetAxisDifference( size_t dev, size_t idx) const noexcept
+  {
+    return dev < mDevices.size() && idx < mDevices[dev].mNumAxes ? mState.Axes()[mDevices[dev].mAxisOffset + idx]
+      - mState.PrevAxes()[mDevices[dev].mAxisOffset + idx] : 0.0f;
+  }
+  Span<size_t> GetPressedButtons( size_t dev) const noexcept
+  {
+    return dev < mDevices.size() ? Span<size_t>( mPressedButtons.data() + mDevices[dev].mFirstPressed, mDevices[dev].mNumPressed) : Span<size_t>();
+  }
+  Span<size_t> GetReleasedButtons( size_t dev) const noexcept
+  {
+    return dev < mDevices.size() ? Span<size_t>( mReleasedButtons.data() + mDevices[dev].mFirstReleased, mDevices[dev].mNumReleased) : Span<size_t>();
+  }
+  /// Returns the state of the channel with the given ID, or Null if there's no such channel
+  const DigitalState* GetDigital( size_t id) const noexcept
+  {
+    auto it = std::lower_bound( mDigitalChannels.begin(), mDigitalChannels.end(), id, [](const DigitalState& s, size_t i) { return s.mId < i; });
+    return it != mDigitalChannels.end() && it->mId == id ? &*it : nullptr;
+  }
+  const AnalogState* GetAnalog( size_t id) const noexcept
+  {
+    auto it = std::lower_bound( mAnalogChannels.begin(), mAnalogChannels.end(), id, [](const AnalogState& s, size_t i) { return s.mId < i; });
+    return it != mAnalogChannels.end() && it->mId == id ? &*it : nullptr;
+  }
+
+private:
+  bool TestBit( const uint64_t* section, size_t dev, size_t idx) const noexcept
+  {
+    return dev < mDevices.size() && idx / 64 < mDevices[dev].mNumButtonWords
+      && (section[mDevices[dev].mButtonOffset + idx / 64] & (1ull << (idx & 63))) != 0;
+  }
+};
+
+/// Hands the latest InputFrame to a single reading thread. Every Update() publishes a new frame to all readers through a
+/// lock-free triple buffer: the pump never waits for a reader, and a reader never sees a frame that's still being
+/// written. Create one reader per thread with InputSystem::CreateFrameReader().
+class InputFrameReader
+{
+  friend class InputSystem;
+  friend struct InputSystemHelper;
+
+  InputFrame mFrames[3];
+  std::atomic<uint8_t> mMiddle; ///< index of the buffer between writer and reader, plus FreshFlag if it's not read yet
+  uint8_t mBack; ///< buffer the writer fills next, only touched by the writer
+  uint8_t mFront; ///< buffer the reader currently looks at, only touched by the reader
+  static const uint8_t FreshFlag = 4;
+
+  InputFrameReader() : mMiddle( 1), mBack( 0), mFront( 2) { }
+  SNIIS_CLASS_ALLOCATION
+
+public:
+  /// Returns the latest published frame. It stays unchanged until this reader's next call to Acquire(). If no new frame
+  /// was published since the last call, you get the same frame again.
+  const InputFrame& Acquire() noexcept
+  {
+    if( mMiddle.load( std::memory_order_relaxed) & FreshFlag )
+      mFront = mMiddle.exchange( mFront, std::memory_order_acq_rel) & 3;
+    return mFrames[mFront];
+  }
+};
+
 /// -------------------------------------------------------------------------------------------------------------------
 /// Input handler - implement this interface to be notified about input events from within InputSystem::Update()
 /// Every method can return if it handled the event. If not, it will be converted to the next level of abstraction.
@@ -359,12 +776,23 @@ public:
   virtual bool OnAnalogEvent( Device*, size_t, float) { return false; }
   virtual void OnDigitalChannel( const DigitalChannel&) { }
   virtual void OnAnalogChannel( const AnalogChannel &) { }
+
+  /// Called when the OS lost input of a device because we didn't read it in time. SNIIS then resynchronises the
+  /// device's state and signals the differences, but the presses and releases in between are gone.
+  virtual void OnInputDropped( Device*) { }
+  /// Called when the OS event queue held at least the number of events set by InputSystem::SetOsQueueWarning(), which
+  /// means the application doesn't update often enough and input lags behind. Called once until the high-water mark
+  /// is reset. Gets the number of events found waiting.
+  virtual void OnOsQueueBacklog( size_t) { }
 };
 
 /// -------------------------------------------------------------------------------------------------------------------
 class InputSystem
 {
   friend struct InputSystemHelper;
+  friend class InputRecorder;
+  friend class InputReplay;
+  friend class InputTracer;
 
 protected:
   /// Construction private, use static Initialize() method
@@ -372,12 +800,20 @@ protected:
   virtual ~InputSystem();
 
 public:
+  SNIIS_CLASS_ALLOCATION
+
   /// Initializes the input system with the given InitArgs. When successful, gInstance is not Null.
   /// Windows: pass in your HWND. Linux: pass in your X Window handle. Mac: unused, pass nullptr.
-  static bool Initialize( void* pInitArg);
+  static bool Initialize( void* pInitArg, const InitOptions& pOptions = InitOptions());
   /// Destroys the input system. After returning gInstance is Null again
   static void Shutdown();
 
+  /// Creates an independent input system with the same InitArgs as Initialize(), or returns Null on error. It is not
+  /// put into gInstance, so you can run as many as you like - each one must only be used by one thread at a time.
+  static InputSystem* Create( void* pInitArg, const InitOptions& pOptions = InitOptions());
+  /// Destroys a system created by Create()
+  static void Destroy( InputSystem* system);
+
   /// Updates the inputs, to be called before handling system messages
   virtual void Update();
 
@@ -404,8 +840,77 @@ public:
   InputHandler* GetHandler() const { return mHandler; }
   void SetHandler( InputHandler* handler) { mHandler = handler; }
 
+  /// Enables or disables a device. A disabled device releases all its controls and stops signalling. Where the OS
+  /// allows it, SNIIS also stops listening to the device altogether, so unused devices don't cost anything.
+  void SetDeviceEnabled( Device* dev, bool enabled);
+
   /// Returns all devices currently present
   const std::vector<Device*>& GetDevices() const { return mDevices; }
+  /// Returns the packed state of all devices. Only valid until the next call to Update().
+  const StateArena& GetStateArena() const { return mState; }
+  /// Returns the number of Update() calls so far
+  uint64_t GetUpdateCount() const { return mUpdateCount; }
+  /// Returns the time of the last Update() in microseconds since the system was created. Key repetition runs on this.
+  uint64_t GetTime() const { return mTime; }
+  /// Returns the recorder currently attached, see InputRecorder::Start()
+  InputRecorder* GetRecorder() const { return mRecorder; }
+  /// Returns the tracer currently attached, see InputTracer::Start()
+  InputTracer* GetTracer() const { return mTracer; }
+  /// Returns where the time went while creating the system
+  const StartupTimings& GetStartupTimings() const { return mStartupTimings; }
+  /// Returns the allocator this system takes its memory from, or Null for the default heap, see InitOptions
+  Allocator* GetAllocator() const { return mAllocator; }
+  /// Returns the number of bytes currently held from this system's allocator. Systems sharing an allocator, or all on
+  /// the default heap, share the count; give a system an allocator of its own to see exactly what it uses.
+  size_t GetAllocatedBytes() const;
+  /// Enables counting the work of each Update() into GetUpdateStats(). Off by default, and then counting costs a
+  /// branch here and there.
+  void SetUpdateStatsEnabled( bool enabled) { mIsUpdateStatsEnabled = enabled; mUpdateStats.Clear(); }
+  bool IsUpdateStatsEnabled() const { return mIsUpdateStatsEnabled; }
+  /// Returns the counters of the last Update(), if enabled
+  const UpdateStats& GetUpdateStats() const { return mUpdateStats; }
+  /// Enables measuring the latency of each input from its hardware timestamp to it being signalled, and to the end of
+  /// the Update() signalling it. Needs timestamps on the same clock as ours, so only the Linux backend measures: evdev
+  /// controllers, and mice and keyboards of a local X server. Off by default.
+  void SetLatencyTrackingEnabled( bool enabled) { mIsLatencyTrackingEnabled = enabled; }
+  bool IsLatencyTrackingEnabled() const { return mIsLatencyTrackingEnabled; }
+  /// Returns the latencies measured so far for the given kind of device, in microseconds
+  const LatencyHistogram& GetLatencyHistogram( DeviceKind kind, LatencyStage stage) const { return mLatencies[stage][kind]; }
+  void ClearLatencyHistograms();
+  /// Returns how often the OS lost input of any device, see Device::GetNumInputDrops()
+  uint64_t GetNumInputDrops() const { return mNumInputDrops; }
+  /// Returns the largest number of events found waiting in the OS event queue at once, e.g. the X event queue. It
+  /// grows when the application stalls. Only counts on backends which can tell.
+  size_t GetOsQueueHighWater() const { return mOsQueueHighWater; }
+  void ResetOsQueueHighWater() { mOsQueueHighWater = 0; }
+  /// Sets the OS queue length at which the high-water mark calls InputHandler::OnOsQueueBacklog(), or zero to never
+  /// call it. Zero by default. After the call, ResetOsQueueHighWater() arms it again.
+  void SetOsQueueWarning( size_t threshold) { mOsQueueWarning = threshold; }
+  size_t GetOsQueueWarning() const { return mOsQueueWarning; }
+  /// Sets how controllers deliver their input. A controller sends its state in reports, e.g. both axes of a stick
+  /// together, and SNIIS always applies a report as a whole, so the axes never show half of a movement.
+  /// Report_Latest, the default, signals the state after the last report of each Update(). Report_Each signals every
+  /// report, for high-rate controllers where the movement in between matters. Only Linux controllers send reports.
+  void SetReportMode( ReportMode mode) { mReportMode = mode; }
+  ReportMode GetReportMode() const { return mReportMode; }
+
+  /// Creates a reader to receive an immutable InputFrame after every Update(), for use on another thread. Create and
+  /// destroy readers on the thread that calls Update(); only Acquire() is meant to be called from elsewhere.
+  InputFrameReader* CreateFrameReader();
+  void DestroyFrameReader( InputFrameReader* reader);
+  /// Copies the current state into the given frame. Reuses the frame's memory, so keep frames around.
+  void FillFrame( InputFrame& frame) const;
+
+  /// Event queue: if enabled, all events are recorded in a ring buffer of the given capacity, no matter if the
+  /// InputHandler consumed them. Events which don't fit are dropped and counted. Zero capacity disables the queue, which
+  /// is the default. Changing the capacity discards all queued events.
+  void SetEventQueueCapacity( size_t capacity);
+  /// Moves up to maxCount of the oldest queued events to the given array and returns how many. Whatever didn't fit
+  /// stays queued for the next call.
+  size_t PollEvents( InputEvent* events, size_t maxCount);
+  /// Returns the number of events dropped because the queue was full
+  uint64_t GetDroppedEventCount() const { return mDroppedEvents; }
+
   /// Get the total number of devices of that specific kind
   size_t GetNumMice() const { return mNumMice; }
   size_t GetNumKeyboards() const { return mNumKeyboards; }
@@ -422,18 +927,18 @@ public:
   float GetRelMouseX() const { return mFirstMouse ? mFirstMouse->GetRelMouseX() : 0; }
   float GetRelMouseY() const { return mFirstMouse ? mFirstMouse->GetRelMouseY() : 0; }
 
-  bool IsKeyDown( KeyCode key) const { return mFirstKeyboard ? mFirstKeyboard->IsKeyDown( key) : false; }
-  bool WasKeyReleased( KeyCode key) const { return mFirstKeyboard ? mFirstKeyboard->WasKeyReleased( key) : false; }
-  bool WasKeyPressed( KeyCode key) const { return mFirstKeyboard ? mFirstKeyboard->WasKeyPressed( key) : false; }
+  bool IsKeyDown( KeyCode key) const { return mFirstKeyboard ? IsDown( mFirstKeyboard, key) : false; }
+  bool WasKeyReleased( KeyCode key) const { return mFirstKeyboard ? WasReleased( mFirstKeyboard, key) : false; }
+  bool WasKeyPressed( KeyCode key) const { return mFirstKeyboard ? WasPressed( mFirstKeyboard, key) : false; }
 
-  bool IsMouseDown( size_t btnId) const { return mFirstMouse ? mFirstMouse->IsButtonDown( btnId) : false; }
-  bool WasMouseReleased( size_t btnId) const { return mFirstMouse ? mFirstMouse->WasButtonReleased( btnId) : false; }
-  bool WasMousePressed( size_t btnId) const { return mFirstMouse ? mFirstMouse->WasButtonPressed( btnId) : false; }
+  bool IsMouseDown( size_t btnId) const { return mFirstMouse ? IsDown( mFirstMouse, btnId) : false; }
+  bool WasMouseReleased( size_t btnId) const { return mFirstMouse ? WasReleased( mFirstMouse, btnId) : false; }
+  bool WasMousePressed( size_t btnId) const { return mFirstMouse ? WasPressed( mFirstMouse, btnId) : false; }
   float GetMouseWheelDiff() const { return mFirstMouse ? mFirstMouse->GetAxisAbsolute( 2) : 0.0f; }
 
-  bool IsJoyDown( size_t btnId) const { return mFirstJoystick ? mFirstJoystick->IsButtonDown( btnId) : false; }
-  bool WasJoyReleased( size_t btnId) const { return mFirstJoystick ? mFirstJoystick->WasButtonReleased( btnId) : false; }
-  bool WasJoyPressed( size_t btnId) const { return mFirstJoystick ? mFirstJoystick->WasButtonPressed( btnId) : false; }
+  bool IsJoyDown( size_t btnId) const { return mFirstJoystick ? IsDown( mFirstJoystick, btnId) : false; }
+  bool WasJoyReleased( size_t btnId) const { return mFirstJoystick ? WasReleased( mFirstJoystick, btnId) : false; }
+  bool WasJoyPressed( size_t btnId) const { return mFirstJoystick ? WasPressed( mFirstJoystick, btnId) : false; }
   float GetJoyAxisAbsolute( size_t axisId) const { return mFirstJoystick ? mFirstJoystick->GetAxisAbsolute( axisId) : 0.0f; }
   float GetJoyAxisDifference( size_t axisId) const { return mFirstJoystick ? mFirstJoystick->GetAxisDifference( axisId) : 0.0f; }
 
@@ -456,12 +961,43 @@ public:
   static void Log(const char* msg, ...) noexcept;
 
 protected:
+  /// the comfort functions above test the bits directly instead of going through the virtual queries
+  static bool IsDown( const Device* dev, size_t idx) noexcept { return dev->Buttons().Test( idx); }
+  static bool WasPressed( const Device* dev, size_t idx) noexcept { return dev->Buttons().Test( idx) && !dev->PrevButtons().Test( idx); }
+  static bool WasReleased( const Device* dev, size_t idx) noexcept { return !dev->Buttons().Test( idx) && dev->PrevButtons().Test( idx); }
+
   virtual void InternSetFocus( bool pHasFocus) = 0;
   void InternGrabMouseIfNecessary();
   virtual void InternSetMouseGrab( bool enabled) = 0;
+  virtual void InternSetDeviceEnabled( Device* dev, bool enabled);
+  /// Returns the current time in microseconds since the system was created. Override to run on a different clock.
+  virtual uint64_t ReadClock() const;
 
 protected:
-  std::vector<Device*> mDevices;
+  Allocator* mAllocator; ///< where this system's objects come from, see InitOptions
+  std::vector<Device*> mDevices; ///< public through GetDevices(), so a plain std::vector on the default heap
+  StateArena mState;
+  uint64_t mUpdateCount;
+  uint64_t mTime; ///< ReadClock() at the start of the current Update()
+  InputRecorder* mRecorder;
+  InputTracer* mTracer;
+  Vector<InputFrameReader*> mFrameReaders;
+  Vector<InputEvent> mEvents; ///< ring buffer of the event queue, preallocated to its capacity
+  size_t mFirstEvent, mNumEvents; ///< the queue's range in mEvents
+  uint64_t mDroppedEvents;
+  std::chrono::steady_clock::time_point mStartTime;
+  StartupTimings mStartupTimings; ///< filled in by the backend's constructor
+  UpdateStats mUpdateStats;
+  bool mIsUpdateStatsEnabled;
+  LatencyHistogram mLatencies[Latency_Count][DeviceKind_Count];
+  bool mIsLatencyTrackingEnabled;
+  ReportMode mReportMode;
+  uint64_t mSourceTime; ///< hardware time of the input the backend is about to signal, or zero if unknown
+  struct PendingLatency { uint64_t mSourceTime; DeviceKind mKind; };
+  Vector<PendingLatency> mPendingLatencies; ///< inputs signalled during the current Update(), waiting for its end
+  uint64_t mNumInputDrops;
+  size_t mOsQueueHighWater;
+  size_t mOsQueueWarning; ///< high-water mark to call InputHandler::OnOsQueueBacklog() at, or zero
   Mouse* mFirstMouse; Keyboard* mFirstKeyboard; Joystick* mFirstJoystick;
   size_t mNumMice, mNumKeyboards, mNumJoysticks;
   InputHandler* mHandler;
@@ -470,14 +1006,15 @@ protected:
 
   KeyRepeatCfg mKeyRepeatCfg;
   struct KeyRepeatState {
-    Keyboard* mSender; KeyCode mKeyCode; size_t mUnicodeChar; clock_t lasttick; float mTimeTillRepeat;
+    Keyboard* mSender; KeyCode mKeyCode; size_t mUnicodeChar; uint64_t mLastTime; float mTimeTillRepeat;
   } mKeyRepeatState;
 
-  std::map<size_t, DigitalChannel> mDigitalChannels;
-  std::map<size_t, AnalogChannel> mAnalogChannels;
+  Map<size_t, DigitalChannel> mDigitalChannels;
+  Map<size_t, AnalogChannel> mAnalogChannels;
 };
 
-/// global Instance of the Input System if initialized, or Null
+/// global Instance of the Input System if initialized, or Null. Only the comfort functions of the C interface rely on it,
+/// systems created by InputSystem::Create() work without.
 extern InputSystem* gInstance;
 
 /// Log callback to receive logging messages.
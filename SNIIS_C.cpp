@@ -4,6 +4,7 @@
 
 #include "SNIIS.h"
 #include "SNIIS_C.h"
+#include <cstddef>
 
 // Assigns the log callback to receive occasional log messages. 
 extern "C" void SNIIS_SetLogCallback(LogCallback callback)
@@ -37,3 +38,117 @@ extern "C" void SNIIS_InputSystem_SetFocus( int pFocus)
   if( SNIIS::gInstance )
     SNIIS::gInstance->SetFocus( pFocus != 0);
 }
+
+namespace
+{
+  /// staging frame for the snapshot export, kept around so that its memory is reused
+  SNIIS::InputFrame gSnapshotFrame;
+
+  /// copies as much of the given range as fits and reports whether it did fit
+  template <typename T, typename U>
+  bool CopyOut( T* pDst, uint32_t pCapacity, uint32_t& pNum, const U* pSrc, size_t pCount)
+  {
+    pNum = uint32_t( pCount);
+    if( pDst )
+      std::copy_n( pSrc, std::min<size_t>( pCount, pCapacity), pDst);
+    return pCount <= pCapacity;
+  }
+}
+
+// SNIIS_PollEvents() hands out the C++ events as they are, so the layouts and all event kinds must match exactly
+static_assert( sizeof( SNIIS_Event) == sizeof( SNIIS::InputEvent), "event layouts differ");
+static_assert( offsetof( SNIIS_Event, kind) == offsetof( SNIIS::InputEvent, mKind), "event layouts differ");
+static_assert( offsetof( SNIIS_Event, device) == offsetof( SNIIS::InputEvent, mDevice), "event layouts differ");
+static_assert( offsetof( SNIIS_Event, control) == offsetof( SNIIS::InputEvent, mControl), "event layouts differ");
+static_assert( offsetof( SNIIS_Event, value) == offsetof( SNIIS::InputEvent, mValue), "event layouts differ");
+static_assert( offsetof( SNIIS_Event, timestamp) == offsetof( SNIIS::InputEvent, mTimestamp), "event layouts differ");
+static_assert( int( SNIIS_EVENT_BUTTON_DOWN) == int( SNIIS::Event_ButtonDown), "event kinds differ");
+static_assert( int( SNIIS_EVENT_BUTTON_UP) == int( SNIIS::Event_ButtonUp), "event kinds differ");
+static_assert( int( SNIIS_EVENT_KEY_DOWN) == int( SNIIS::Event_KeyDown), "event kinds differ");
+static_assert( int( SNIIS_EVENT_KEY_UP) == int( SNIIS::Event_KeyUp), "event kinds differ");
+static_assert( int( SNIIS_EVENT_KEY_REPEAT) == int( SNIIS::Event_KeyRepeat), "event kinds differ");
+static_assert( int( SNIIS_EVENT_TEXT) == int( SNIIS::Event_Text), "event kinds differ");
+static_assert( int( SNIIS_EVENT_AXIS) == int( SNIIS::Event_Axis), "event kinds differ");
+static_assert( int( SNIIS_EVENT_WHEEL) == int( SNIIS::Event_Wheel), "event kinds differ");
+
+// Fills the snapshot with the state after the last update
+extern "C" int SNIIS_InputSystem_GetSnapshot( SNIIS_Snapshot* pSnapshot)
+{
+  using namespace SNIIS;
+  if( !gInstance || !pSnapshot || pSnapshot->version != SNIIS_SNAPSHOT_VERSION || pSnapshot->size != sizeof( SNIIS_Snapshot) )
+    return -1;
+
+  auto& s = *pSnapshot;
+  auto& frame = gSnapshotFrame;
+  gInstance->FillFrame( frame);
+  s.updateCount = frame.mUpdateCount;
+  bool fits = true;
+
+  const auto& devices = gInstance->GetDevices();
+  s.numDevices = uint32_t( devices.size());
+  fits &= devices.size() <= s.deviceCapacity;
+  for( size_t a = 0; a < devices.size() && a < s.deviceCapacity && s.devices; ++a )
+  {
+    const Device* dev = devices[a];
+    const auto& r = frame.mDevices[a];
+    auto& d = s.devices[a];
+    d.type = dynamic_cast<const Mouse*> (dev) ? SNIIS_DEVICE_MOUSE : dynamic_cast<const Keyboard*> (dev) ? SNIIS_DEVICE_KEYBOARD
+      : dynamic_cast<const Joystick*> (dev) ? SNIIS_DEVICE_JOYSTICK : SNIIS_DEVICE_UNKNOWN;
+    d.flags = (dev->IsEnabled() ? SNIIS_DEVICEFLAG_ENABLED : 0) | (dev->IsAssembled() ? SNIIS_DEVICEFLAG_ASSEMBLED : 0);
+    d.numButtons = uint32_t( dev->GetNumButtons()); d.numAxes = uint32_t( r.mNumAxes);
+    d.buttonWordOffset = uint32_t( r.mButtonOffset); d.axisOffset = uint32_t( r.mAxisOffset);
+    d.firstPressed = uint32_t( r.mFirstPressed); d.numPressed = uint32_t( r.mNumPressed);
+    d.firstReleased = uint32_t( r.mFirstReleased); d.numReleased = uint32_t( r.mNumReleased);
+  }
+
+  const auto& arena = frame.mState;
+  uint32_t dummy;
+  fits &= CopyOut( s.buttons, s.buttonWordCapacity, s.numButtonWords, arena.Buttons(), arena.mNumButtonWords);
+  fits &= CopyOut( s.prevButtons, s.buttonWordCapacity, dummy, arena.PrevButtons(), arena.mNumButtonWords);
+  fits &= CopyOut( s.axes, s.axisCapacity, s.numAxes, arena.Axes(), arena.mNumAxisSlots);
+  // differences are asked from the devices because some report relative movement apart from their absolute state
+  for( size_t a = 0; a < devices.size() && s.axisDiffs; ++a )
+    for( size_t b = 0; b < frame.mDevices[a].mNumAxes && frame.mDevices[a].mAxisOffset + b < s.axisCapacity; ++b )
+      s.axisDiffs[frame.mDevices[a].mAxisOffset + b] = devices[a]->GetAxisDifference( b);
+  fits &= CopyOut( s.pressed, s.pressedCapacity, s.numPressed, frame.mPressedButtons.data(), frame.mPressedButtons.size());
+  fits &= CopyOut( s.released, s.releasedCapacity, s.numReleased, frame.mReleasedButtons.data(), frame.mReleasedButtons.size());
+
+  s.numDigitalChannels = uint32_t( frame.mDigitalChannels.size());
+  fits &= frame.mDigitalChannels.size() <= s.digitalChannelCapacity;
+  for( size_t a = 0; a < frame.mDigitalChannels.size() && a < s.digitalChannelCapacity && s.digitalChannels; ++a )
+  {
+    const auto& ch = frame.mDigitalChannels[a];
+    s.digitalChannels[a] = SNIIS_DigitalChannelState{ ch.mId, ch.mIsOn, ch.mIsModified, ch.mPressCount, ch.mReleaseCount };
+  }
+  s.numAnalogChannels = uint32_t( frame.mAnalogChannels.size());
+  fits &= frame.mAnalogChannels.size() <= s.analogChannelCapacity;
+  for( size_t a = 0; a < frame.mAnalogChannels.size() && a < s.analogChannelCapacity && s.analogChannels; ++a )
+  {
+    const auto& ch = frame.mAnalogChannels[a];
+    s.analogChannels[a] = SNIIS_AnalogChannelState{ ch.mId, ch.mValue, ch.mDiff };
+  }
+
+  return fits ? 0 : 1;
+}
+
+// Enables the event queue with room for the given number of events, or disables it for zero
+extern "C" void SNIIS_InputSystem_SetEventQueueCapacity( size_t pCapacity)
+{
+  if( SNIIS::gInstance )
+    SNIIS::gInstance->SetEventQueueCapacity( pCapacity);
+}
+
+// Copies up to pCapacity queued events to pEvents and returns their number
+extern "C" size_t SNIIS_PollEvents( SNIIS_Event* pEvents, size_t pCapacity)
+{
+  if( !SNIIS::gInstance || !pEvents )
+    return 0;
+  // both layouts are identical, see the static_asserts above
+  return SNIIS::gInstance->PollEvents( reinterpret_cast<SNIIS::InputEvent*> (pEvents), pCapacity);
+}
+
+// Returns the number of events lost so far because the queue overflowed
+extern "C" uint64_t SNIIS_GetDroppedEventCount()
+{
+  return SNIIS::gInstance ? SNIIS::gInstance->GetDroppedEventCount() : 0;
+}
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
 /// -------------------------------------------------------------------------------------------------------------------
 #if defined(_WIN32) || defined(USE_WINE)
@@ -40,6 +41,95 @@ void SNIIS_InputSystem_Update();
 /// Notifies SNIIS about focus loss/gain. Non-Zero for focus gain, zero for focus loss
 void SNIIS_InputSystem_SetFocus( int pFocus);
 
+/// -------------------------------------------------------------------------------------------------------------------
+/// Batched state export: one call copies the state of all devices and channels into caller-owned memory, so that
+/// frontends in other languages don't need a call per control.
+
+/// Version of the snapshot layout. Put it into SNIIS_Snapshot::version.
+#define SNIIS_SNAPSHOT_VERSION 1
+
+enum SNIIS_DeviceType { SNIIS_DEVICE_UNKNOWN = 0, SNIIS_DEVICE_MOUSE = 1, SNIIS_DEVICE_KEYBOARD = 2, SNIIS_DEVICE_JOYSTICK = 3 };
+enum SNIIS_DeviceFlags { SNIIS_DEVICEFLAG_ENABLED = 1, SNIIS_DEVICEFLAG_ASSEMBLED = 2 };
+
+/// Per device: what it is and where its data is in the snapshot's arrays. Devices are listed in the order of their IDs.
+typedef struct SNIIS_DeviceState
+{
+  uint32_t type; ///< one of SNIIS_DeviceType
+  uint32_t flags; ///< combination of SNIIS_DeviceFlags
+  uint32_t numButtons, numAxes;
+  uint32_t buttonWordOffset; ///< first word in buttons and prevButtons. Button i is bit i%64 of word buttonWordOffset+i/64
+  uint32_t axisOffset; ///< first entry in axes and axisDiffs
+  uint32_t firstPressed, numPressed; ///< range in pressed
+  uint32_t firstReleased, numReleased; ///< range in released
+} SNIIS_DeviceState;
+
+typedef struct SNIIS_DigitalChannelState
+{
+  uint64_t id;
+  uint8_t isOn, isModified, pressCount, releaseCount;
+} SNIIS_DigitalChannelState;
+
+typedef struct SNIIS_AnalogChannelState
+{
+  uint64_t id;
+  float value, diff;
+} SNIIS_AnalogChannelState;
+
+/// The snapshot. The caller sets version and size, and points each array to memory of the given capacity. Arrays
+/// can be Null with capacity zero if you're not interested. SNIIS_InputSystem_GetSnapshot() fills as much as fits and
+/// always sets the num* fields to the full sizes, so you can grow your arrays and try again.
+typedef struct SNIIS_Snapshot
+{
+  uint32_t version; ///< SNIIS_SNAPSHOT_VERSION
+  uint32_t size; ///< sizeof( SNIIS_Snapshot)
+  uint64_t updateCount; ///< number of SNIIS_InputSystem_Update() calls so far
+
+  SNIIS_DeviceState* devices; uint32_t deviceCapacity, numDevices;
+  uint64_t* buttons; uint64_t* prevButtons; uint32_t buttonWordCapacity, numButtonWords; ///< button bits now and before the last update
+  float* axes; float* axisDiffs; uint32_t axisCapacity, numAxes; ///< axis values and their changes during the last update
+  uint32_t* pressed; uint32_t pressedCapacity, numPressed; ///< buttons which went down during the last update, per device
+  uint32_t* released; uint32_t releasedCapacity, numReleased; ///< buttons which went up during the last update, per device
+  SNIIS_DigitalChannelState* digitalChannels; uint32_t digitalChannelCapacity, numDigitalChannels; ///< sorted by id
+  SNIIS_AnalogChannelState* analogChannels; uint32_t analogChannelCapacity, numAnalogChannels; ///< sorted by id
+} SNIIS_Snapshot;
+
+/// Fills the snapshot with the state after the last update. Returns zero if everything fit, 1 if some arrays were
+/// too small and -1 if there's no input instance or the snapshot version or size doesn't match.
+int SNIIS_InputSystem_GetSnapshot( SNIIS_Snapshot* pSnapshot);
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// Event queue: discrete events in the order they happened, independent of any C++ InputHandler.
+
+enum SNIIS_EventKind
+{
+  SNIIS_EVENT_BUTTON_DOWN = 0, ///< mouse or joystick button. control is the button index
+  SNIIS_EVENT_BUTTON_UP = 1,
+  SNIIS_EVENT_KEY_DOWN = 2, ///< control is the SNIIS key code
+  SNIIS_EVENT_KEY_UP = 3,
+  SNIIS_EVENT_KEY_REPEAT = 4,
+  SNIIS_EVENT_TEXT = 5, ///< control is the unicode character
+  SNIIS_EVENT_AXIS = 6, ///< control is the axis index, value the new absolute value
+  SNIIS_EVENT_WHEEL = 7 ///< value is the wheel movement
+};
+
+typedef struct SNIIS_Event
+{
+  uint32_t kind; ///< one of SNIIS_EventKind
+  uint32_t device; ///< device ID, the same as the index into SNIIS_Snapshot::devices
+  uint32_t control;
+  float value;
+  uint64_t timestamp; ///< microseconds since initialization
+} SNIIS_Event;
+
+/// Enables the event queue with room for the given number of events, or disables it for zero. Off by default.
+void SNIIS_InputSystem_SetEventQueueCapacity( size_t pCapacity);
+/// Copies up to pCapacity queued events to pEvents, oldest first, and returns their number. Events that didn't fit
+/// stay queued for the next call.
+size_t SNIIS_PollEvents( SNIIS_Event* pEvents, size_t pCapacity);
+/// Returns the number of events lost so far because the queue overflowed between two polls. Raise the queue capacity
+/// or poll more often if this grows.
+uint64_t SNIIS_GetDroppedEventCount();
+
 #ifdef __cplusplus
 }
 #endif
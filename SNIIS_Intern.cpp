@@ -2,9 +2,14 @@
 /// System-agnostic implementation parts
 
 #include "SNIIS_Intern.h"
+#include "SNIIS_Record.h"
+#include "SNIIS_Trace.h"
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdarg>
+#include <cstdlib>
+#include <stdexcept>
 
 using namespace SNIIS;
 
@@ -15,22 +20,140 @@ namespace SNIIS
 
   /// globol log collbock
   LogCallback gLogCallback = nullptr;
+
+  /// Allocator for new allocations on this thread, Null for the default heap
+  thread_local Allocator* gAllocator = nullptr;
+
+  /// bytes currently allocated through AllocateMemory(), in total and from the default heap. Atomic because frames
+  /// may be released on reader threads
+  static std::atomic<size_t> gAllocatedBytes( 0), gHeapAllocatedBytes( 0);
+
+  /// header in front of every object from AllocateObject(), padded to keep the object aligned
+  union ObjectHeader
+  {
+    struct { Allocator* mAlloc; size_t mSize; } mInfo;
+    std::max_align_t mAlignment;
+  };
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void* SNIIS::AllocateMemory( Allocator* alloc, size_t size, size_t alignment)
+{
+  void* ptr = nullptr;
+  if( alloc )
+  {
+    ptr = alloc->Allocate( size, alignment);
+  } else
+  {
+    assert( alignment <= alignof( std::max_align_t));
+    ptr = std::malloc( size);
+  }
+  if( !ptr && size > 0 )
+    throw std::bad_alloc();
+  (alloc ? alloc->mAllocatedBytes : gHeapAllocatedBytes).fetch_add( size, std::memory_order_relaxed);
+  gAllocatedBytes.fetch_add( size, std::memory_order_relaxed);
+  return ptr;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void SNIIS::FreeMemory( Allocator* alloc, void* ptr, size_t size) noexcept
+{
+  if( !ptr )
+    return;
+  (alloc ? alloc->mAllocatedBytes : gHeapAllocatedBytes).fetch_sub( size, std::memory_order_relaxed);
+  gAllocatedBytes.fetch_sub( size, std::memory_order_relaxed);
+  if( alloc )
+    alloc->Free( ptr, size);
+  else
+    std::free( ptr);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void* SNIIS::AllocateObject( size_t size)
+{
+  auto header = static_cast<ObjectHeader*> (AllocateMemory( gAllocator, sizeof( ObjectHeader) + size, alignof( ObjectHeader)));
+  header->mInfo.mAlloc = gAllocator;
+  header->mInfo.mSize = sizeof( ObjectHeader) + size;
+  return header + 1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void SNIIS::FreeObject( void* ptr) noexcept
+{
+  if( !ptr )
+    return;
+  auto header = static_cast<ObjectHeader*> (ptr) - 1;
+  FreeMemory( header->mInfo.mAlloc, header, header->mInfo.mSize);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+size_t SNIIS::GetAllocatedBytes() noexcept
+{
+  return gAllocatedBytes.load( std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+size_t SNIIS::GetHeapAllocatedBytes() noexcept
+{
+  return gHeapAllocatedBytes.load( std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Initializes the global input system. When successful, gInstance is not Null.
+bool InputSystem::Initialize( void* pInitArg, const InitOptions& pOptions)
+{
+  if( gInstance )
+    throw std::runtime_error( "Input already initialized");
+
+  gInstance = Create( pInitArg, pOptions);
+  return gInstance != nullptr;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Destroys the global input system. After returning gInstance is Null again
+void InputSystem::Shutdown()
+{
+  Destroy( gInstance);
+  gInstance = nullptr;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputSystem::Destroy( InputSystem* system)
+{
+  if( !system )
+    return;
+  // devices and such are freed to wherever they came from, but the destructor might create something temporarily
+  AllocatorScope scope( system->mAllocator);
+  delete system;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
 InputSystem::InputSystem()
 {
-  // I don't want to hand around the instance pointer in InputSystemHelper so make it public quickly and retract later
-  SNIIS::gInstance = this;
   Log( "SNIIS instance created.");
+  // objects are created while the allocator is installed, see InputSystem::Create()
+  mAllocator = gAllocator;
 
   mFirstMouse = nullptr; mFirstKeyboard = nullptr; mFirstJoystick = nullptr;
   mNumMice = mNumKeyboards = mNumJoysticks = 0;
   mHandler = nullptr;
   mHasFocus = true;
   mIsMouseGrabEnabled = mIsMouseGrabbed = false;
-
-  mKeyRepeatState.lasttick = clock();
+  mUpdateCount = 0;
+  mRecorder = nullptr;
+  mTracer = nullptr;
+  mIsUpdateStatsEnabled = false;
+  mIsLatencyTrackingEnabled = false;
+  mReportMode = Report_Latest;
+  mSourceTime = 0;
+  mNumInputDrops = 0;
+  mOsQueueHighWater = 0;
+  mOsQueueWarning = 0;
+  mFirstEvent = mNumEvents = 0; mDroppedEvents = 0;
+  mStartTime = std::chrono::steady_clock::now();
+  mTime = 0;
+
+  mKeyRepeatState.mLastTime = 0;
   mKeyRepeatState.mKeyCode = KC_UNASSIGNED; mKeyRepeatState.mUnicodeChar = 0;
   mKeyRepeatState.mTimeTillRepeat = 0.0f;
   mKeyRepeatState.mSender = nullptr;
@@ -40,34 +163,159 @@ InputSystem::InputSystem()
 InputSystem::~InputSystem()
 {
   Log("SNIIS instance going down.");
+  if( mRecorder )
+    mRecorder->Stop();
+  if( mTracer )
+    mTracer->Stop();
+  for( auto r : mFrameReaders )
+    delete r;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
 // Updates the input system, to be called before handling system messages
 void InputSystem::Update()
 {
+  ++mUpdateCount;
+  mTime = ReadClock();
+  if( mIsUpdateStatsEnabled )
+    mUpdateStats.Clear();
+  uint64_t stageStart = InputSystemHelper::BeginStage( this);
+
+  // the current state becomes the state at the start of the frame
+  std::copy_n( mState.Buttons(), mState.mNumButtonWords, mState.PrevButtons());
+  std::copy_n( mState.Axes(), mState.mNumAxisSlots, mState.PrevAxes());
+
   // do the key repeat. yeah.
-  auto& krs = gInstance->mKeyRepeatState;
-  auto currtime = clock();
-  float dt = std::min( 0.1f, std::max( 0.0f, float( currtime - krs.lasttick) / float( CLOCKS_PER_SEC)));
-  krs.lasttick = currtime;
+  auto& krs = mKeyRepeatState;
+  float dt = std::min( 0.1f, float( mTime - krs.mLastTime) * 1e-6f);
+  krs.mLastTime = mTime;
 
   if( krs.mTimeTillRepeat > 0.0f )
   {
     krs.mTimeTillRepeat -= dt;
     if( krs.mTimeTillRepeat <= 0.0f )
     {
+      InputSystemHelper::QueueEvent( krs.mSender, Event_KeyRepeat, size_t( krs.mKeyCode), 0.0f);
       InputSystemHelper::DoKeyboardButtonIntern( krs.mSender, krs.mKeyCode, krs.mUnicodeChar, false);
       InputSystemHelper::DoKeyboardButtonIntern( krs.mSender, krs.mKeyCode, krs.mUnicodeChar, true);
-      krs.mTimeTillRepeat = std::max( 0.00001f, krs.mTimeTillRepeat + gInstance->mKeyRepeatCfg.interval);
+      krs.mTimeTillRepeat = std::max( 0.00001f, krs.mTimeTillRepeat + mKeyRepeatCfg.interval);
     }
   }
 
+  // reset the transition counters of all buttons which were touched last frame
+  for( auto d : mDevices )
+  {
+    for( size_t idx : d->mCountedButtons )
+      d->mPressCounts[idx] = d->mReleaseCounts[idx] = 0;
+    d->mCountedButtons.clear();
+  }
+
   // reset all channel modifications
   for( auto& dch : mDigitalChannels )
     dch.second.Update();
   for( auto& ach : mAnalogChannels )
     ach.second.Update();
+  InputSystemHelper::EndStage( this, UpdateStats::Stage_Reset, stageStart);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Default clock: real time
+uint64_t InputSystem::ReadClock() const
+{
+  return uint64_t( std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now() - mStartTime).count());
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputSystem::ClearLatencyHistograms()
+{
+  for( auto& stage : mLatencies )
+    for( auto& hist : stage )
+      hist.Clear();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+size_t InputSystem::GetAllocatedBytes() const
+{
+  return mAllocator ? mAllocator->GetAllocatedBytes() : GetHeapAllocatedBytes();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+InputFrameReader* InputSystem::CreateFrameReader()
+{
+  AllocatorScope scope( mAllocator);
+  auto reader = new InputFrameReader;
+  // the middle buffer starts out fresh, so that the reader gets the current state right away
+  FillFrame( reader->mFrames[1]);
+  reader->mMiddle.store( 1 | InputFrameReader::FreshFlag, std::memory_order_release);
+  mFrameReaders.push_back( reader);
+  return reader;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputSystem::DestroyFrameReader( InputFrameReader* reader)
+{
+  auto it = std::find( mFrameReaders.begin(), mFrameReaders.end(), reader);
+  if( it == mFrameReaders.end() )
+    return;
+  mFrameReaders.erase( it);
+  delete reader;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Copies the complete state. All containers are overwritten in place, so a reused frame doesn't allocate any more once
+// it has seen the largest setup.
+void InputSystem::FillFrame( InputFrame& frame) const
+{
+  frame.mUpdateCount = mUpdateCount;
+  frame.mState.mNumButtonWords = mState.mNumButtonWords;
+  frame.mState.mNumAxisSlots = mState.mNumAxisSlots;
+  frame.mState.mData.assign( mState.mData.begin(), mState.mData.end());
+
+  frame.mDevices.resize( mDevices.size());
+  frame.mPressedButtons.clear();
+  frame.mReleasedButtons.clear();
+  for( size_t a = 0; a < mDevices.size(); ++a )
+  {
+    const Device* dev = mDevices[a];
+    auto& r = frame.mDevices[a];
+    r.mButtonOffset = dev->mButtonOffset; r.mNumButtonWords = dev->mNumButtonWords;
+    r.mAxisOffset = dev->mAxisOffset; r.mNumAxes = dev->mNumAxisSlots;
+    r.mFirstPressed = frame.mPressedButtons.size(); r.mNumPressed = dev->mPressedButtons.size();
+    r.mFirstReleased = frame.mReleasedButtons.size(); r.mNumReleased = dev->mReleasedButtons.size();
+    frame.mPressedButtons.insert( frame.mPressedButtons.end(), dev->mPressedButtons.begin(), dev->mPressedButtons.end());
+    frame.mReleasedButtons.insert( frame.mReleasedButtons.end(), dev->mReleasedButtons.begin(), dev->mReleasedButtons.end());
+  }
+
+  // the maps are ordered by ID, so the frame's lists end up sorted for binary search
+  frame.mDigitalChannels.clear();
+  for( const auto& dch : mDigitalChannels )
+  {
+    const auto& ch = dch.second;
+    frame.mDigitalChannels.push_back( InputFrame::DigitalState{ dch.first, ch.mIsPressed, ch.mIsModified, ch.mPressCount, ch.mReleaseCount });
+  }
+  frame.mAnalogChannels.clear();
+  for( const auto& ach : mAnalogChannels )
+    frame.mAnalogChannels.push_back( InputFrame::AnalogState{ ach.first, ach.second.mValue, ach.second.mDiff });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputSystem::SetEventQueueCapacity( size_t capacity)
+{
+  mEvents.resize( capacity);
+  mEvents.shrink_to_fit();
+  mFirstEvent = mNumEvents = 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+size_t InputSystem::PollEvents( InputEvent* events, size_t maxCount)
+{
+  size_t count = std::min( maxCount, mNumEvents);
+  for( size_t a = 0; a < count; ++a )
+    events[a] = mEvents[(mFirstEvent + a) % mEvents.size()];
+  if( count > 0 )
+    mFirstEvent = (mFirstEvent + count) % mEvents.size();
+  mNumEvents -= count;
+  return count;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -78,6 +326,8 @@ void InputSystem::SetFocus( bool pHasFocus)
     return;
   Log( "SNIIS: %s focus", pHasFocus ? "got" : "lost");
   mHasFocus = pHasFocus;
+  if( mRecorder )
+    mRecorder->RecordFocus( pHasFocus);
   InternSetFocus( pHasFocus);
   InternGrabMouseIfNecessary();
 }
@@ -104,11 +354,39 @@ void InputSystem::InternGrabMouseIfNecessary()
   InternSetMouseGrab( necessary);
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+// Enables or disables a device.
+void InputSystem::SetDeviceEnabled( Device* dev, bool enabled)
+{
+  if( !dev || enabled == dev->mIsEnabled )
+    return;
+  Log( "SNIIS: %s device %zd", enabled ? "enabling" : "disabling", dev->GetId());
+  if( mRecorder )
+    mRecorder->RecordDeviceEnabled( dev, enabled);
+  // release everything while the device can still signal, and only then shut it up
+  if( enabled )
+  {
+    dev->mIsEnabled = true;
+    InternSetDeviceEnabled( dev, true);
+  } else
+  {
+    InternSetDeviceEnabled( dev, false);
+    dev->mIsEnabled = false;
+  }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Default: the backend listens to everything anyways, InputSystemHelper filters out events of disabled devices
+void InputSystem::InternSetDeviceEnabled( Device* dev, bool enabled)
+{
+  SNIIS_UNUSED( dev); SNIIS_UNUSED( enabled);
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 // Gets the nth device of that specific kind
 Mouse* InputSystem::GetMouseByCount(size_t pNumber) const
-{
-  if( !pNumber )
+{
+  if( !pNumber )
     return mFirstMouse;
 
   for( auto d : mDevices )
@@ -120,8 +398,8 @@ Mouse* InputSystem::GetMouseByCount(size_t pNumber) const
 }
 // --------------------------------------------------------------------------------------------------------------------
 Keyboard* InputSystem::GetKeyboardByCount(size_t pNumber) const
-{
-  if( !pNumber )
+{
+  if( !pNumber )
     return mFirstKeyboard;
 
   for( auto d : mDevices )
@@ -133,8 +411,8 @@ Keyboard* InputSystem::GetKeyboardByCount(size_t pNumber) const
 }
 // --------------------------------------------------------------------------------------------------------------------
 Joystick* InputSystem::GetJoystickByCount(size_t pNumber) const
-{
-  if( !pNumber )
+{
+  if( !pNumber )
     return mFirstJoystick;
 
   for( auto d : mDevices )
@@ -195,8 +473,9 @@ void InputSystem::ClearChannelAssignments()
     if( p.second.mIsPressed )
     {
       p.second.mIsPressed = false; p.second.mIsModified = true;
-      if( gInstance->mHandler )
-        gInstance->mHandler->OnDigitalChannel( p.second);
+      p.second.mReleaseCount = uint8_t( std::min( p.second.mReleaseCount + 1, 255));
+      if( auto handler = InputSystemHelper::GetHandler( this, UpdateStats::Layer_Channel) )
+        handler->OnDigitalChannel( p.second);
     }
     p.second.mSources.clear();
   }
@@ -207,8 +486,8 @@ void InputSystem::ClearChannelAssignments()
     if( p.second.mValue != 0.0f )
     {
       p.second.mDiff = -p.second.mValue; p.second.mValue = 0.0f;
-      if( gInstance->mHandler )
-        gInstance->mHandler->OnAnalogChannel( p.second);
+      if( auto handler = InputSystemHelper::GetHandler( this, UpdateStats::Layer_Channel) )
+        handler->OnAnalogChannel( p.second);
     }
     p.second.mSources.clear();
   }
@@ -351,36 +630,127 @@ void AnalogChannel::ClearAllAssignments()
 
 // ********************************************************************************************************************
 // --------------------------------------------------------------------------------------------------------------------
-void InputSystemHelper::AddDevice( Device* dev)
+const char* Device::GetButtonName( size_t idx) const
+{
+  return idx < GetNumButtons() ? GetName( idx) : "";
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+const char* Device::GetAxisName( size_t idx) const
 {
-  gInstance->mDevices.push_back( dev);
+  return idx < GetNumAxes() ? GetName( GetNumButtons() + idx) : "";
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Returns the text of the given control, buttons first and axes after them. Collects all texts into a single buffer
+// on first use or after the number of controls changed.
+const char* Device::GetName( size_t idx) const
+{
+  size_t numButtons = GetNumButtons(), numAxes = GetNumAxes();
+  if( mNameOffsets.size() != numButtons + numAxes )
+  {
+    mNameChars.clear();
+    mNameOffsets.clear();
+    for( size_t a = 0; a < numButtons + numAxes; ++a )
+    {
+      std::string text = a < numButtons ? GetButtonText( a) : GetAxisText( a - numButtons);
+      mNameOffsets.push_back( mNameChars.size());
+      mNameChars.insert( mNameChars.end(), text.c_str(), text.c_str() + text.size() + 1);
+    }
+  }
+
+  return mNameChars.data() + mNameOffsets[idx];
+}
+
+// ********************************************************************************************************************
+// --------------------------------------------------------------------------------------------------------------------
+void InputSystemHelper::AddDevice( InputSystem* sys, Device* dev)
+{
+  dev->mOwner = sys;
+  sys->mDevices.push_back( dev);
+  LayoutStateArena( sys);
+  dev->mPressCounts.resize( dev->GetNumButtons()); dev->mReleaseCounts.resize( dev->GetNumButtons());
   if( auto m = dynamic_cast<Mouse*> (dev) )
   {
-    dev->mCount = gInstance->mNumMice++;
-    if( !gInstance->mFirstMouse )
-      gInstance->mFirstMouse = m;
+    dev->mCount = sys->mNumMice++;
+    if( !sys->mFirstMouse )
+      sys->mFirstMouse = m;
   }
 
   if( auto k = dynamic_cast<Keyboard*> (dev) )
   {
-    dev->mCount = gInstance->mNumKeyboards++;
-    if( !gInstance->mFirstKeyboard )
-      gInstance->mFirstKeyboard = k;
+    dev->mCount = sys->mNumKeyboards++;
+    if( !sys->mFirstKeyboard )
+      sys->mFirstKeyboard = k;
   }
 
   if( auto j = dynamic_cast<Joystick*> (dev) )
   {
-    dev->mCount = gInstance->mNumJoysticks++;
-    if( !gInstance->mFirstJoystick )
-      gInstance->mFirstJoystick = j;
+    dev->mCount = sys->mNumJoysticks++;
+    if( !sys->mFirstJoystick )
+      sys->mFirstJoystick = j;
+  }
+
+  if( sys->mRecorder )
+    sys->mRecorder->RecordDevice( dev);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Assigns each device its range in the state arena, according to its current number of buttons and axes. Called
+// whenever a device is added or changes its controls. Devices keep their state as far as it still fits.
+void InputSystemHelper::LayoutStateArena( InputSystem* sys)
+{
+  auto& arena = sys->mState;
+  size_t numWords = 0, numAxes = 0;
+  for( auto d : sys->mDevices )
+  {
+    numWords += (d->GetNumButtons() + 63) / 64;
+    numAxes += d->GetNumAxes();
+  }
+
+  StateArena next;
+  next.mNumButtonWords = numWords;
+  next.mNumAxisSlots = (numAxes + 1) & ~size_t( 1);
+  next.mData.resize( 2*next.mNumButtonWords + next.mNumAxisSlots);
+
+  size_t buttonOffset = 0, axisOffset = 0;
+  for( auto d : sys->mDevices )
+  {
+    size_t words = (d->GetNumButtons() + 63) / 64, axes = d->GetNumAxes();
+    if( d->mArena )
+    {
+      size_t w = std::min( words, d->mNumButtonWords), a = std::min( axes, d->mNumAxisSlots);
+      std::copy_n( arena.Buttons() + d->mButtonOffset, w, next.Buttons() + buttonOffset);
+      std::copy_n( arena.PrevButtons() + d->mButtonOffset, w, next.PrevButtons() + buttonOffset);
+      std::copy_n( arena.Axes() + d->mAxisOffset, a, next.Axes() + axisOffset);
+      std::copy_n( arena.PrevAxes() + d->mAxisOffset, a, next.PrevAxes() + axisOffset);
+    }
+
+    d->mArena = &arena;
+    d->mButtonOffset = buttonOffset; d->mNumButtonWords = words;
+    d->mAxisOffset = axisOffset; d->mNumAxisSlots = axes;
+    buttonOffset += words; axisOffset += axes;
   }
+
+  arena = std::move( next);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
 void InputSystemHelper::DoMouseButton( Mouse* sender, size_t btnIndex, bool isPressed)
 {
-  if( gInstance->mHandler )
-    if( gInstance->mHandler->OnMouseButton( sender, btnIndex, isPressed) )
+  InputSystem* sys = sender->mOwner;
+  if( sys->mTracer )
+    TraceInput( sender, "Mouse button", btnIndex, isPressed ? 1.0f : 0.0f);
+  TrackLatency( sender, DeviceKind_Mouse);
+  if( !sender->IsEnabled() )
+    return;
+  TraceScope scope( sys, "Dispatch", sender->GetId());
+  if( sys->mRecorder )
+    sys->mRecorder->RecordButton( sender, btnIndex, isPressed);
+  CountButtonTransition( sender, btnIndex, isPressed);
+  QueueEvent( sender, isPressed ? Event_ButtonDown : Event_ButtonUp, btnIndex, isPressed ? 1.0f : 0.0f);
+  if( auto handler = GetHandler( sys, UpdateStats::Layer_Device) )
+    if( handler->OnMouseButton( sender, btnIndex, isPressed) )
       return;
 
   DoDigitalEvent( sender, btnIndex, isPressed);
@@ -389,8 +759,21 @@ void InputSystemHelper::DoMouseButton( Mouse* sender, size_t btnIndex, bool isPr
 // --------------------------------------------------------------------------------------------------------------------
 void InputSystemHelper::DoMouseMove( Mouse* sender, float absx, float absy, float relx, float rely)
 {
-  if( gInstance->mHandler )
-    if( gInstance->mHandler->OnMouseMoved( sender, absx, absy) )
+  InputSystem* sys = sender->mOwner;
+  if( sys->mTracer )
+    TraceInput( sender, "Mouse move", 0, absx);
+  TrackLatency( sender, DeviceKind_Mouse);
+  if( !sender->IsEnabled() )
+    return;
+  TraceScope scope( sys, "Dispatch", sender->GetId());
+  if( sys->mRecorder )
+    sys->mRecorder->RecordMouseMove( sender, absx, absy, relx, rely);
+  if( relx != 0 )
+    QueueEvent( sender, Event_Axis, 0, absx);
+  if( rely != 0 )
+    QueueEvent( sender, Event_Axis, 1, absy);
+  if( auto handler = GetHandler( sys, UpdateStats::Layer_Device) )
+    if( handler->OnMouseMoved( sender, absx, absy) )
       return;
 
   if( relx != 0 )
@@ -402,8 +785,18 @@ void InputSystemHelper::DoMouseMove( Mouse* sender, float absx, float absy, floa
 // --------------------------------------------------------------------------------------------------------------------
 void InputSystemHelper::DoMouseWheel( Mouse* sender, float diff)
 {
-  if( gInstance->mHandler )
-    if( gInstance->mHandler->OnMouseWheel( sender, diff) )
+  InputSystem* sys = sender->mOwner;
+  if( sys->mTracer )
+    TraceInput( sender, "Mouse wheel", 2, diff);
+  TrackLatency( sender, DeviceKind_Mouse);
+  if( !sender->IsEnabled() )
+    return;
+  TraceScope scope( sys, "Dispatch", sender->GetId());
+  if( sys->mRecorder )
+    sys->mRecorder->RecordWheel( sender, diff);
+  QueueEvent( sender, Event_Wheel, 2, diff);
+  if( auto handler = GetHandler( sys, UpdateStats::Layer_Device) )
+    if( handler->OnMouseWheel( sender, diff) )
       return;
   DoAnalogEvent( sender, 2, diff);
 }
@@ -411,20 +804,32 @@ void InputSystemHelper::DoMouseWheel( Mouse* sender, float diff)
 // --------------------------------------------------------------------------------------------------------------------
 void InputSystemHelper::DoKeyboardButton( Keyboard* sender, KeyCode kc, size_t unicode, bool isPressed)
 {
+  InputSystem* sys = sender->mOwner;
+  if( sys->mTracer )
+    TraceInput( sender, "Key", size_t( kc), isPressed ? 1.0f : 0.0f);
+  TrackLatency( sender, DeviceKind_Keyboard);
+  if( !sender->IsEnabled() )
+    return;
+  TraceScope scope( sys, "Dispatch", sender->GetId());
+  // record and count the actual key, but not the key repetition which ends up in DoKeyboardButtonIntern() only
+  if( sys->mRecorder )
+    sys->mRecorder->RecordKey( sender, kc, unicode, isPressed);
+  CountButtonTransition( sender, size_t( kc), isPressed);
+  QueueEvent( sender, isPressed ? Event_KeyDown : Event_KeyUp, size_t( kc), isPressed ? 1.0f : 0.0f);
   // store for key repetition
-  if( isPressed && gInstance->mKeyRepeatCfg.enable )
+  if( isPressed && sys->mKeyRepeatCfg.enable )
   {
-    gInstance->mKeyRepeatState.mKeyCode = kc;
-    gInstance->mKeyRepeatState.mSender = sender;
-    gInstance->mKeyRepeatState.mUnicodeChar = unicode;
-    gInstance->mKeyRepeatState.mTimeTillRepeat = gInstance->mKeyRepeatCfg.delay;
+    sys->mKeyRepeatState.mKeyCode = kc;
+    sys->mKeyRepeatState.mSender = sender;
+    sys->mKeyRepeatState.mUnicodeChar = unicode;
+    sys->mKeyRepeatState.mTimeTillRepeat = sys->mKeyRepeatCfg.delay;
   }
-  else if( !isPressed && gInstance->mKeyRepeatState.mKeyCode == kc )
+  else if( !isPressed && sys->mKeyRepeatState.mKeyCode == kc )
   {
-    gInstance->mKeyRepeatState.mKeyCode = KC_UNASSIGNED;
-    gInstance->mKeyRepeatState.mSender = nullptr;
-    gInstance->mKeyRepeatState.mUnicodeChar = 0;
-    gInstance->mKeyRepeatState.mTimeTillRepeat = 0.0f;
+    sys->mKeyRepeatState.mKeyCode = KC_UNASSIGNED;
+    sys->mKeyRepeatState.mSender = nullptr;
+    sys->mKeyRepeatState.mUnicodeChar = 0;
+    sys->mKeyRepeatState.mTimeTillRepeat = 0.0f;
   }
 
   // and execute
@@ -434,11 +839,14 @@ void InputSystemHelper::DoKeyboardButton( Keyboard* sender, KeyCode kc, size_t u
 // --------------------------------------------------------------------------------------------------------------------
 void InputSystemHelper::DoKeyboardButtonIntern( Keyboard* sender, KeyCode kc, size_t unicode, bool isPressed)
 {
-  if( gInstance->mHandler )
+  InputSystem* sys = sender->mOwner;
+  if( isPressed && unicode )
+    QueueEvent( sender, Event_Text, unicode, 0.0f);
+  if( auto handler = GetHandler( sys, UpdateStats::Layer_Device) )
   {
-    if( gInstance->mHandler->OnKey( sender, kc, isPressed) )
+    if( handler->OnKey( sender, kc, isPressed) )
       return;
-    if( isPressed && unicode && gInstance->mHandler->OnUnicode( sender, unicode) )
+    if( isPressed && unicode && GetHandler( sys, UpdateStats::Layer_Device)->OnUnicode( sender, unicode) )
       return;
   }
 
@@ -448,8 +856,18 @@ void InputSystemHelper::DoKeyboardButtonIntern( Keyboard* sender, KeyCode kc, si
 // --------------------------------------------------------------------------------------------------------------------
 void InputSystemHelper::DoJoystickAxis( Joystick* sender, size_t axisIndex, float value)
 {
-  if( gInstance->mHandler )
-    if( gInstance->mHandler->OnJoystickAxis( sender, axisIndex, value) )
+  InputSystem* sys = sender->mOwner;
+  if( sys->mTracer )
+    TraceInput( sender, "Controller axis", axisIndex, value);
+  TrackLatency( sender, DeviceKind_Joystick);
+  if( !sender->IsEnabled() )
+    return;
+  TraceScope scope( sys, "Dispatch", sender->GetId());
+  if( sys->mRecorder )
+    sys->mRecorder->RecordAxis( sender, axisIndex, value);
+  QueueEvent( sender, Event_Axis, axisIndex, value);
+  if( auto handler = GetHandler( sys, UpdateStats::Layer_Device) )
+    if( handler->OnJoystickAxis( sender, axisIndex, value) )
       return;
 
   DoAnalogEvent( sender, axisIndex, value);
@@ -458,8 +876,19 @@ void InputSystemHelper::DoJoystickAxis( Joystick* sender, size_t axisIndex, floa
 // --------------------------------------------------------------------------------------------------------------------
 void InputSystemHelper::DoJoystickButton( Joystick* sender, size_t btnIndex, bool isPressed)
 {
-  if( gInstance->mHandler )
-    if( gInstance->mHandler->OnJoystickButton( sender, btnIndex, isPressed) )
+  InputSystem* sys = sender->mOwner;
+  if( sys->mTracer )
+    TraceInput( sender, "Controller button", btnIndex, isPressed ? 1.0f : 0.0f);
+  TrackLatency( sender, DeviceKind_Joystick);
+  if( !sender->IsEnabled() )
+    return;
+  TraceScope scope( sys, "Dispatch", sender->GetId());
+  if( sys->mRecorder )
+    sys->mRecorder->RecordButton( sender, btnIndex, isPressed);
+  CountButtonTransition( sender, btnIndex, isPressed);
+  QueueEvent( sender, isPressed ? Event_ButtonDown : Event_ButtonUp, btnIndex, isPressed ? 1.0f : 0.0f);
+  if( auto handler = GetHandler( sys, UpdateStats::Layer_Device) )
+    if( handler->OnJoystickButton( sender, btnIndex, isPressed) )
       return;
 
   DoDigitalEvent( sender, btnIndex, isPressed);
@@ -468,8 +897,14 @@ void InputSystemHelper::DoJoystickButton( Joystick* sender, size_t btnIndex, boo
 // --------------------------------------------------------------------------------------------------------------------
 void InputSystemHelper::UpdateChannels( Device* sender, size_t ctrlIndex, bool isAnalog)
 {
+  InputSystem* sys = sender->mOwner;
+  if( sys->mDigitalChannels.empty() && sys->mAnalogChannels.empty() )
+    return;
+
+  TraceScope scope( sys, "Channels", sender->GetId());
+  auto stats = GetUpdateStats( sys);
   // update digital channels using this as a source
-  for( auto& ch : gInstance->mDigitalChannels )
+  for( auto& ch : sys->mDigitalChannels )
   {
     auto& dch = ch.second;
     auto it = std::find_if( dch.mSources.begin(), dch.mSources.end(),
@@ -477,32 +912,40 @@ void InputSystemHelper::UpdateChannels( Device* sender, size_t ctrlIndex, bool i
 
     if( it != dch.mSources.end() )
     {
+      if( stats )
+        ++stats->mChannelsEvaluated;
       // derive new state of that channel by combining the states of all sources
       bool wasPressed = dch.mIsPressed;
       dch.mIsPressed = false;
       for( const auto& s : dch.mSources )
       {
-        auto dev = s.mDeviceId < gInstance->mDevices.size() ? gInstance->mDevices[s.mDeviceId] : nullptr;
+        auto dev = s.mDeviceId < sys->mDevices.size() ? sys->mDevices[s.mDeviceId] : nullptr;
         if( !dev )
           continue;
         if( s.mIsAnalog )
         {
-          float v = dev->GetAxisAbsolute( s.mControlId);
+          float v = dev->GetAxisValue( s.mControlId);
           dch.mIsPressed = (s.mAnalogLimit < 0.0f ? (v < s.mAnalogLimit) : (v > s.mAnalogLimit));
         } else
         {
-          dch.mIsPressed = dch.mIsPressed || dev->IsButtonDown( s.mControlId);
+          dch.mIsPressed = dch.mIsPressed || dev->IsButtonBitSet( s.mControlId);
         }
       }
 
       dch.mIsModified = (dch.mIsPressed != wasPressed);
-      if( gInstance->mHandler && dch.mIsModified )
-        gInstance->mHandler->OnDigitalChannel( dch);
+      if( dch.mIsModified )
+      {
+        uint8_t& count = dch.mIsPressed ? dch.mPressCount : dch.mReleaseCount;
+        count = uint8_t( std::min( count + 1, 255));
+      }
+      if( dch.mIsModified )
+        if( auto handler = GetHandler( sys, UpdateStats::Layer_Channel) )
+          handler->OnDigitalChannel( dch);
     }
   }
 
   // and update analog channels using this as an input
-  for( auto& ch : gInstance->mAnalogChannels )
+  for( auto& ch : sys->mAnalogChannels )
   {
     // style guides, take cover. It's getting ugly.
     auto& ach = ch.second;
@@ -513,25 +956,27 @@ void InputSystemHelper::UpdateChannels( Device* sender, size_t ctrlIndex, bool i
 
     if( it != ach.mSources.end() )
     {
+      if( stats )
+        ++stats->mChannelsEvaluated;
       // accumulate new state of that channel
       float prevValue = ach.mValue;
       ach.mValue = 0.0f;
       for( const auto& s : ach.mSources )
       {
-        auto dev = s.mDeviceId < gInstance->mDevices.size() ? gInstance->mDevices[s.mDeviceId] : nullptr;
+        auto dev = s.mDeviceId < sys->mDevices.size() ? sys->mDevices[s.mDeviceId] : nullptr;
         if( !dev )
           continue;
         switch( s.mType )
         {
           case AnalogChannel::Source_Digital:
-            ach.mValue += dev->IsButtonDown( s.mControlId) ? s.mDigitalAmountOrAnalogLimit : 0.0f;
+            ach.mValue += dev->IsButtonBitSet( s.mControlId) ? s.mDigitalAmountOrAnalogLimit : 0.0f;
             break;
           case AnalogChannel::Source_Analog:
-            ach.mValue += dev->GetAxisAbsolute( s.mControlId);
+            ach.mValue += dev->GetAxisValue( s.mControlId);
             break;
           case AnalogChannel::Source_LimitedAnalog:
           {
-            float v = dev->GetAxisAbsolute( s.mControlId);
+            float v = dev->GetAxisValue( s.mControlId);
             float l = s.mDigitalAmountOrAnalogLimit;
             bool isActive = (l != 0.0f ? (l < 0.0f ? (v < l) : (v > l)) : true);
             ach.mValue += isActive ? v * s.mAnalogScale : 0.0f;
@@ -540,17 +985,147 @@ void InputSystemHelper::UpdateChannels( Device* sender, size_t ctrlIndex, bool i
         }
       }
       ach.mDiff += ach.mValue - prevValue;
-      if( gInstance->mHandler && ach.mValue != prevValue )
-        gInstance->mHandler->OnAnalogChannel( ach);
+      if( ach.mValue != prevValue )
+        if( auto handler = GetHandler( sys, UpdateStats::Layer_Channel) )
+          handler->OnAnalogChannel( ach);
     }
   }
 }
 
+
+// --------------------------------------------------------------------------------------------------------------------
+// Compares current and previous button state of all devices word by word and lists all changes. Called by the
+// platform implementation at the end of an update.
+void InputSystemHelper::CollectButtonEdges( InputSystem* sys)
+{
+  const auto& arena = sys->mState;
+  const uint64_t* state = arena.Buttons();
+  const uint64_t* prevState = arena.PrevButtons();
+  for( auto dev : sys->mDevices )
+  {
+    dev->mPressedButtons.clear();
+    dev->mReleasedButtons.clear();
+    for( size_t w = 0; w < dev->mNumButtonWords; ++w )
+    {
+      size_t word = dev->mButtonOffset + w;
+      uint64_t changed = state[word] ^ prevState[word];
+      while( changed )
+      {
+        size_t bit = CountTrailingZeros( changed);
+        if( state[word] & (1ull << bit) )
+          dev->mPressedButtons.push_back( w * 64 + bit);
+        else
+          dev->mReleasedButtons.push_back( w * 64 + bit);
+        changed &= changed - 1;
+      }
+    }
+  }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Completes an update: collects this frame's button edges, marks the end of the frame for the recorder and hands a
+// copy of the resulting state to every frame reader. Called by the platform implementation at the end of its Update().
+void InputSystemHelper::FinishUpdate( InputSystem* sys)
+{
+  uint64_t stageStart = BeginStage( sys);
+  if( !sys->mPendingLatencies.empty() )
+  {
+    uint64_t now = ReadLatencyClock();
+    for( const auto& pl : sys->mPendingLatencies )
+      sys->mLatencies[Latency_UpdateEnd][pl.mKind].Add( now > pl.mSourceTime ? now - pl.mSourceTime : 0);
+    sys->mPendingLatencies.clear();
+  }
+  CollectButtonEdges( sys);
+  if( sys->mRecorder )
+    sys->mRecorder->RecordUpdate();
+
+  for( auto reader : sys->mFrameReaders )
+  {
+    sys->FillFrame( reader->mFrames[reader->mBack]);
+    // swap the freshly written buffer into the middle and continue with whatever was there. The reader only ever
+    // exchanges its front buffer against the middle one, so the back buffer is exclusively ours.
+    uint8_t prev = reader->mMiddle.exchange( uint8_t( reader->mBack | InputFrameReader::FreshFlag), std::memory_order_acq_rel);
+    reader->mBack = prev & 3;
+  }
+  EndStage( sys, UpdateStats::Stage_Finish, stageStart);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Appends an event to the event queue, if enabled. A full queue drops the new event, so that the application still
+// sees a consistent sequence up to the point where it fell behind.
+void InputSystemHelper::QueueEvent( Device* sender, InputEventKind kind, size_t control, float value)
+{
+  auto& is = *sender->mOwner;
+  if( is.mEvents.empty() )
+    return;
+  if( is.mNumEvents == is.mEvents.size() )
+  {
+    ++is.mDroppedEvents;
+    return;
+  }
+
+  auto& ev = is.mEvents[(is.mFirstEvent + is.mNumEvents++) % is.mEvents.size()];
+  ev.mKind = kind;
+  ev.mDevice = uint32_t( sender->GetId());
+  ev.mControl = uint32_t( control);
+  ev.mValue = value;
+  ev.mTimestamp = is.ReadClock();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Counts a button transition. The counters are reset in InputSystem::Update(), but only for buttons listed here, so
+// this stays cheap even for keyboards with hundreds of keys.
+void InputSystemHelper::CountButtonTransition( Device* dev, size_t btnIndex, bool isPressed)
+{
+  if( btnIndex >= dev->mPressCounts.size() )
+  {
+    dev->mPressCounts.resize( btnIndex + 1); dev->mReleaseCounts.resize( btnIndex + 1);
+  }
+
+  uint8_t& press = dev->mPressCounts[btnIndex];
+  uint8_t& release = dev->mReleaseCounts[btnIndex];
+  if( press == 0 && release == 0 )
+    dev->mCountedButtons.push_back( btnIndex);
+  uint8_t& count = isPressed ? press : release;
+  if( count < 255 )
+    ++count;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputSystemHelper::DoInputDropped( Device* sender)
+{
+  InputSystem* sys = sender->mOwner;
+  if( !sender->IsEnabled() )
+    return;
+  if( sys->mRecorder )
+    sys->mRecorder->RecordInputDropped( sender);
+  ++sender->mNumInputDrops;
+  ++sys->mNumInputDrops;
+  InputSystem::Log( "SNIIS: input of device %zd got lost, resynchronising", sender->GetId());
+  if( auto handler = GetHandler( sys, UpdateStats::Layer_Device) )
+    handler->OnInputDropped( sender);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputSystemHelper::NoteOsQueueLength( InputSystem* sys, size_t length)
+{
+  // signal when the high-water mark crosses the threshold, not for every event of the backlog
+  size_t threshold = sys->mOsQueueWarning;
+  bool isCrossing = threshold > 0 && length >= threshold && sys->mOsQueueHighWater < threshold;
+  sys->mOsQueueHighWater = std::max( sys->mOsQueueHighWater, length);
+  if( !isCrossing )
+    return;
+  InputSystem::Log( "SNIIS: %zd events waiting in the OS queue, input lags behind", length);
+  if( auto handler = GetHandler( sys, UpdateStats::Layer_Device) )
+    handler->OnOsQueueBacklog( length);
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 void InputSystemHelper::DoDigitalEvent( Device* sender, size_t btnIndex, bool isPressed)
 {
-  if( gInstance->mHandler )
-    if( gInstance->mHandler->OnDigitalEvent( sender, btnIndex, isPressed) )
+  InputSystem* sys = sender->mOwner;
+  if( auto handler = GetHandler( sys, UpdateStats::Layer_Generic) )
+    if( handler->OnDigitalEvent( sender, btnIndex, isPressed) )
       return;
 
   UpdateChannels( sender, btnIndex, false);
@@ -559,9 +1134,114 @@ void InputSystemHelper::DoDigitalEvent( Device* sender, size_t btnIndex, bool is
 // --------------------------------------------------------------------------------------------------------------------
 void InputSystemHelper::DoAnalogEvent( Device* sender, size_t axisIndex, float value)
 {
-  if( gInstance->mHandler )
-    if( gInstance->mHandler->OnAnalogEvent( sender, axisIndex, value) )
+  InputSystem* sys = sender->mOwner;
+  if( !sender->IsEnabled() )
+    return;
+  if( auto handler = GetHandler( sys, UpdateStats::Layer_Generic) )
+    if( handler->OnAnalogEvent( sender, axisIndex, value) )
       return;
 
   UpdateChannels( sender, axisIndex, true);
 }
+
+// --------------------------------------------------------------------------------------------------------------------
+// Takes the hardware time the backend set for the input being signalled, and measures its latency if asked to. The
+// time is used up either way, so that nothing else signalled later picks it up.
+void InputSystemHelper::TrackLatency( Device* sender, DeviceKind kind)
+{
+  InputSystem* sys = sender->mOwner;
+  uint64_t sourceTime = sys->mSourceTime;
+  sys->mSourceTime = 0;
+  if( sourceTime == 0 || !sys->mIsLatencyTrackingEnabled || !sender->IsEnabled() )
+    return;
+
+  uint64_t now = ReadLatencyClock();
+  sys->mLatencies[Latency_Dispatch][kind].Add( now > sourceTime ? now - sourceTime : 0);
+  sys->mPendingLatencies.push_back( InputSystem::PendingLatency{ sourceTime, kind });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void LatencyHistogram::Add( uint64_t latency)
+{
+  ++mCounts[GetBucket( latency)];
+  ++mNumSamples;
+  mMax = std::max( mMax, latency);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint64_t LatencyHistogram::GetPercentile( double fraction) const
+{
+  if( mNumSamples == 0 )
+    return 0;
+  // the sample we're looking for, counting from 1
+  uint64_t rank = std::max( uint64_t( 1), uint64_t( std::ceil( fraction * double( mNumSamples))));
+  uint64_t seen = 0;
+  for( size_t a = 0; a < NumBuckets; ++a )
+  {
+    seen += mCounts[a];
+    if( seen >= rank )
+      return std::min( GetBucketLimit( a), mMax);
+  }
+  return mMax;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+size_t LatencyHistogram::GetBucket( uint64_t latency)
+{
+  if( latency < 16 )
+    return size_t( latency);
+  // four buckets per power of two, selected by the two bits below the highest one
+  size_t exponent = 4;
+  while( exponent < 63 && (latency >> (exponent + 1)) != 0 )
+    ++exponent;
+  size_t bucket = 16 + (exponent - 4) * 4 + size_t( (latency >> (exponent - 2)) & 3);
+  return std::min( bucket, NumBuckets - 1);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint64_t LatencyHistogram::GetBucketLimit( size_t bucket)
+{
+  if( bucket < 16 )
+    return uint64_t( bucket);
+  if( bucket >= NumBuckets - 1 )
+    return UINT64_MAX;
+  // the next bucket's lower end, minus one
+  size_t next = bucket + 1;
+  size_t exponent = 4 + (next - 16) / 4;
+  return ((uint64_t( 4 + (next - 16) % 4)) << (exponent - 2)) - 1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputSystemHelper::EndStage( InputSystem* sys, UpdateStats::Stage stage, uint64_t& stageStart)
+{
+  if( stageStart == 0 )
+    return;
+  uint64_t now = ReadStatsClock();
+  if( sys->mIsUpdateStatsEnabled )
+    sys->mUpdateStats.mStageTime[stage] += now - stageStart;
+
+  if( auto tracer = sys->mTracer )
+  {
+    static const char* sStageNames[UpdateStats::Stage_Count] = { "Reset", "Start update", "Pump", "End update", "Finish" };
+    tracer->AddZone( sStageNames[stage], stageStart, now, SIZE_MAX);
+    // the stages make up the Update(), first to last
+    if( stage == UpdateStats::Stage_Reset )
+      tracer->mUpdateStart = stageStart;
+    else if( stage == UpdateStats::Stage_Finish && tracer->mUpdateStart != 0 )
+      tracer->AddZone( "Update", tracer->mUpdateStart, now, SIZE_MAX);
+  }
+  stageStart = now;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputSystemHelper::TraceInput( Device* sender, const char* name, size_t control, float value)
+{
+  if( auto tracer = sender->mOwner->mTracer )
+    tracer->AddInput( name, sender, control, value, sender->mOwner->mSourceTime);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputSystemHelper::TraceZone( InputTracer* tracer, const char* name, uint64_t start, size_t device)
+{
+  tracer->AddZone( name, start, ReadStatsClock(), device);
+}
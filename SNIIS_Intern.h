@@ -4,12 +4,17 @@
 
 #include "SNIIS.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace SNIIS
 {
   /// Platform-agnostic helper functions
   struct InputSystemHelper
   {
-    static void AddDevice( Device* dev);
+    static void AddDevice( InputSystem* sys, Device* dev);
+    static void LayoutStateArena( InputSystem* sys);
     static void DoMouseButton( Mouse* sender, size_t btnIndex, bool isPressed);
     static void DoMouseMove( Mouse* sender, float absx, float absy, float relx, float rely);
     static void DoMouseWheel(Mouse* sender, float diff);
@@ -20,5 +25,179 @@ namespace SNIIS
     static void DoDigitalEvent( Device* sender, size_t btnIndex, bool isPressed);
     static void DoAnalogEvent( Device* sender, size_t axisIndex, float value);
     static void UpdateChannels( Device* sender, size_t ctrlIndex, bool isAnalog);
+    static void CountButtonTransition( Device* dev, size_t btnIndex, bool isPressed);
+    static void CollectButtonEdges( InputSystem* sys);
+    static void FinishUpdate( InputSystem* sys);
+    static void QueueEvent( Device* sender, InputEventKind kind, size_t control, float value);
+    /// Counts and signals that the OS lost input of the device. Call before resynchronising its state.
+    static void DoInputDropped( Device* sender);
+    /// Notes the number of events waiting in the OS event queue and signals a backlog, see SetOsQueueWarning()
+    static void NoteOsQueueLength( InputSystem* sys, size_t length);
+
+    /// Returns the stats to count into, or Null if counting is disabled
+    static UpdateStats* GetUpdateStats( InputSystem* sys) { return sys->mIsUpdateStatsEnabled ? &sys->mUpdateStats : nullptr; }
+    /// Returns the handler, counting a call on the given layer if there is one
+    static InputHandler* GetHandler( InputSystem* sys, UpdateStats::HandlerLayer layer)
+    {
+      if( sys->mHandler && sys->mIsUpdateStatsEnabled )
+        ++sys->mUpdateStats.mHandlerCalls[layer];
+      return sys->mHandler;
+    }
+    /// Clock for the stage times, in nanoseconds
+    static uint64_t ReadStatsClock()
+    {
+      return uint64_t( std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    /// Clock for input latencies, in microseconds. It's the steady clock, which is CLOCK_MONOTONIC on Linux, the same
+    /// clock evdev and a local X server stamp their input with.
+    static uint64_t ReadLatencyClock()
+    {
+      return uint64_t( std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    /// Returns true if someone uses hardware times of the input, so that the backend should bother finding them out
+    static bool IsSourceTimeWanted( const InputSystem* sys) { return sys->mIsLatencyTrackingEnabled || sys->mTracer; }
+    /// Sets the hardware time of the input the backend signals next, in ReadLatencyClock() time. Zero for unknown.
+    static void SetSourceTime( InputSystem* sys, uint64_t time) { sys->mSourceTime = time; }
+    static void TrackLatency( Device* sender, DeviceKind kind);
+    /// Starts timing an Update() stage if stats or tracing want it. Returns the start time, or zero if nobody wants it.
+    static uint64_t BeginStage( InputSystem* sys) { return (sys->mIsUpdateStatsEnabled || sys->mTracer) ? ReadStatsClock() : 0; }
+    /// Adds the time since stageStart to the given stage and starts the next stage
+    static void EndStage( InputSystem* sys, UpdateStats::Stage stage, uint64_t& stageStart);
+
+    static InputTracer* GetTracer( InputSystem* sys) { return sys->mTracer; }
+    /// Traces an input about to be signalled, with the hardware time the backend set for it. The name must be static.
+    static void TraceInput( Device* sender, const char* name, size_t control, float value);
+    static void TraceZone( InputTracer* tracer, const char* name, uint64_t start, size_t device);
+  };
+
+  /// Traces the lifetime of the scope as a zone if a tracer is attached. The name must be a static string.
+  struct TraceScope
+  {
+    InputTracer* mTracer;
+    const char* mName;
+    size_t mDevice;
+    uint64_t mStart;
+
+    TraceScope( InputSystem* sys, const char* name, size_t device = SIZE_MAX)
+      : mTracer( InputSystemHelper::GetTracer( sys)), mName( name), mDevice( device)
+    {
+      mStart = mTracer ? InputSystemHelper::ReadStatsClock() : 0;
+    }
+    ~TraceScope()
+    {
+      if( mTracer )
+        InputSystemHelper::TraceZone( mTracer, mName, mStart, mDevice);
+    }
+  };
+
+  /// Installs an allocator for the current thread for the lifetime of the scope
+  struct AllocatorScope
+  {
+    Allocator* mPrevious;
+    AllocatorScope( Allocator* alloc) noexcept : mPrevious( gAllocator) { gAllocator = alloc; }
+    ~AllocatorScope() { gAllocator = mPrevious; }
+  };
+
+  /// Returns the index of the lowest bit set. Undefined for zero.
+  inline size_t CountTrailingZeros( uint64_t v)
+  {
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long idx; _BitScanForward64( &idx, v); return idx;
+#elif defined(_MSC_VER)
+    unsigned long idx;
+    if( _BitScanForward( &idx, uint32_t( v)) )
+      return idx;
+    _BitScanForward( &idx, uint32_t( v >> 32)); return idx + 32;
+#else
+    return size_t( __builtin_ctzll( v));
+#endif
+  }
+
+  /// -----------------------------------------------------------------------------------------------------------------
+  /// Compile-time lookup tables for sparse 16bit codes like keysyms or scan codes. Put the mapping into a constexpr
+  /// array of TableEntry, and MakePagedTable() turns it into a two-level page table: the high byte of a code selects
+  /// one of the pages in use, the low byte the value inside. Lookups are two array loads, no static init required.
+  template <typename Value>
+  struct TableEntry { uint32_t code; Value value; };
+
+  template <typename Value, size_t NumPages>
+  struct PagedTable
+  {
+    uint8_t mPageIndex[256]; ///< page number + 1 for each high byte, or 0 if no code of that range is mapped
+    Value mPages[NumPages][256];
+
+    constexpr Value Get( uint32_t code, Value def) const
+    {
+      return (code < 0x10000 && mPageIndex[code >> 8] != 0) ? mPages[mPageIndex[code >> 8] - 1][code & 255] : def;
+    }
   };
+
+  /// Returns the number of pages necessary for the given table. Codes above 0xffff can't be stored and are ignored.
+  template <typename Value, size_t N>
+  constexpr size_t CountTablePages( const TableEntry<Value> (&entries)[N])
+  {
+    bool isUsed[256] = {};
+    size_t count = 0;
+    for( size_t a = 0; a < N; ++a )
+    {
+      if( entries[a].code < 0x10000 && !isUsed[entries[a].code >> 8] )
+      {
+        isUsed[entries[a].code >> 8] = true;
+        ++count;
+      }
+    }
+    return count;
+  }
+
+  /// Builds the page table. Unmapped codes return def, and if a code is listed twice, the first one wins.
+  template <size_t NumPages, typename Value, size_t N>
+  constexpr PagedTable<Value, NumPages> MakePagedTable( const TableEntry<Value> (&entries)[N], Value def)
+  {
+    PagedTable<Value, NumPages> table{};
+    bool isSet[NumPages][256] = {};
+    size_t numUsed = 0;
+    for( size_t a = 0; a < N; ++a )
+    {
+      uint32_t code = entries[a].code;
+      if( code >= 0x10000 )
+        continue;
+      if( table.mPageIndex[code >> 8] == 0 )
+      {
+        table.mPageIndex[code >> 8] = uint8_t( ++numUsed);
+        for( size_t b = 0; b < 256; ++b )
+          table.mPages[numUsed - 1][b] = def;
+      }
+      size_t page = table.mPageIndex[code >> 8] - 1;
+      if( !isSet[page][code & 255] )
+      {
+        table.mPages[page][code & 255] = entries[a].value;
+        isSet[page][code & 255] = true;
+      }
+    }
+    return table;
+  }
+
+  /// Reverse direction: a direct array from value to code, for values which can be used as an index, like our keycodes.
+  template <size_t Size>
+  struct ReverseTable
+  {
+    uint32_t mCodes[Size];
+    constexpr uint32_t Get( size_t value, uint32_t def) const { return value < Size ? mCodes[value] : def; }
+  };
+
+  /// Builds the reverse table. If multiple codes map to the same value, the lowest code wins.
+  template <size_t Size, typename Value, size_t N>
+  constexpr ReverseTable<Size> MakeReverseTable( const TableEntry<Value> (&entries)[N], uint32_t def)
+  {
+    ReverseTable<Size> table{};
+    for( size_t a = 0; a < Size; ++a )
+      table.mCodes[a] = def;
+    for( size_t a = 0; a < N; ++a )
+    {
+      size_t idx = size_t( entries[a].value);
+      if( idx < Size && (table.mCodes[idx] == def || entries[a].code < table.mCodes[idx]) )
+        table.mCodes[idx] = entries[a].code;
+    }
+    return table;
+  }
 }
@@ -16,11 +16,12 @@ static bool IsBitSet( const uint8_t* bits, size_t i) { return (bits[i/8] & (1<<(
 
 // --------------------------------------------------------------------------------------------------------------------
 // Constructor
-LinuxInput::LinuxInput( Window wnd)
+LinuxInput::LinuxInput( Window wnd, const InitOptions& pOptions)
 {
   mWindow = wnd;
   mDisplay = nullptr;
 
+  uint64_t phaseStart = ReadClock();
   mDisplay = XOpenDisplay( nullptr);
   if( !mDisplay )
     throw std::runtime_error( "Failed to open XDisplay");
@@ -32,22 +33,17 @@ LinuxInput::LinuxInput( Window wnd)
   if( !isAvailable )
     throw std::runtime_error( "Failed to get XInputExtension");
 
-  // Register for events
-  XIEventMask evmask;
-  uint8_t mask[] = { 0, 0, 0, 0 };
-  XISetMask( mask, XI_HierarchyChanged);
-  XISetMask( mask, XI_RawMotion);
-  XISetMask( mask, XI_RawButtonPress);
-  XISetMask( mask, XI_RawButtonRelease);
-  XISetMask( mask, XI_RawKeyPress);
-  XISetMask( mask, XI_RawKeyRelease);
-
-  evmask.deviceid = XIAllDevices;
-  evmask.mask_len = sizeof( mask);
-  evmask.mask = mask;
-  auto selwnd = DefaultRootWindow( mDisplay);
-  if( XISelectEvents( mDisplay, selwnd, &evmask, 1) != 0 )
-    throw std::runtime_error( "Failed to register for XInput2 events");
+  // Keyboards cache their keycode translation, so we need to know when the keymap changes. Core MappingNotify covers
+  // most of it, XKB also tells us about layout switches.
+  int xkbOpcode = 0, xkbError = 0, xkbMajor = XkbMajorVersion, xkbMinor = XkbMinorVersion;
+  mXkbEventBase = -1;
+  if( XkbQueryExtension( mDisplay, &xkbOpcode, &mXkbEventBase, &xkbError, &xkbMajor, &xkbMinor) )
+    XkbSelectEvents( mDisplay, XkbUseCoreKbd, XkbNewKeyboardNotifyMask | XkbMapNotifyMask, XkbNewKeyboardNotifyMask | XkbMapNotifyMask);
+  else
+    mXkbEventBase = -1;
+
+  mStartupTimings.mConnect = ReadClock() - phaseStart;
+  phaseStart = ReadClock();
 
   int deviceCount = 0;
   XIDeviceInfo* devices = XIQueryDevice( mDisplay, XIAllDevices, &deviceCount);
@@ -58,8 +54,8 @@ LinuxInput::LinuxInput( Window wnd)
     /// that back them. "Floating slaves" are hardware that don't back a cursor.
     if( dev.use != XISlavePointer && dev.use != XISlaveKeyboard && dev.use != XIFloatingSlave )
       continue;
-    // Ignore some common pffft cases
-    if( strstr(devices[i].name, "XTEST") != nullptr )
+    // Ignore some common pffft cases, unless asked for input injected through XTest
+    if( strstr(devices[i].name, "XTEST") != nullptr && !pOptions.mUseSyntheticDevices )
       continue;
 
     // Turns out the use field is unreliable. I got reports from keyboards being reported as mice because they back
@@ -116,7 +112,7 @@ LinuxInput::LinuxInput( Window wnd)
       Log( "-> register this as mouse %d (id %d)", mNumMice, mDevices.size());
       try {
         auto m = new LinuxMouse( this, mDevices.size(), devices[i]);
-        InputSystemHelper::AddDevice( m);
+        InputSystemHelper::AddDevice( this, m);
         mMiceById[devices[i].deviceid] = m;
       } catch( std::exception& e)
       {
@@ -129,8 +125,11 @@ LinuxInput::LinuxInput( Window wnd)
     {
       Log( "-> register this as keyboard %d (id %d)", mNumKeyboards, mDevices.size());
       try {
+        // creating a keyboard is mostly building its translation table from the keymap
+        uint64_t tableStart = ReadClock();
         auto k = new LinuxKeyboard( this, mDevices.size(), devices[i]);
-        InputSystemHelper::AddDevice( k);
+        mStartupTimings.mKeyboardTables += ReadClock() - tableStart;
+        InputSystemHelper::AddDevice( this, k);
         mKeyboardsById[devices[i].deviceid] = k;
       } catch( std::exception& e)
       {
@@ -141,6 +140,13 @@ LinuxInput::LinuxInput( Window wnd)
 
   XIFreeDeviceInfo( devices);
 
+  // Register for events, but only for those of the devices we actually use
+  if( !UpdateEventSelection() )
+    throw std::runtime_error( "Failed to register for XInput2 events");
+
+  mStartupTimings.mDeviceEnumeration = ReadClock() - phaseStart - mStartupTimings.mKeyboardTables;
+  phaseStart = ReadClock();
+
   // use a completely different API for controllers, because XInput would be perfectly capable of supporting
   // those, too, but refuses to do so. It enumerates my USB headset as a keyboard, but it does not expose
   // my XBox controller. Sometimes I wish to look into the coders' minds and learn what possessed them when
@@ -196,7 +202,7 @@ LinuxInput::LinuxInput( Window wnd)
       {
         try {
           auto j = new LinuxJoystick( this, mDevices.size(), fd);
-          InputSystemHelper::AddDevice( j);
+          InputSystemHelper::AddDevice( this, j);
         } catch( std::exception& e)
         {
           Log( "Exception: %s", e.what());
@@ -207,6 +213,12 @@ LinuxInput::LinuxInput( Window wnd)
       }
     }
 	}
+
+  mStartupTimings.mControllerProbing = ReadClock() - phaseStart;
+  mStartupTimings.mTotal = ReadClock();
+  Log( "Startup took %d us: %d us connecting, %d us enumerating devices, %d us keyboard tables, %d us probing controllers",
+    int( mStartupTimings.mTotal), int( mStartupTimings.mConnect), int( mStartupTimings.mDeviceEnumeration),
+    int( mStartupTimings.mKeyboardTables), int( mStartupTimings.mControllerProbing));
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -226,26 +238,50 @@ void LinuxInput::Update()
 {
   // Basis work
   InputSystem::Update();
+  auto stats = InputSystemHelper::GetUpdateStats( this);
+  uint64_t stageStart = InputSystemHelper::BeginStage( this);
 
   // begin updating all devices
   for( auto d : mDevices )
   {
     if( auto mouse = dynamic_cast<LinuxMouse*> (d) )
       mouse->StartUpdate();
-    else if( auto keyboard = dynamic_cast<LinuxKeyboard*> (d) )
-      keyboard->StartUpdate();
     else if( auto joy = dynamic_cast<LinuxJoystick*> (d) )
+    {
+      TraceScope scope( this, "Read controller", joy->GetId());
       joy->StartUpdate();
+    }
   }
+  InputSystemHelper::EndStage( this, UpdateStats::Stage_StartUpdate, stageStart);
 
   // process XEvents
   XEvent event;
-	while( XPending( mDisplay) > 0 )
+	for( int pending = XPending( mDisplay); pending > 0; pending = XPending( mDisplay) )
 	{
+    InputSystemHelper::NoteOsQueueLength( this, size_t( pending));
 		XNextEvent( mDisplay, &event);
+    if( stats )
+    {
+      stats->mSyscalls++;
+      stats->mOsEvents++;
+    }
+
+    // keymap changes
+    if( event.type == MappingNotify || (mXkbEventBase >= 0 && event.type == mXkbEventBase) )
+    {
+      if( event.type == MappingNotify )
+        XRefreshKeyboardMapping( &event.xmapping);
+      else if( reinterpret_cast<const XkbEvent&> (event).any.xkb_type == XkbMapNotify )
+        XkbRefreshKeyboardMapping( &reinterpret_cast<XkbEvent&> (event).map);
+      for( auto& k : mKeyboardsById )
+        k.second->UpdateTranslation();
+      continue;
+    }
 
     if( event.xcookie.type != GenericEvent )
       continue;
+    else if( !mHasFocus )
+      continue; // leftovers from before we deselected everything - the focus loss already released all controls
     else if( event.xcookie.extension != mXiOpcode )
       continue;
     else if( !XGetEventData( mDisplay, &event.xcookie) )
@@ -261,6 +297,7 @@ void LinuxInput::Update()
         auto mit = mMiceById.find( rawev.deviceid);
         if( mit == mMiceById.end() )
           break;
+        TraceScope scope( this, "Parse mouse event", mit->second->GetId());
         mit->second->HandleEvent( rawev);
         break;
       }
@@ -272,6 +309,7 @@ void LinuxInput::Update()
         auto kit = mKeyboardsById.find( rawev.deviceid);
         if( kit == mKeyboardsById.end() )
           break;
+        TraceScope scope( this, "Parse keyboard event", kit->second->GetId());
         kit->second->HandleEvent( rawev);
         break;
       }
@@ -279,6 +317,10 @@ void LinuxInput::Update()
 
     XFreeEventData( mDisplay, &event.xcookie);
   }
+  // the last XPending() which found the queue empty
+  if( stats )
+    stats->mSyscalls++;
+  InputSystemHelper::EndStage( this, UpdateStats::Stage_Pump, stageStart);
 
   // update postprocessing
   for( auto d : mDevices )
@@ -289,6 +331,25 @@ void LinuxInput::Update()
     // from now on everything generates signals
     d->ResetFirstUpdateFlag();
   }
+  InputSystemHelper::EndStage( this, UpdateStats::Stage_EndUpdate, stageStart);
+
+  // list all buttons which changed during this update
+  InputSystemHelper::FinishUpdate( this);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// X server time is the server's CLOCK_MONOTONIC in milliseconds, truncated to 32 bits. For a local server that's our
+// latency clock at a coarser resolution, so we take its age against our clock. A server on another machine or with a
+// different clock gives ages that make no sense, those we skip.
+uint64_t LinuxInput::ConvertServerTime( Time time) const
+{
+  if( !InputSystemHelper::IsSourceTimeWanted( this) )
+    return 0;
+  uint64_t now = InputSystemHelper::ReadLatencyClock();
+  int32_t age = int32_t( uint32_t( now / 1000) - uint32_t( time));
+  if( age < -1 || age > 10000 )
+    return 0;
+  return now - uint64_t( std::max( age, 0)) * 1000;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -304,6 +365,85 @@ void LinuxInput::InternSetFocus( bool pHasFocus)
     else if( auto j = dynamic_cast<LinuxJoystick*> (d) )
       j->SetFocus( mHasFocus);
   }
+
+  // no focus, no events. Saves us from being woken up for every single mouse move in the background
+  if( !UpdateEventSelection() )
+    Log( "SNIIS: failed to update XInput2 event selection");
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void LinuxInput::InternSetDeviceEnabled( Device* dev, bool enabled)
+{
+  // a disabled device releases everything as if we lost focus
+  if( !enabled )
+  {
+    if( auto k = dynamic_cast<LinuxKeyboard*> (dev) )
+      k->SetFocus( false);
+    else if( auto m = dynamic_cast<LinuxMouse*> (dev) )
+      m->SetFocus( false);
+    else if( auto j = dynamic_cast<LinuxJoystick*> (dev) )
+      j->SetFocus( false);
+  }
+
+  if( !UpdateEventSelection() )
+    Log( "SNIIS: failed to update XInput2 event selection");
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool LinuxInput::UpdateEventSelection()
+{
+  // Raw events are selected per slave device. Every device we enumerated gets its own mask, depending on what we turned
+  // it into, so devices we ignore or the user disabled never wake us up. Without focus we don't want anything at all.
+  // Note that there's no such thing as "no one is interested" otherwise - even without handlers and channels the
+  // application might poll the device state at any time, so any enabled device needs to be kept up to date.
+  Map<int, EventMask> masks;
+  EventMask& all = masks[XIAllDevices];
+  memset( all.bits, 0, sizeof( all.bits));
+  XISetMask( all.bits, XI_HierarchyChanged);
+
+  for( const auto& m : mMiceById )
+  {
+    EventMask& em = masks[m.first];
+    memset( em.bits, 0, sizeof( em.bits));
+    if( mHasFocus && m.second->IsEnabled() )
+    {
+      XISetMask( em.bits, XI_RawMotion);
+      XISetMask( em.bits, XI_RawButtonPress);
+      XISetMask( em.bits, XI_RawButtonRelease);
+    }
+  }
+  for( const auto& k : mKeyboardsById )
+  {
+    // might be a mouse, too, so don't clear what the mouse loop set
+    auto it = masks.find( k.first);
+    EventMask& em = masks[k.first];
+    if( it == masks.end() )
+      memset( em.bits, 0, sizeof( em.bits));
+    if( mHasFocus && k.second->IsEnabled() )
+    {
+      XISetMask( em.bits, XI_RawKeyPress);
+      XISetMask( em.bits, XI_RawKeyRelease);
+    }
+  }
+
+  // only send what changed. An all-zero mask removes the selection for that device on the server side.
+  Vector<XIEventMask> changed;
+  for( auto& m : masks )
+  {
+    auto it = mSelectedEvents.find( m.first);
+    if( it != mSelectedEvents.end() && memcmp( it->second.bits, m.second.bits, sizeof( m.second.bits)) == 0 )
+      continue;
+    changed.push_back( XIEventMask{ m.first, int( sizeof( m.second.bits)), m.second.bits });
+  }
+  if( changed.empty() )
+    return true;
+
+  auto selwnd = DefaultRootWindow( mDisplay);
+  if( XISelectEvents( mDisplay, selwnd, changed.data(), int( changed.size())) != 0 )
+    return false;
+  XFlush( mDisplay);
+  mSelectedEvents = masks;
+  return true;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -322,33 +462,21 @@ void LinuxInput::InternSetMouseGrab( bool enabled)
 
 // --------------------------------------------------------------------------------------------------------------------
 // --------------------------------------------------------------------------------------------------------------------
-// Initializes the input system with the given InitArgs. When successful, gInstance is not Null.
-bool InputSystem::Initialize(void* pInitArg)
+// Creates an input system with the given InitArgs, or returns Null on error
+InputSystem* InputSystem::Create(void* pInitArg, const InitOptions& pOptions)
 {
-  if( gInstance )
-    throw std::runtime_error( "Input already initialized");
-
+  // everything created from here on lives in the application's memory, if it asked for that
+  AllocatorScope scope( pOptions.mAllocator);
   try
   {
-    gInstance = new LinuxInput( (Window) pInitArg);
+    return new LinuxInput( (Window) pInitArg, pOptions);
   } catch( std::exception& e)
   {
     // nope
     if( gLogCallback )
       gLogCallback( (std::string( "Exception while creating SNIIS instance: ") + e.what()).c_str());
-    gInstance = nullptr;
-    return false;
+    return nullptr;
   }
-
-  return true;
-}
-
-// --------------------------------------------------------------------------------------------------------------------
-// Destroys the input system. After returning gInstance is Null again
-void InputSystem::Shutdown()
-{
-  delete gInstance;
-  gInstance = nullptr;
 }
 
 #endif // SNIIS_SYSTEM_LINUX
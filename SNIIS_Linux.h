@@ -12,6 +12,8 @@
 #include <unistd.h>
 #include <X11/Xlib.h>
 #include <X11/extensions/XInput2.h>
+#include <X11/XKBlib.h>
+#include <linux/input.h>
 
 
 class LinuxMouse;
@@ -27,13 +29,18 @@ class LinuxInput : public SNIIS::InputSystem
   Display* mDisplay;
   /// XInput2 extension opcode
   int mXiOpcode;
+  /// XKB extension event base to get notified about keymap changes, or -1 if XKB is missing
+  int mXkbEventBase;
   /// Devices by DeviceID
-  std::map<int, LinuxMouse*> mMiceById;
-  std::map<int, LinuxKeyboard*> mKeyboardsById;
+  SNIIS::Map<int, LinuxMouse*> mMiceById;
+  SNIIS::Map<int, LinuxKeyboard*> mKeyboardsById;
+  /// XInput2 event mask currently selected per X device, to avoid needless server roundtrips
+  struct EventMask { uint8_t bits[4]; };
+  SNIIS::Map<int, EventMask> mSelectedEvents;
 
 public:
   /// Constructor
-  LinuxInput( Window wnd);
+  LinuxInput( Window wnd, const SNIIS::InitOptions& pOptions);
   /// Destructor
   ~LinuxInput();
 
@@ -42,8 +49,17 @@ public:
   /// Notifies the input system that the application has lost/gained focus.
   void InternSetFocus( bool pHasFocus) override;
   void InternSetMouseGrab( bool enabled) override;
+  void InternSetDeviceEnabled( SNIIS::Device* dev, bool enabled) override;
 
   Display* GetDisplay() const { return mDisplay; }
+  /// Converts an X server timestamp to the latency clock. Returns 0 if nobody needs it or if the time doesn't
+  /// look like it came from the same clock, e.g. from a remote X server.
+  uint64_t ConvertServerTime( Time time) const;
+
+protected:
+  /// Recomputes which XInput2 events we need from which device and tells the X server if anything changed.
+  /// Returns false if the X server refused.
+  bool UpdateEventSelection();
 };
 
 /// -------------------------------------------------------------------------------------------------------------------
@@ -53,13 +69,14 @@ class LinuxMouse : public SNIIS::Mouse
   LinuxInput* mSystem;
   int mDeviceId;
   struct Button { Atom label; };
-  std::vector<Button> mButtons;
-  struct Axis { Atom label; double min, max; double value, prevValue; bool isAbsolute; };
-  std::vector<Axis> mAxes;
-  struct State
-  {
-    uint32_t buttons, prevButtons;
-  } mState;
+  SNIIS::Vector<Button> mButtons;
+  /// The value is accumulated in double, the state arena only gets it rounded to float. Summing relative movements in
+  /// float would lose the fractions once the position gets large, so the changes per update come from value and
+  /// prevValue, the value at the start of the update.
+  struct Axis { Atom label; double min, max; bool isAbsolute; double value, prevValue; };
+  SNIIS::Vector<Axis> mAxes;
+  SNIIS::Vector<double> mAxisDiffs; ///< scratch space for HandleEvent(), one per axis
+  uint64_t mMoveTime, mWheelTime; ///< hardware time of the first movement not signalled yet, or zero
 
 public:
   LinuxMouse( LinuxInput* pSystem, size_t pId, const XIDeviceInfo& pDeviceInfo);
@@ -73,18 +90,13 @@ public:
   std::string GetButtonText( size_t idx) const override;
   size_t GetNumAxes() const override;
   std::string GetAxisText( size_t idx) const override;
-  bool IsButtonDown( size_t idx) const override;
-  bool WasButtonPressed( size_t idx) const override;
-  bool WasButtonReleased( size_t idx) const override;
-  float GetAxisAbsolute( size_t idx) const override;
-  float GetAxisDifference( size_t idx) const override;
   float GetMouseX() const override;
   float GetMouseY() const override;
   float GetRelMouseX() const override;
   float GetRelMouseY() const override;
 private:
-  void DoMouseMove( double* diffs, size_t diffcount);
-  void DoMouseWheel( double wheel);
+  void DoMouseMove( double* diffs, size_t diffcount, uint64_t time);
+  void DoMouseWheel( double wheel, uint64_t time);
   void DoMouseButton( size_t btnIndex, bool isPressed);
 };
 
@@ -95,26 +107,24 @@ class LinuxKeyboard : public SNIIS::Keyboard
   LinuxInput* mSystem;
   int mDeviceId;
   size_t mNumKeys;
-  std::vector<uint32_t> mExtraButtons;
-	std::vector<uint64_t> mState, mPrevState; ///< current and previous keystate
+  SNIIS::Vector<uint32_t> mKeycodes; ///< X keycodes reported by the device
+  SNIIS::Vector<uint32_t> mExtraButtons; ///< X keycodes of keys we had to assign custom keycodes to
+  /// Translation of each X keycode, rebuilt whenever the keymap changes
+  struct Translation { SNIIS::KeyCode kc; uint32_t unicode[2]; }; ///< unicode for unshifted and shifted
+  Translation mTranslation[256];
 
 public:
   LinuxKeyboard(LinuxInput* pSystem, size_t pId, const XIDeviceInfo& pDeviceInfo);
 
-  void StartUpdate();
   void HandleEvent( const XIRawEvent& ev);
   void SetFocus( bool pHasFocus);
+  /// Rebuilds the keycode translation from the current keymap
+  void UpdateTranslation();
 
   size_t GetNumButtons() const override;
   std::string GetButtonText( size_t idx) const override;
-  bool IsButtonDown( size_t idx) const override;
-  bool WasButtonPressed( size_t idx) const override;
-  bool WasButtonReleased( size_t idx) const override;
 protected:
   void DoKeyboardButton( SNIIS::KeyCode kc, size_t unicode, bool isPressed);
-  void Set( size_t kc, bool set);
-  bool IsSet( size_t kc) const;
-  bool WasSet( size_t kc) const;
   size_t TranslateText( size_t kc);
 };
 
@@ -122,19 +132,28 @@ protected:
 /// Linux joystick
 class LinuxJoystick : public SNIIS::Joystick
 {
-  LinuxInput* mSystem;
-  int mFileDesc;
+public:
+  /// evdev code and range of an axis, evdev code of a button
   struct Axis { size_t idx; bool isAbsolute; int32_t min, max, flat; };
-  std::vector<Axis> mAxes;
   struct Button { size_t idx; };
-  std::vector<Button> mButtons;
-  struct State {
-    uint64_t buttons, prevButtons;
-    float axes[16], diffs[16];
-  } mState;
+
+private:
+  SNIIS::InputSystem* mSystem;
+  int mFileDesc;
+  SNIIS::Vector<Axis> mAxes;
+  SNIIS::Vector<Button> mButtons;
+  bool mIsDropping; ///< true after the kernel lost events until the end of the broken report, see Resync()
+  bool mHasMonotonicTime; ///< true if the kernel stamps our events with CLOCK_MONOTONIC, which we can compare to
+  SNIIS::Vector<uint64_t> mAxisTimes; ///< hardware time of the first change of each axis not signalled yet, or zero
+  SNIIS::Vector<uint8_t> mChangedAxes; ///< true for each axis changed but not signalled yet
+  SNIIS::Vector<input_event> mPendingReport; ///< events read since the last SYN_REPORT, possibly over several updates
 
 public:
-  LinuxJoystick( LinuxInput* pSystem, size_t pId, int pFileDesc);
+  LinuxJoystick( SNIIS::InputSystem* pSystem, size_t pId, int pFileDesc);
+  /// Creates a controller with the given controls on any file delivering evdev input_event records, e.g. a pipe,
+  /// without asking the kernel. For feeding synthetic or recorded controller input, like the benchmarks do.
+  LinuxJoystick( SNIIS::InputSystem* pSystem, size_t pId, int pFileDesc, const SNIIS::Vector<Axis>& pAxes,
+    const SNIIS::Vector<Button>& pButtons);
 
   void StartUpdate();
   void SetFocus( bool pHasFocus);
@@ -143,12 +162,14 @@ public:
   std::string GetButtonText( size_t idx) const override;
   size_t GetNumAxes() const override;
   std::string GetAxisText( size_t idx) const override;
-
-  bool IsButtonDown( size_t idx) const override;
-  bool WasButtonPressed( size_t idx) const override;
-  bool WasButtonReleased( size_t idx) const override;
-  float GetAxisAbsolute( size_t idx) const override;
-  float GetAxisDifference( size_t idx) const override;
+protected:
+  /// Returns the hardware time of an event for latency tracking, or zero
+  uint64_t GetEventTime( const input_event& ev) const;
+  /// Maps a raw axis value to -1..1, or to 0..1 for one-sided axes like triggers
+  float NormalizeAxis( const Axis& axis, int32_t value) const;
+  void ApplyReport();
+  void SignalAxes();
+  void Resync();
 };
 
 #endif // SNIIS_SYSTEM_LINUX
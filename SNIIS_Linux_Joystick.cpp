@@ -6,6 +6,7 @@
 
 #if SNIIS_SYSTEM_LINUX
 #include <cstring>
+#include <stdexcept>
 #include <linux/input.h>
 
 using namespace SNIIS;
@@ -13,11 +14,9 @@ using namespace SNIIS;
 static bool IsBitSet( const uint8_t* bits, size_t i) { return (bits[i/8] & (1<<(i&7))) != 0; }
 
 // --------------------------------------------------------------------------------------------------------------------
-LinuxJoystick::LinuxJoystick( LinuxInput* pSystem, size_t pId, int pFileDesc)
+LinuxJoystick::LinuxJoystick( InputSystem* pSystem, size_t pId, int pFileDesc)
   : Joystick( pId), mSystem( pSystem), mFileDesc( pFileDesc)
 {
-  memset( &mState, 0, sizeof( mState));
-
   // enumerate, now for real
   uint8_t ev_bits[(EV_MAX+7)/8];
 	memset( ev_bits, 0, sizeof(ev_bits) );
@@ -83,106 +82,225 @@ LinuxJoystick::LinuxJoystick( LinuxInput* pSystem, size_t pId, int pFileDesc)
       }
     }
   }
+
+  mIsDropping = false;
+
+  // events are stamped with the wall clock by default, which jumps. Ask for the clock we measure latencies with.
+  mHasMonotonicTime = false;
+#ifdef EVIOCSCLOCKID
+  int clockId = CLOCK_MONOTONIC;
+  mHasMonotonicTime = (ioctl( mFileDesc, EVIOCSCLOCKID, &clockId) == 0);
+#endif
+  mAxisTimes.resize( mAxes.size(), 0);
+  mChangedAxes.resize( mAxes.size(), false);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-void LinuxJoystick::StartUpdate()
+LinuxJoystick::LinuxJoystick( InputSystem* pSystem, size_t pId, int pFileDesc, const Vector<Axis>& pAxes,
+    const Vector<Button>& pButtons)
+  : Joystick( pId), mSystem( pSystem), mFileDesc( pFileDesc), mAxes( pAxes), mButtons( pButtons)
 {
-  mState.prevButtons = mState.buttons;
-  memset( mState.diffs, 0, sizeof( mState.diffs));
-  float prevAxes[16];
-  static_assert( sizeof( prevAxes) == sizeof( mState.axes), "Hardcoded array size");
-  memcpy( prevAxes, mState.axes, sizeof( mState.axes));
+  // no kernel to stamp the events, they carry whatever time the writer put in
+  mIsDropping = false;
+  mHasMonotonicTime = false;
+  mAxisTimes.resize( mAxes.size(), 0);
+  mChangedAxes.resize( mAxes.size(), false);
+}
 
-  // read events from file descriptor
+// --------------------------------------------------------------------------------------------------------------------
+uint64_t LinuxJoystick::GetEventTime( const input_event& ev) const
+{
+  if( !mHasMonotonicTime || !InputSystemHelper::IsSourceTimeWanted( mSystem) )
+    return 0;
+  return uint64_t( ev.time.tv_sec) * 1000000 + uint64_t( ev.time.tv_usec);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void LinuxJoystick::StartUpdate()
+{
+  // read events from file descriptor. The events of a report are collected up to its SYN_REPORT and then applied
+  // together, also if the report was split across reads or updates.
 	input_event js[64];
+  auto stats = InputSystemHelper::GetUpdateStats( mSystem);
+  bool isEachReport = (mSystem->GetReportMode() == SNIIS::Report_Each);
 	while( true )
 	{
 		int ret = read( mFileDesc, &js, sizeof(js));
+    if( stats )
+      stats->mSyscalls++;
     if( ret <= 0 )
 			break;
 
 		size_t numEvents = size_t( ret) / sizeof(struct input_event);
+    if( stats )
+      stats->mDeviceEvents += numEvents;
 		for( size_t a = 0; a < numEvents; ++a )
 		{
       const auto& ev = js[a];
-			switch( ev.type )
-			{
-        case EV_KEY: // Button
-        {
-          size_t bt = ev.code;
-          auto it = std::find_if( mButtons.cbegin(), mButtons.cend(), [=](const Button& b) { return b.idx == bt; });
-          if( it == mButtons.cend() )
-            break;
-
-          size_t btidx = std::distance( mButtons.cbegin(), it);
-          bool isPressed = (ev.value != 0);
-          if( isPressed )
-            mState.buttons |= 1ull << btidx;
-          else
-            mState.buttons &= (UINT64_MAX ^ (1ull << btidx));
+      if( ev.type != EV_SYN )
+      {
+        // after an overflow the kernel sends the rest of the broken report, which we skip up to the report's end
+        if( !mIsDropping )
+          mPendingReport.push_back( ev);
+        continue;
+      }
 
-          break;
+      if( ev.code == SYN_DROPPED )
+      {
+        mIsDropping = true;
+        mPendingReport.clear();
+        InputSystemHelper::DoInputDropped( this);
+      }
+      else if( ev.code == SYN_REPORT )
+      {
+        if( mIsDropping )
+        {
+          mIsDropping = false;
+          Resync();
         }
-
-        case EV_ABS: // Absolute Axis
+        else
         {
-          size_t ax = ev.code;
-          auto it = std::find_if( mAxes.cbegin(), mAxes.cend(), [=](const Axis& c) { return c.isAbsolute && c.idx == ax; });
-          if( it == mAxes.cend() )
-            break;
-
-          size_t axidx = std::distance( mAxes.cbegin(), it);
-          float v = 0.0f;
-          // try to tell one-sided axes apart from symmetric axes and act accordingly
-          if( std::abs( it->min) <= std::abs( it->max) / 10 )
-            v = float( ev.value - it->min) / float( it->max - it->min);
-          else
-            v = (float( ev.value - it->min) / float( it->max - it->min)) * 2.0f - 1.0f;
-          mState.diffs[axidx] = v - mState.axes[axidx];
-          mState.axes[axidx] = v;
+          ApplyReport();
+        }
+
+        if( isEachReport )
+          SignalAxes();
+      }
+		}
+	}
 
+  if( !isEachReport )
+    SignalAxes();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Applies the events of a complete report. Buttons are signalled right away in their order, so a tap between two
+// updates isn't lost. Axes are only marked, SignalAxes() signals them.
+void LinuxJoystick::ApplyReport()
+{
+  for( const auto& ev : mPendingReport )
+  {
+    switch( ev.type )
+    {
+      case EV_KEY: // Button
+      {
+        size_t bt = ev.code;
+        auto it = std::find_if( mButtons.cbegin(), mButtons.cend(), [=](const Button& b) { return b.idx == bt; });
+        if( it == mButtons.cend() )
           break;
-        }
 
-        case EV_REL: // Relative Axis.
+        size_t btidx = std::distance( mButtons.cbegin(), it);
+        bool isPressed = (ev.value != 0);
+        if( isPressed == IsButtonBitSet( btidx) )
+          break;
+        SetButtonBit( btidx, isPressed);
+        if( !mIsFirstUpdate )
         {
-          size_t ax = ev.code;
-          auto it = std::find_if( mAxes.cbegin(), mAxes.cend(), [=](const Axis& c) { return !c.isAbsolute && c.idx == ax; });
-          if( it == mAxes.cend() )
-            break;
+          InputSystemHelper::SetSourceTime( mSystem, GetEventTime( ev));
+          InputSystemHelper::DoJoystickButton( this, btidx, isPressed);
+        }
 
-          size_t axidx = std::distance( mAxes.cbegin(), it);
-          float d = float( ev.value);
-          mState.diffs[axidx] += d;
-          mState.axes[axidx] += d;
+        break;
+      }
 
+      case EV_ABS: // Absolute Axis
+      case EV_REL: // Relative Axis.
+      {
+        size_t ax = ev.code;
+        bool isAbsolute = (ev.type == EV_ABS);
+        auto it = std::find_if( mAxes.cbegin(), mAxes.cend(), [=](const Axis& c) { return c.isAbsolute == isAbsolute && c.idx == ax; });
+        if( it == mAxes.cend() )
           break;
-        }
 
-        default:
+        size_t axidx = std::distance( mAxes.cbegin(), it);
+        float value = isAbsolute ? NormalizeAxis( *it, ev.value) : GetAxisValue( axidx) + float( ev.value);
+        if( value == GetAxisValue( axidx) )
           break;
-			}
-		}
-	}
+        SetAxisValue( axidx, value);
+        mChangedAxes[axidx] = true;
+        if( mAxisTimes[axidx] == 0 )
+          mAxisTimes[axidx] = GetEventTime( ev);
 
-  // send events - Axes
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+  InputSystemHelper::SetSourceTime( mSystem, 0);
+  mPendingReport.clear();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Signals the axes changed since the last call. Each one carries the time of its first change, that's how long the
+// oldest part waited. Once per update, an axis which changed and went back to its previous value isn't signalled.
+void LinuxJoystick::SignalAxes()
+{
+  bool isEachReport = (mSystem->GetReportMode() == SNIIS::Report_Each);
   for( size_t i = 0; i < mAxes.size(); i++ )
   {
-    if( mState.axes[i] != prevAxes[i] )
+    if( !mChangedAxes[i] )
+      continue;
+    if( !mIsFirstUpdate && (isEachReport || GetAxisValue( i) != GetPrevAxisValue( i)) )
     {
-      mState.diffs[i] = mState.axes[i] - prevAxes[i];
+      InputSystemHelper::SetSourceTime( mSystem, mAxisTimes[i]);
+      InputSystemHelper::DoJoystickAxis( this, i, GetAxisValue( i));
+    }
+    mChangedAxes[i] = false;
+    mAxisTimes[i] = 0;
+  }
+  InputSystemHelper::SetSourceTime( mSystem, 0);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+float LinuxJoystick::NormalizeAxis( const Axis& axis, int32_t value) const
+{
+  // try to tell one-sided axes apart from symmetric axes and act accordingly
+  if( std::abs( axis.min) <= std::abs( axis.max) / 10 )
+    return float( value - axis.min) / float( axis.max - axis.min);
+  else
+    return (float( value - axis.min) / float( axis.max - axis.min)) * 2.0f - 1.0f;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// The kernel's buffer overflowed and events got lost, so we read the current state of all buttons and absolute axes
+// and apply the differences. Buttons are signalled right away like their events, axes by SignalAxes().
+// Relative axes have no state to read, their lost movement stays lost.
+void LinuxJoystick::Resync()
+{
+  auto stats = InputSystemHelper::GetUpdateStats( mSystem);
+  uint8_t key_bits[(KEY_MAX+7)/8];
+  memset( key_bits, 0, sizeof(key_bits) );
+  if( stats )
+    stats->mSyscalls++;
+  if( ioctl( mFileDesc, EVIOCGKEY( sizeof(key_bits)), key_bits) >= 0 )
+  {
+    for( size_t b = 0; b < mButtons.size(); ++b )
+    {
+      bool isPressed = IsBitSet( key_bits, mButtons[b].idx);
+      if( isPressed == IsButtonBitSet( b) )
+        continue;
+      SetButtonBit( b, isPressed);
       if( !mIsFirstUpdate )
-        InputSystemHelper::DoJoystickAxis( this, i, mState.axes[i]);
+        InputSystemHelper::DoJoystickButton( this, b, isPressed);
     }
   }
 
-  // send events - buttons
-  for( size_t i = 0; i < mButtons.size(); i++ )
+  for( size_t a = 0; a < mAxes.size(); ++a )
   {
-    if( !mIsFirstUpdate )
-      if( (mState.buttons ^ mState.prevButtons) & (1ull << i) )
-        InputSystemHelper::DoJoystickButton( this, i, (mState.buttons & (1ull << i)) != 0);
+    if( !mAxes[a].isAbsolute )
+      continue;
+    input_absinfo abInfo;
+    if( stats )
+      stats->mSyscalls++;
+    if( ioctl( mFileDesc, EVIOCGABS( mAxes[a].idx), &abInfo) == -1 )
+      continue;
+    float value = NormalizeAxis( mAxes[a], abInfo.value);
+    if( value == GetAxisValue( a) )
+      continue;
+    SetAxisValue( a, value);
+    mChangedAxes[a] = true;
   }
 }
 
@@ -199,20 +317,19 @@ void LinuxJoystick::SetFocus( bool pHasFocus)
     // zero all buttons and axes
     for( size_t a = 0; a < mAxes.size(); ++a )
     {
-      if( mState.axes[a] != 0.0f )
+      if( GetAxisValue( a) != 0.0f )
       {
-        mState.diffs[a] = -mState.axes[a];
-        mState.axes[a] = 0.0f;
+        SetAxisValue( a, 0.0f);
         InputSystemHelper::DoJoystickAxis( this, a, 0.0f);
       }
     }
 
     for( size_t a = 0; a < mButtons.size(); ++a )
     {
-      if( mState.buttons & (1ull << a) )
+      if( IsButtonBitSet( a) )
       {
-        mState.buttons &= UINT64_MAX ^ (1ull << a);
-        mState.prevButtons |= 1ull << a;
+        SetButtonBit( a, false);
+        SetPrevButtonBit( a, true);
         InputSystemHelper::DoJoystickButton( this, a, false);
       }
     }
@@ -240,45 +357,4 @@ std::string LinuxJoystick::GetAxisText( size_t idx) const
   return "";
 }
 
-// --------------------------------------------------------------------------------------------------------------------
-bool LinuxJoystick::IsButtonDown( size_t idx) const
-{
-  if( idx < mButtons.size() )
-    return (mState.buttons & (1ull << idx)) != 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool LinuxJoystick::WasButtonPressed( size_t idx) const
-{
-  if( idx < mButtons.size() )
-    return IsButtonDown( idx) && ((mState.prevButtons & (1ull << idx)) == 0);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool LinuxJoystick::WasButtonReleased( size_t idx) const
-{
-  if( idx < mButtons.size() )
-    return !IsButtonDown( idx) && ((mState.prevButtons & (1ull << idx)) != 0);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-float LinuxJoystick::GetAxisAbsolute( size_t idx) const
-{
-  if( idx < mAxes.size() )
-    return mState.axes[idx];
-  else
-    return 0.0f;
-}
-// --------------------------------------------------------------------------------------------------------------------
-float LinuxJoystick::GetAxisDifference( size_t idx) const
-{
-  if( idx < mAxes.size() )
-    return mState.diffs[idx];
-  else
-    return 0.0f;
-}
-
 #endif // SNIIS_SYSTEM_LINUX
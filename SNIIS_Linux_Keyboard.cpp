@@ -11,160 +11,158 @@
 using namespace SNIIS;
 
 /// constant table to map linux key codes to our key codes
-typedef std::map<uint32_t, SNIIS::KeyCode> KeyTable;
-const KeyTable sKeyTable( {
-    KeyTable::value_type(XK_1, KC_1),
-    KeyTable::value_type(XK_2, KC_2),
-    KeyTable::value_type(XK_3, KC_3),
-    KeyTable::value_type(XK_4, KC_4),
-    KeyTable::value_type(XK_5, KC_5),
-    KeyTable::value_type(XK_6, KC_6),
-    KeyTable::value_type(XK_7, KC_7),
-    KeyTable::value_type(XK_8, KC_8),
-    KeyTable::value_type(XK_9, KC_9),
-    KeyTable::value_type(XK_0, KC_0),
+constexpr TableEntry<SNIIS::KeyCode> sKeyEntries[] = {
+    { XK_1, KC_1 },
+    { XK_2, KC_2 },
+    { XK_3, KC_3 },
+    { XK_4, KC_4 },
+    { XK_5, KC_5 },
+    { XK_6, KC_6 },
+    { XK_7, KC_7 },
+    { XK_8, KC_8 },
+    { XK_9, KC_9 },
+    { XK_0, KC_0 },
 
-    KeyTable::value_type(XK_BackSpace, KC_BACK),
+    { XK_BackSpace, KC_BACK },
 
-    KeyTable::value_type(XK_minus, KC_MINUS),
-    KeyTable::value_type(XK_equal, KC_EQUALS),
-    KeyTable::value_type(XK_space, KC_SPACE),
-    KeyTable::value_type(XK_comma, KC_COMMA),
-    KeyTable::value_type(XK_period, KC_PERIOD),
+    { XK_minus, KC_MINUS },
+    { XK_equal, KC_EQUALS },
+    { XK_space, KC_SPACE },
+    { XK_comma, KC_COMMA },
+    { XK_period, KC_PERIOD },
 
-    KeyTable::value_type(XK_backslash, KC_BACKSLASH),
-    KeyTable::value_type(XK_slash, KC_SLASH),
-    KeyTable::value_type(XK_bracketleft, KC_LBRACKET),
-    KeyTable::value_type(XK_bracketright, KC_RBRACKET),
+    { XK_backslash, KC_BACKSLASH },
+    { XK_slash, KC_SLASH },
+    { XK_bracketleft, KC_LBRACKET },
+    { XK_bracketright, KC_RBRACKET },
 
-    KeyTable::value_type(XK_Escape,KC_ESCAPE),
-    KeyTable::value_type(XK_Caps_Lock, KC_CAPITAL),
+    { XK_Escape, KC_ESCAPE },
+    { XK_Caps_Lock, KC_CAPITAL },
 
-    KeyTable::value_type(XK_Tab, KC_TAB),
-    KeyTable::value_type(XK_Return, KC_RETURN),
-    KeyTable::value_type(XK_Control_L, KC_LCONTROL),
-    KeyTable::value_type(XK_Control_R, KC_RCONTROL),
+    { XK_Tab, KC_TAB },
+    { XK_Return, KC_RETURN },
+    { XK_Control_L, KC_LCONTROL },
+    { XK_Control_R, KC_RCONTROL },
 
-    KeyTable::value_type(XK_colon, KC_COLON),
-    KeyTable::value_type(XK_semicolon, KC_SEMICOLON),
-    KeyTable::value_type(XK_apostrophe, KC_APOSTROPHE),
-    KeyTable::value_type(XK_grave, KC_GRAVE),
+    { XK_colon, KC_COLON },
+    { XK_semicolon, KC_SEMICOLON },
+    { XK_apostrophe, KC_APOSTROPHE },
+    { XK_grave, KC_GRAVE },
 
-    KeyTable::value_type(XK_b, KC_B),
-    KeyTable::value_type(XK_a, KC_A),
-    KeyTable::value_type(XK_c, KC_C),
-    KeyTable::value_type(XK_d, KC_D),
-    KeyTable::value_type(XK_e, KC_E),
-    KeyTable::value_type(XK_f, KC_F),
-    KeyTable::value_type(XK_g, KC_G),
-    KeyTable::value_type(XK_h, KC_H),
-    KeyTable::value_type(XK_i, KC_I),
-    KeyTable::value_type(XK_j, KC_J),
-    KeyTable::value_type(XK_k, KC_K),
-    KeyTable::value_type(XK_l, KC_L),
-    KeyTable::value_type(XK_m, KC_M),
-    KeyTable::value_type(XK_n, KC_N),
-    KeyTable::value_type(XK_o, KC_O),
-    KeyTable::value_type(XK_p, KC_P),
-    KeyTable::value_type(XK_q, KC_Q),
-    KeyTable::value_type(XK_r, KC_R),
-    KeyTable::value_type(XK_s, KC_S),
-    KeyTable::value_type(XK_t, KC_T),
-    KeyTable::value_type(XK_u, KC_U),
-    KeyTable::value_type(XK_v, KC_V),
-    KeyTable::value_type(XK_w, KC_W),
-    KeyTable::value_type(XK_x, KC_X),
-    KeyTable::value_type(XK_y, KC_Y),
-    KeyTable::value_type(XK_z, KC_Z),
+    { XK_b, KC_B },
+    { XK_a, KC_A },
+    { XK_c, KC_C },
+    { XK_d, KC_D },
+    { XK_e, KC_E },
+    { XK_f, KC_F },
+    { XK_g, KC_G },
+    { XK_h, KC_H },
+    { XK_i, KC_I },
+    { XK_j, KC_J },
+    { XK_k, KC_K },
+    { XK_l, KC_L },
+    { XK_m, KC_M },
+    { XK_n, KC_N },
+    { XK_o, KC_O },
+    { XK_p, KC_P },
+    { XK_q, KC_Q },
+    { XK_r, KC_R },
+    { XK_s, KC_S },
+    { XK_t, KC_T },
+    { XK_u, KC_U },
+    { XK_v, KC_V },
+    { XK_w, KC_W },
+    { XK_x, KC_X },
+    { XK_y, KC_Y },
+    { XK_z, KC_Z },
 
-    KeyTable::value_type(XK_F1, KC_F1),
-    KeyTable::value_type(XK_F2, KC_F2),
-    KeyTable::value_type(XK_F3, KC_F3),
-    KeyTable::value_type(XK_F4, KC_F4),
-    KeyTable::value_type(XK_F5, KC_F5),
-    KeyTable::value_type(XK_F6, KC_F6),
-    KeyTable::value_type(XK_F7, KC_F7),
-    KeyTable::value_type(XK_F8, KC_F8),
-    KeyTable::value_type(XK_F9, KC_F9),
-    KeyTable::value_type(XK_F10, KC_F10),
-    KeyTable::value_type(XK_F11, KC_F11),
-    KeyTable::value_type(XK_F12, KC_F12),
-    KeyTable::value_type(XK_F13, KC_F13),
-    KeyTable::value_type(XK_F14, KC_F14),
-    KeyTable::value_type(XK_F15, KC_F15),
+    { XK_F1, KC_F1 },
+    { XK_F2, KC_F2 },
+    { XK_F3, KC_F3 },
+    { XK_F4, KC_F4 },
+    { XK_F5, KC_F5 },
+    { XK_F6, KC_F6 },
+    { XK_F7, KC_F7 },
+    { XK_F8, KC_F8 },
+    { XK_F9, KC_F9 },
+    { XK_F10, KC_F10 },
+    { XK_F11, KC_F11 },
+    { XK_F12, KC_F12 },
+    { XK_F13, KC_F13 },
+    { XK_F14, KC_F14 },
+    { XK_F15, KC_F15 },
 
     //Keypad
-    KeyTable::value_type(XK_KP_0, KC_NUMPAD0),
-    KeyTable::value_type(XK_KP_1, KC_NUMPAD1),
-    KeyTable::value_type(XK_KP_2, KC_NUMPAD2),
-    KeyTable::value_type(XK_KP_3, KC_NUMPAD3),
-    KeyTable::value_type(XK_KP_4, KC_NUMPAD4),
-    KeyTable::value_type(XK_KP_5, KC_NUMPAD5),
-    KeyTable::value_type(XK_KP_6, KC_NUMPAD6),
-    KeyTable::value_type(XK_KP_7, KC_NUMPAD7),
-    KeyTable::value_type(XK_KP_8, KC_NUMPAD8),
-    KeyTable::value_type(XK_KP_9, KC_NUMPAD9),
-    KeyTable::value_type(XK_KP_Add, KC_ADD),
-    KeyTable::value_type(XK_KP_Subtract, KC_SUBTRACT),
-    KeyTable::value_type(XK_KP_Decimal, KC_DECIMAL),
-    KeyTable::value_type(XK_KP_Equal, KC_NUMPADEQUALS),
-    KeyTable::value_type(XK_KP_Divide, KC_DIVIDE),
-    KeyTable::value_type(XK_KP_Multiply, KC_MULTIPLY),
-    KeyTable::value_type(XK_KP_Enter, KC_NUMPADENTER),
+    { XK_KP_0, KC_NUMPAD0 },
+    { XK_KP_1, KC_NUMPAD1 },
+    { XK_KP_2, KC_NUMPAD2 },
+    { XK_KP_3, KC_NUMPAD3 },
+    { XK_KP_4, KC_NUMPAD4 },
+    { XK_KP_5, KC_NUMPAD5 },
+    { XK_KP_6, KC_NUMPAD6 },
+    { XK_KP_7, KC_NUMPAD7 },
+    { XK_KP_8, KC_NUMPAD8 },
+    { XK_KP_9, KC_NUMPAD9 },
+    { XK_KP_Add, KC_ADD },
+    { XK_KP_Subtract, KC_SUBTRACT },
+    { XK_KP_Decimal, KC_DECIMAL },
+    { XK_KP_Equal, KC_NUMPADEQUALS },
+    { XK_KP_Divide, KC_DIVIDE },
+    { XK_KP_Multiply, KC_MULTIPLY },
+    { XK_KP_Enter, KC_NUMPADENTER },
 
     //Keypad with numlock off
-    KeyTable::value_type(XK_KP_Home, KC_NUMPAD7),
-    KeyTable::value_type(XK_KP_Up, KC_NUMPAD8),
-    KeyTable::value_type(XK_KP_Page_Up, KC_NUMPAD9),
-    KeyTable::value_type(XK_KP_Left, KC_NUMPAD4),
-    KeyTable::value_type(XK_KP_Begin, KC_NUMPAD5),
-    KeyTable::value_type(XK_KP_Right, KC_NUMPAD6),
-    KeyTable::value_type(XK_KP_End, KC_NUMPAD1),
-    KeyTable::value_type(XK_KP_Down, KC_NUMPAD2),
-    KeyTable::value_type(XK_KP_Page_Down, KC_NUMPAD3),
-    KeyTable::value_type(XK_KP_Insert, KC_NUMPAD0),
-    KeyTable::value_type(XK_KP_Delete, KC_DECIMAL),
+    { XK_KP_Home, KC_NUMPAD7 },
+    { XK_KP_Up, KC_NUMPAD8 },
+    { XK_KP_Page_Up, KC_NUMPAD9 },
+    { XK_KP_Left, KC_NUMPAD4 },
+    { XK_KP_Begin, KC_NUMPAD5 },
+    { XK_KP_Right, KC_NUMPAD6 },
+    { XK_KP_End, KC_NUMPAD1 },
+    { XK_KP_Down, KC_NUMPAD2 },
+    { XK_KP_Page_Down, KC_NUMPAD3 },
+    { XK_KP_Insert, KC_NUMPAD0 },
+    { XK_KP_Delete, KC_DECIMAL },
 
-    KeyTable::value_type(XK_Up, KC_UP),
-    KeyTable::value_type(XK_Down, KC_DOWN),
-    KeyTable::value_type(XK_Left, KC_LEFT),
-    KeyTable::value_type(XK_Right, KC_RIGHT),
+    { XK_Up, KC_UP },
+    { XK_Down, KC_DOWN },
+    { XK_Left, KC_LEFT },
+    { XK_Right, KC_RIGHT },
 
-    KeyTable::value_type(XK_Page_Up, KC_PGUP),
-    KeyTable::value_type(XK_Page_Down, KC_PGDOWN),
-    KeyTable::value_type(XK_Home, KC_HOME),
-    KeyTable::value_type(XK_End, KC_END),
+    { XK_Page_Up, KC_PGUP },
+    { XK_Page_Down, KC_PGDOWN },
+    { XK_Home, KC_HOME },
+    { XK_End, KC_END },
 
-    KeyTable::value_type(XK_Num_Lock, KC_NUMLOCK),
-    KeyTable::value_type(XK_Print, KC_SYSRQ),
-    KeyTable::value_type(XK_Scroll_Lock, KC_SCROLL),
-    KeyTable::value_type(XK_Pause, KC_PAUSE),
+    { XK_Num_Lock, KC_NUMLOCK },
+    { XK_Print, KC_SYSRQ },
+    { XK_Scroll_Lock, KC_SCROLL },
+    { XK_Pause, KC_PAUSE },
 
-    KeyTable::value_type(XK_Shift_R, KC_RSHIFT),
-    KeyTable::value_type(XK_Shift_L, KC_LSHIFT),
-    KeyTable::value_type(XK_Alt_R, KC_RMENU),
-    KeyTable::value_type(XK_Alt_L, KC_LMENU),
+    { XK_Shift_R, KC_RSHIFT },
+    { XK_Shift_L, KC_LSHIFT },
+    { XK_Alt_R, KC_RMENU },
+    { XK_Alt_L, KC_LMENU },
 
-    KeyTable::value_type(XK_Insert, KC_INSERT),
-    KeyTable::value_type(XK_Delete, KC_DELETE),
+    { XK_Insert, KC_INSERT },
+    { XK_Delete, KC_DELETE },
 
-    KeyTable::value_type(XK_Super_L, KC_LWIN),
-    KeyTable::value_type(XK_Super_R, KC_RWIN),
-    KeyTable::value_type(XK_Menu, KC_APPS),
-  } );
+    { XK_Super_L, KC_LWIN },
+    { XK_Super_R, KC_RWIN },
+    { XK_Menu, KC_APPS },
+  };
+/// ... as lookup tables in both directions, generated at compile time
+constexpr auto sKeyTable = MakePagedTable<CountTablePages( sKeyEntries)>( sKeyEntries, KC_UNASSIGNED);
+constexpr auto sKeysymByKeyCode = MakeReverseTable<256>( sKeyEntries, 0u);
 
 SNIIS::KeyCode ConvertKeysymToKeycode( uint32_t keysym)
 {
-  auto it = sKeyTable.find( keysym);
-  if( it != sKeyTable.end() )
-    return it->second;
-  return SNIIS::KC_UNASSIGNED;
+  return sKeyTable.Get( keysym, KC_UNASSIGNED);
 }
 
 /// Keysym to Unicode character table
 /// Adopted from http://www.cl.cam.ac.uk/~mgk25/ucs/keysym2ucs.c
-struct CodePair { uint16_t keysym, ucs; };
-const CodePair sUnicodeTable[] = {
+constexpr TableEntry<uint16_t> sUnicodeEntries[] = {
   { 0x01a1, 0x0104 }, /*                     Aogonek Ą LATIN CAPITAL LETTER A WITH OGONEK */
   { 0x01a2, 0x02d8 }, /*                       breve ˘ BREVE */
   { 0x01a3, 0x0141 }, /*                     Lstroke Ł LATIN CAPITAL LETTER L WITH STROKE */
@@ -939,13 +937,10 @@ const CodePair sUnicodeTable[] = {
   { 0x13be, 0x0178 }, /*                  Ydiaeresis Ÿ LATIN CAPITAL LETTER Y WITH DIAERESIS */
   { 0x20ac, 0x20ac }, /*                    EuroSign € EURO SIGN */
 };
+constexpr auto sUnicodeTable = MakePagedTable<CountTablePages( sUnicodeEntries)>( sUnicodeEntries, uint16_t( 0));
 
 uint32_t ConvertKeysymToUnicode( uint32_t keysym)
 {
-  int min = 0;
-  int max = sizeof( sUnicodeTable) / sizeof(CodePair) - 1;
-  int mid;
-
   /* first check for Latin-1 characters (1:1 mapping) */
   if( (keysym >= 0x0020 && keysym <= 0x007e) ||
       (keysym >= 0x00a0 && keysym <= 0x00ff) )
@@ -955,25 +950,13 @@ uint32_t ConvertKeysymToUnicode( uint32_t keysym)
   if( (keysym & 0xff000000) == 0x01000000 )
     return keysym & 0x00ffffff;
 
-  /* binary search in table */
-  while( max >= min )
-  {
-    mid = (min + max) / 2;
-    if( sUnicodeTable[mid].keysym < keysym )
-      min = mid + 1;
-    else if( sUnicodeTable[mid].keysym > keysym )
-      max = mid - 1;
-    else /* found it */
-      return sUnicodeTable[mid].ucs;
-  }
-
-  /* no matching Unicode value found */
-  return 0;
+  /* direct lookup in table, zero if no matching Unicode value is found */
+  return sUnicodeTable.Get( keysym, 0);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
 LinuxKeyboard::LinuxKeyboard( LinuxInput* pSystem, size_t pId, const XIDeviceInfo& pDeviceInfo)
-  : Keyboard( pId), mSystem( pSystem), mDeviceId( pDeviceInfo.deviceid)
+  : Keyboard( pId, false), mSystem( pSystem), mDeviceId( pDeviceInfo.deviceid)
 {
   mNumKeys = 256;
 
@@ -987,30 +970,48 @@ LinuxKeyboard::LinuxKeyboard( LinuxInput* pSystem, size_t pId, const XIDeviceInf
       {
         auto kcl = reinterpret_cast<const XIKeyClassInfo*> (cl);
         for( int b = 0; b < kcl->num_keycodes; ++b )
-        {
-          uint32_t kc = uint32_t( kcl->keycodes[b]);
-          uint32_t ks = XKeycodeToKeysym( mSystem->GetDisplay(), kc, 0);
-          auto ourkc = ConvertKeysymToKeycode( ks);
-          // if it's not mappable to one of our keycodes, map it to a custom keycode
-          if( ourkc == KC_UNASSIGNED )
-          {
-            ourkc = (SNIIS::KeyCode) (KC_FIRST_CUSTOM + mExtraButtons.size());
-            mExtraButtons.push_back(kc);
-          }
-          mNumKeys = std::max( mNumKeys, size_t( ourkc + 1));
-        }
+          mKeycodes.push_back( uint32_t( kcl->keycodes[b]));
         break;
       }
     }
   }
 
-  mState.resize( (mNumKeys+63) / 64); mPrevState.resize( mState.size());
+  UpdateTranslation();
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-void LinuxKeyboard::StartUpdate()
+void LinuxKeyboard::UpdateTranslation()
 {
-  mPrevState = mState;
+  // Build the translation for every X keycode once, so that handling a key event is a simple table lookup. Keycodes of
+  // this device that we can't map to one of our keycodes get a custom keycode. Those stay stable across keymap changes.
+  auto dpy = mSystem->GetDisplay();
+  memset( mTranslation, 0, sizeof( mTranslation));
+  // key names follow the keymap
+  InvalidateNames();
+  for( uint32_t kc = 0; kc < 256; ++kc )
+  {
+    uint32_t ks = uint32_t( XkbKeycodeToKeysym( dpy, ::KeyCode( kc), 0, 0));
+    uint32_t sks = uint32_t( XkbKeycodeToKeysym( dpy, ::KeyCode( kc), 0, 1));
+    auto& tr = mTranslation[kc];
+    tr.kc = ks ? ConvertKeysymToKeycode( ks) : KC_UNASSIGNED;
+    tr.unicode[0] = ConvertKeysymToUnicode( ks);
+    tr.unicode[1] = ConvertKeysymToUnicode( sks ? sks : ks);
+  }
+
+  for( auto kc : mKeycodes )
+  {
+    if( kc >= 256 || mTranslation[kc].kc != KC_UNASSIGNED )
+      continue;
+    auto it = std::find( mExtraButtons.cbegin(), mExtraButtons.cend(), kc);
+    if( it == mExtraButtons.cend() )
+      it = mExtraButtons.insert( mExtraButtons.cend(), kc);
+    mTranslation[kc].kc = (SNIIS::KeyCode) (KC_FIRST_CUSTOM + std::distance( mExtraButtons.cbegin(), it));
+    mNumKeys = std::max( mNumKeys, size_t( mTranslation[kc].kc + 1));
+  }
+
+  // grow our part of the state arena if the keymap gave us new custom keys
+  if( mOwner && (mNumKeys + 63) / 64 > mNumButtonWords )
+    InputSystemHelper::LayoutStateArena( mOwner);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -1022,29 +1023,23 @@ void LinuxKeyboard::HandleEvent( const XIRawEvent& ev)
     case XI_RawKeyRelease:
     {
       auto key = uint32_t( ev.detail);
+      if( key >= 256 )
+        break;
       bool isPressed = (ev.evtype == XI_RawKeyPress);
-      uint32_t ks = XKeycodeToKeysym( mSystem->GetDisplay(), key, 0);
-      SNIIS::KeyCode kc = ConvertKeysymToKeycode( ks);
-      if( ks == 0 || kc == KC_UNASSIGNED )
-      {
-        // find it in the list of extra buttons
-        auto it = std::find( mExtraButtons.cbegin(), mExtraButtons.cend(), key);
-        if( it == mExtraButtons.end() )
-          break;
-        kc = (SNIIS::KeyCode) (KC_FIRST_CUSTOM + std::distance( mExtraButtons.cbegin(), it));
-      }
+      const auto& tr = mTranslation[key];
+      SNIIS::KeyCode kc = tr.kc;
 
-      if( kc != KC_UNASSIGNED && isPressed != IsSet( kc) )
+      if( kc != KC_UNASSIGNED && isPressed != IsButtonBitSet( kc) )
       {
-        if( !mIsFirstUpdate )
-          InputSystemHelper::SortThisKeyboardToFront( this);
-
-        int shiftlevel = (IsSet( KC_LSHIFT) || IsSet( KC_RSHIFT)) ? 1 : 0;
-        uint32_t sks = XKeycodeToKeysym( mSystem->GetDisplay(), key, shiftlevel);
-        uint32_t unicode = ConvertKeysymToUnicode( sks);
+        int shiftlevel = (IsButtonBitSet( KC_LSHIFT) || IsButtonBitSet( KC_RSHIFT)) ? 1 : 0;
+        uint32_t unicode = tr.unicode[shiftlevel];
 
         if( !mIsFirstUpdate )
+        {
+          InputSystemHelper::SetSourceTime( mSystem, mSystem->ConvertServerTime( ev.time));
           DoKeyboardButton( kc, unicode, isPressed);
+          InputSystemHelper::SetSourceTime( mSystem, 0);
+        }
       }
       break;
     }
@@ -1063,10 +1058,10 @@ void LinuxKeyboard::SetFocus( bool pHasFocus)
   {
     for( size_t a = 0; a < mNumKeys; ++a )
     {
-      if( IsSet( a) )
+      if( IsButtonBitSet( a) )
       {
         DoKeyboardButton( (SNIIS::KeyCode) a, 0, false);
-        mPrevState[a/64] |= (1ull << (a&63));
+        SetPrevButtonBit( a, true);
       }
     }
   }
@@ -1075,42 +1070,18 @@ void LinuxKeyboard::SetFocus( bool pHasFocus)
 // --------------------------------------------------------------------------------------------------------------------
 void LinuxKeyboard::DoKeyboardButton( SNIIS::KeyCode kc, size_t unicode, bool isPressed)
 {
-  // reroute to primary keyboard if we're in SingleDeviceMode
-  if( !mSystem->IsInMultiDeviceMode() && GetCount() != 0 )
-  {
-    dynamic_cast<LinuxKeyboard*> (mSystem->GetKeyboardByCount( 0))->DoKeyboardButton( kc, unicode, isPressed);
-    return;
-  }
-
   // small issue prevention: some additional keyboard might have buttons that this keyboard doesn't
   if( kc >= mNumKeys )
     return;
 
   // don't signal if it isn't an actual state change
-  if( IsSet( kc) == isPressed )
+  if( IsButtonBitSet( kc) == isPressed )
     return;
-  Set( kc, isPressed);
+  SetButtonBit( kc, isPressed);
 
   InputSystemHelper::DoKeyboardButton( this, kc, unicode, isPressed);
 }
 
-// --------------------------------------------------------------------------------------------------------------------
-void LinuxKeyboard::Set( size_t kc, bool set)
-{
-  if( set )
-    mState[kc/64] |= (1ull << (kc&63));
-  else
-    mState[kc/64] &= UINT64_MAX ^ (1ull << (kc&63));
-}
-bool LinuxKeyboard::IsSet( size_t kc) const
-{
-  return (mState[kc/64] & (1ull << (kc&63))) != 0;
-}
-bool LinuxKeyboard::WasSet( size_t kc) const
-{
-  return (mPrevState[kc/64] & (1ull << (kc&63))) != 0;
-}
-
 // --------------------------------------------------------------------------------------------------------------------
 size_t LinuxKeyboard::GetNumButtons() const
 {
@@ -1119,50 +1090,24 @@ size_t LinuxKeyboard::GetNumButtons() const
 // --------------------------------------------------------------------------------------------------------------------
 std::string LinuxKeyboard::GetButtonText( size_t idx) const
 {
-  // search backwards to map our keycode to the Linux Keysym it originated from
-  size_t ks = SIZE_MAX;
+  // map our keycode back to the Linux Keysym it originated from
+  KeySym ks = NoSymbol;
   if( idx >= KC_FIRST_CUSTOM )
   {
     idx -= KC_FIRST_CUSTOM;
     if( idx < mExtraButtons.size() )
-      ks = mExtraButtons[idx];
+      ks = XkbKeycodeToKeysym( mSystem->GetDisplay(), ::KeyCode( mExtraButtons[idx]), 0, 0);
   } else
   {
-    for( auto it = sKeyTable.cbegin(); it != sKeyTable.cend() && ks == SIZE_MAX; ++it )
-      if( it->second == idx )
-        ks = it->first;
+    ks = sKeysymByKeyCode.Get( idx, NoSymbol);
   }
 
-  // still there - haven't found the Keysym
-  if( ks == SIZE_MAX )
+  // haven't found the Keysym
+  if( ks == NoSymbol )
     return "";
 
   auto txt = XKeysymToString( ks);
   return txt;
 }
-// --------------------------------------------------------------------------------------------------------------------
-bool LinuxKeyboard::IsButtonDown( size_t idx) const
-{
-  if( idx < mNumKeys )
-    return IsSet( idx);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool LinuxKeyboard::WasButtonPressed( size_t idx) const
-{
-  if( idx < mNumKeys )
-    return IsSet( idx) && !WasSet( idx);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool LinuxKeyboard::WasButtonReleased( size_t idx) const
-{
-  if( idx < mNumKeys )
-    return !IsSet( idx) && WasSet( idx);
-  else
-    return false;
-}
 
 #endif // SNIIS_SYSTEM_LINUX
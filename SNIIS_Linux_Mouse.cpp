@@ -9,10 +9,8 @@ using namespace SNIIS;
 
 // --------------------------------------------------------------------------------------------------------------------
 LinuxMouse::LinuxMouse( LinuxInput* pSystem, size_t pId, const XIDeviceInfo& pDeviceInfo)
-  : Mouse( pId), mSystem( pSystem), mDeviceId( pDeviceInfo.deviceid)
+  : Mouse( pId, false), mSystem( pSystem), mDeviceId( pDeviceInfo.deviceid), mMoveTime( 0), mWheelTime( 0)
 {
-  mState.buttons = mState.prevButtons = 0;
-
   // enumerate all controls on that device
   for( int a = 0; a < pDeviceInfo.num_classes; ++a )
   {
@@ -34,7 +32,7 @@ LinuxMouse::LinuxMouse( LinuxInput* pSystem, size_t pId, const XIDeviceInfo& pDe
         if( num >= 2 ) ++num;
         if( mAxes.size() <= num )
           mAxes.resize( num+1);
-        mAxes[num] = Axis{ vcl->label, vcl->min, vcl->max, 0.0, 0.0, vcl->mode == XIModeAbsolute };
+        mAxes[num] = Axis{ vcl->label, vcl->min, vcl->max, vcl->mode == XIModeAbsolute, 0.0, 0.0 };
       }
     }
   }
@@ -42,18 +40,18 @@ LinuxMouse::LinuxMouse( LinuxInput* pSystem, size_t pId, const XIDeviceInfo& pDe
   // insert dummy mouse wheel axis
   if( mAxes.size() < 3 )
     mAxes.emplace_back();
-  mAxes[2] = Axis{ 0, 0, 256, 0.0, 0.0f, false };
+  mAxes[2] = Axis{ 0, 0, 256, false, 0.0, 0.0 };
+  mAxisDiffs.resize( mAxes.size());
 }
 
 // --------------------------------------------------------------------------------------------------------------------
 void LinuxMouse::StartUpdate()
 {
-  mState.prevButtons = mState.buttons;
-
   for( auto& a : mAxes )
     a.prevValue = a.value;
   // wheel axis is relative, shows movements only. So zero out for each frame and start accumulating differences anew
   mAxes[2].value = 0.0;
+  SetAxisValue( 2, 0.0f);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -65,17 +63,13 @@ void LinuxMouse::HandleEvent( const XIRawEvent& ev)
     {
       size_t numReportedAxes = std::min( mAxes.size(), size_t( ev.valuators.mask_len*8));
       const double* values = ev.valuators.values;
-      static std::vector<double> diffs;
-      if( diffs.size() < numReportedAxes )
-        diffs.resize( numReportedAxes);
+      auto& diffs = mAxisDiffs;
       std::fill( diffs.begin(), diffs.end(), 0.0);
 
       for( size_t a = 0; a < numReportedAxes; ++a )
       {
         if( XIMaskIsSet( ev.valuators.mask, a) )
         {
-          if( !mIsFirstUpdate )
-            InputSystemHelper::SortThisMouseToFront( this);
           double v = *values++;
           if( mAxes[a].isAbsolute )
             diffs[a] = v - mAxes[a].value;
@@ -84,23 +78,20 @@ void LinuxMouse::HandleEvent( const XIRawEvent& ev)
         }
       }
 
-      DoMouseMove( diffs.data(), diffs.size());
+      DoMouseMove( diffs.data(), diffs.size(), mSystem->ConvertServerTime( ev.time));
       break;
     }
 
     case XI_RawButtonPress:
     case XI_RawButtonRelease:
     {
-      if( !mIsFirstUpdate )
-        InputSystemHelper::SortThisMouseToFront( this);
-
       size_t button = size_t( ev.detail);
       bool isPressed = (ev.evtype == XI_RawButtonPress);
       // Mouse wheel. There seem to be two of those, we treat them the same
       if( button >= 4 && button <= 7 )
       {
         if( isPressed && !mIsFirstUpdate )
-          DoMouseWheel( (button&1) == 0 ? 1.0 : -1.0);
+          DoMouseWheel( (button&1) == 0 ? 1.0 : -1.0, mSystem->ConvertServerTime( ev.time));
       } else
       {
         --button;
@@ -108,7 +99,11 @@ void LinuxMouse::HandleEvent( const XIRawEvent& ev)
         if( button == 1 ) button = 2; else if( button == 2 ) button = 1;
         // announce
         if( button < mButtons.size() && !mIsFirstUpdate )
+        {
+          InputSystemHelper::SetSourceTime( mSystem, mSystem->ConvertServerTime( ev.time));
           DoMouseButton( button, isPressed);
+          InputSystemHelper::SetSourceTime( mSystem, 0);
+        }
       }
       break;
     }
@@ -120,45 +115,51 @@ void LinuxMouse::EndUpdate()
 {
   if( !mIsFirstUpdate )
   {
-    // send the mouse move if we're primary or separate
-    if( mSystem->IsInMultiDeviceMode() || GetCount() == 0 )
+    // send the mouse move. Every mouse is a device of its own. The changes are taken from the double values, the float
+    // ones in the state arena can't resolve single pixels anymore once the position gets large.
+    if( mAxes[0].prevValue != mAxes[0].value || mAxes[1].prevValue != mAxes[1].value )
     {
-      if( mAxes[0].prevValue != mAxes[0].value || mAxes[1].prevValue != mAxes[1].value )
-        InputSystemHelper::DoMouseMove( this, mAxes[0].value, mAxes[1].value, mAxes[0].value - mAxes[0].prevValue, mAxes[1].value - mAxes[1].prevValue);
-      // send the wheel
-      if( mAxes[2].prevValue != mAxes[2].value )
-        InputSystemHelper::DoMouseWheel( this, float( mAxes[2].value));
-      // send the other axes, if there are any
-      for( size_t a = 3; a < mAxes.size(); ++a )
-        if( mAxes[a].prevValue != mAxes[a].value )
-          InputSystemHelper::DoAnalogEvent( this, a, mAxes[a].value);
+      InputSystemHelper::SetSourceTime( mSystem, mMoveTime);
+      InputSystemHelper::DoMouseMove( this, GetAxisValue( 0), GetAxisValue( 1), GetRelMouseX(), GetRelMouseY());
     }
+    // send the wheel
+    if( mAxes[2].prevValue != mAxes[2].value )
+    {
+      InputSystemHelper::SetSourceTime( mSystem, mWheelTime);
+      InputSystemHelper::DoMouseWheel( this, float( mAxes[2].value));
+    }
+    InputSystemHelper::SetSourceTime( mSystem, 0);
+    // send the other axes, if there are any
+    for( size_t a = 3; a < mAxes.size(); ++a )
+      if( mAxes[a].prevValue != mAxes[a].value )
+        InputSystemHelper::DoAnalogEvent( this, a, float( mAxes[a].value));
   }
+  mMoveTime = mWheelTime = 0;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-void LinuxMouse::DoMouseMove( double* diffs, size_t diffcount)
+void LinuxMouse::DoMouseMove( double* diffs, size_t diffcount, uint64_t time)
 {
   // apply to our values. Necessary to make the difference calculation in HandleEvent() work correctly
   for( size_t a = 0; a < std::min( diffcount, mAxes.size()); ++a )
+  {
     mAxes[a].value += diffs[a];
+    SetAxisValue( a, float( mAxes[a].value));
+  }
 
-  // also reroute to primary mouse if we're in SingleDeviceMode
-  if( !mSystem->IsInMultiDeviceMode() && GetCount() != 0 )
-    dynamic_cast<LinuxMouse*> (mSystem->GetMouseByCount( 0))->DoMouseMove( diffs, diffcount);
-
-  // callbacks are triggered from EndUpdate()
+  // callbacks are triggered from EndUpdate(). Its latency counts from the first movement in there.
+  if( mMoveTime == 0 )
+    mMoveTime = time;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-void LinuxMouse::DoMouseWheel( double wheel)
+void LinuxMouse::DoMouseWheel( double wheel, uint64_t time)
 {
-  // reroute to primary mouse if we're in SingleDeviceMode
-  if( !mSystem->IsInMultiDeviceMode() && GetCount() != 0 )
-    return dynamic_cast<LinuxMouse*> (mSystem->GetMouseByCount( 0))->DoMouseWheel( wheel);
-
   // store change
   mAxes[2].value += wheel;
+  SetAxisValue( 2, float( mAxes[2].value));
+  if( mWheelTime == 0 )
+    mWheelTime = time;
 
   // callbacks are triggered from EndUpdate()
 }
@@ -166,17 +167,12 @@ void LinuxMouse::DoMouseWheel( double wheel)
 // --------------------------------------------------------------------------------------------------------------------
 void LinuxMouse::DoMouseButton( size_t btnIndex, bool isPressed)
 {
-  // reroute to primary mouse if we're in SingleDeviceMode
-  if( !mSystem->IsInMultiDeviceMode() && GetCount() != 0 )
-    return dynamic_cast<LinuxMouse*> (mSystem->GetMouseByCount( 0))->DoMouseButton( btnIndex, isPressed);
-
   // don't signal if it isn't an actual state change
-  if( !!(mState.buttons & (1u << btnIndex)) == isPressed )
+  if( IsButtonBitSet( btnIndex) == isPressed )
     return;
 
   // store state change
-  uint32_t bitmask = (1 << btnIndex);
-  mState.buttons = (mState.buttons & ~bitmask) | (isPressed ? bitmask : 0);
+  SetButtonBit( btnIndex, isPressed);
 
   // and notify everyone interested
   InputSystemHelper::DoMouseButton( this, btnIndex, isPressed);
@@ -187,8 +183,8 @@ void LinuxMouse::SetFocus( bool pHasFocus)
 {
   if( pHasFocus )
   {
-    // get current mouse position when in SingleMouseMode
-    if( !mSystem->IsInMultiDeviceMode() && GetCount() == 0 )
+    // the first mouse is the one InputSystem::GetMouseX() and friends report, so give it the current pointer position
+    if( GetCount() == 0 )
     {
       Window wa, wb;
       int rootx, rooty, childx, childy;
@@ -197,8 +193,9 @@ void LinuxMouse::SetFocus( bool pHasFocus)
       {
         mAxes[0].prevValue = mAxes[0].value; mAxes[1].prevValue = mAxes[1].value;
         mAxes[0].value = rootx; mAxes[1].value = rooty;
+        SetAxisValue( 0, float( rootx)); SetAxisValue( 1, float( rooty));
         if( mAxes[0].value != mAxes[0].prevValue || mAxes[1].value != mAxes[1].prevValue )
-          InputSystemHelper::DoMouseMove( this, mAxes[0].value, mAxes[1].value, mAxes[0].value - mAxes[0].prevValue, mAxes[1].value - mAxes[1].prevValue);
+          InputSystemHelper::DoMouseMove( this, GetAxisValue( 0), GetAxisValue( 1), GetRelMouseX(), GetRelMouseY());
       }
     }
   }
@@ -206,10 +203,10 @@ void LinuxMouse::SetFocus( bool pHasFocus)
   {
     for( size_t a = 0; a < MB_Count; ++a )
     {
-      if( mState.buttons & (1 << a) )
+      if( IsButtonBitSet( a) )
       {
         DoMouseButton( a, false);
-        mState.prevButtons |= (1 << a);
+        SetPrevButtonBit( a, true);
       }
     }
   }
@@ -236,52 +233,12 @@ std::string LinuxMouse::GetAxisText( size_t idx) const
   return "";
 }
 // --------------------------------------------------------------------------------------------------------------------
-bool LinuxMouse::IsButtonDown( size_t idx) const
-{
-  if( idx < GetNumButtons() )
-    return (mState.buttons & (1 << idx)) != 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool LinuxMouse::WasButtonPressed( size_t idx) const
-{
-  if( idx < GetNumButtons() )
-    return IsButtonDown( idx) && (mState.prevButtons & (1 << idx)) == 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool LinuxMouse::WasButtonReleased( size_t idx) const
-{
-  if( idx < GetNumButtons() )
-    return !IsButtonDown( idx) && (mState.prevButtons & (1 << idx)) != 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-float LinuxMouse::GetAxisAbsolute( size_t idx) const
-{
-  if( idx < mAxes.size() )
-    return float( mAxes[idx].value);
-  else
-    return 0.0f;
-}
-// --------------------------------------------------------------------------------------------------------------------
-float LinuxMouse::GetAxisDifference( size_t idx) const
-{
-  if( idx < mAxes.size() )
-    return float( mAxes[idx].value - mAxes[idx].prevValue);
-  else
-    return 0.0f;
-}
-// --------------------------------------------------------------------------------------------------------------------
 float LinuxMouse::GetMouseX() const { return GetAxisAbsolute( 0); }
 // --------------------------------------------------------------------------------------------------------------------
 float LinuxMouse::GetMouseY() const { return GetAxisAbsolute( 1); }
 // --------------------------------------------------------------------------------------------------------------------
-float LinuxMouse::GetRelMouseX() const { return GetAxisDifference( 0); }
+float LinuxMouse::GetRelMouseX() const { return float( mAxes[0].value - mAxes[0].prevValue); }
 // --------------------------------------------------------------------------------------------------------------------
-float LinuxMouse::GetRelMouseY() const { return GetAxisDifference( 1); }
+float LinuxMouse::GetRelMouseY() const { return float( mAxes[1].value - mAxes[1].prevValue); }
 
 #endif // SNIIS_SYSTEM_LINUX
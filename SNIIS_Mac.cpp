@@ -14,6 +14,7 @@ MacInput::MacInput(id pWindowId)
   mWindow = pWindowId;
 
   // create the manager
+  uint64_t phaseStart = ReadClock();
   mHidManager = IOHIDManagerCreate( kCFAllocatorDefault, 0);
   if( !mHidManager )
     throw std::runtime_error( "Failed to create HIDManager");
@@ -24,6 +25,8 @@ MacInput::MacInput(id pWindowId)
   IOHIDManagerRegisterDeviceMatchingCallback( mHidManager, &MacInput::HandleNewDeviceCallback, (void*) this);
   // register us for running the event loop
   IOHIDManagerScheduleWithRunLoop( mHidManager, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
+  mStartupTimings.mConnect = ReadClock() - phaseStart;
+  phaseStart = ReadClock();
 
   // and open the manager, enumerating all devices along with it
   IOReturn res = IOHIDManagerOpen( mHidManager, 0);
@@ -40,6 +43,10 @@ MacInput::MacInput(id pWindowId)
   // Since some OSX update the Unschedule() thingy also unschedules all devices, so we never get any event notifications
   // simply leaving it be should be fine, as we unregistered the callback
 //  IOHIDManagerUnscheduleFromRunLoop( mHidManager, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
+
+  // the HID manager enumerates all kinds of devices in one go, controllers included
+  mStartupTimings.mDeviceEnumeration = ReadClock() - phaseStart;
+  mStartupTimings.mTotal = ReadClock();
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -72,15 +79,16 @@ void MacInput::Update()
   while( CFRunLoopRunInMode( kCFRunLoopDefaultMode, 0, TRUE) == kCFRunLoopRunHandledSource )
     /**/;
 
-  // Mice need postprocessing
-  for( auto d : mDevices )
-  {
-    if( auto m = dynamic_cast<MacMouse*> (d) )
-      m->EndUpdate();
+  // postprocessing
+  for( auto d : mMacDevices )
+    d->EndUpdate();
 
-    // from now on everything generates signals
+  // from now on everything generates signals
+  for( auto d : mDevices )
     d->ResetFirstUpdateFlag();
-  }
+
+  // list all buttons which changed during this update
+  InputSystemHelper::FinishUpdate( this);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -91,6 +99,15 @@ void MacInput::InternSetFocus( bool pHasFocus)
     d->SetFocus( pHasFocus);
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+void MacInput::InternSetDeviceEnabled( Device* dev, bool enabled)
+{
+  // the HID manager delivers everything anyways, so just release what the device holds.
+  if( !enabled )
+    if( auto md = dynamic_cast<MacDevice*> (dev) )
+      md->SetFocus( false);
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 void MacInput::InternSetMouseGrab( bool enabled)
 {
@@ -177,7 +194,7 @@ void MacInput::HandleNewDevice( IOHIDDeviceRef device)
         {
           Log( "-> Mouse %d (id %d)", mNumMice, mDevices.size());
           auto m = new MacMouse( this, mDevices.size(), device, isTrackpad);
-          InputSystemHelper::AddDevice( m);
+          InputSystemHelper::AddDevice( this, m);
           mMacDevices.push_back( m);
           if( isTrackpad )
             lastMouse = m;
@@ -195,7 +212,7 @@ void MacInput::HandleNewDevice( IOHIDDeviceRef device)
       try {
         Log( "-> Keyboard %d (id %d)", mNumKeyboards, mDevices.size());
         auto k = new MacKeyboard( this, mDevices.size(), device);
-        InputSystemHelper::AddDevice( k);
+        InputSystemHelper::AddDevice( this, k);
         mMacDevices.push_back( k);
       } catch( std::exception& e)
       {
@@ -211,7 +228,7 @@ void MacInput::HandleNewDevice( IOHIDDeviceRef device)
       try {
         Log( "-> Controller %d (id %d)", mNumJoysticks, mDevices.size());
         auto j = new MacJoystick( this, mDevices.size(), device);
-        InputSystemHelper::AddDevice( j);
+        InputSystemHelper::AddDevice( this, j);
         mMacDevices.push_back( j);
       } catch( std::exception& e)
       {
@@ -276,11 +293,11 @@ void InputElementValueChangeCallback( void* ctx, IOReturn res, void* sender, IOH
   SNIIS_UNUSED( sender);
   if( res != kIOReturnSuccess )
     return;
+  auto dev = static_cast<MacDevice*> (ctx);
   //also ignore all events if we ain't focus'd. Did I use that word correctly?
-  if( !gInstance->HasFocus() )
+  if( !dev->GetInputSystem()->HasFocus() )
     return;
 
-  auto dev = static_cast<MacDevice*> (ctx);
   auto elm = IOHIDValueGetElement( val);
   auto keksie = IOHIDElementGetCookie( elm);
   auto value = IOHIDValueGetIntegerValue( val);
@@ -314,33 +331,21 @@ std::pair<float, float> ConvertHatToAxes( long min, long max, long value)
 
 // --------------------------------------------------------------------------------------------------------------------
 // --------------------------------------------------------------------------------------------------------------------
-// Initializes the input system with the given InitArgs. When successful, gInstance is not Null.
-bool InputSystem::Initialize(void* pInitArg)
+// Creates an input system with the given InitArgs, or returns Null on error
+InputSystem* InputSystem::Create(void* pInitArg, const InitOptions& pOptions)
 {
-  if( gInstance )
-    throw std::runtime_error( "Input already initialized");
-
+  // everything created from here on lives in the application's memory, if it asked for that
+  AllocatorScope scope( pOptions.mAllocator);
   try
   {
-    gInstance = new MacInput( pInitArg);
+    return new MacInput( pInitArg);
   } catch( std::exception& e)
   {
     // nope
     if( gLogCallback )
       gLogCallback( (std::string( "Exception while creating SNIIS instance: ") + e.what()).c_str());
-    gInstance = nullptr;
-    return false;
+    return nullptr;
   }
-
-  return true;
-}
-
-// --------------------------------------------------------------------------------------------------------------------
-// Destroys the input system. After returning gInstance is Null again
-void InputSystem::Shutdown()
-{
-  delete gInstance;
-  gInstance = nullptr;
 }
 
 #endif // SNIIS_SYSTEM_MAC
@@ -33,6 +33,7 @@ public:
   void Update() override;
   void InternSetFocus(bool pHasFocus) override;
   void InternSetMouseGrab( bool enabled) override;
+  void InternSetDeviceEnabled( SNIIS::Device* dev, bool enabled) override;
   id GetWindowId() const { return mWindow; }
 protected:
   static void HandleNewDeviceCallback( void* context, IOReturn result, void* sender, IOHIDDeviceRef device);
@@ -63,10 +64,14 @@ class MacDevice
   friend class MacInput;
 public:
   MacDevice( MacInput* pSystem, IOHIDDeviceRef pDeviceRef) : mSystem( pSystem), mDevice( pDeviceRef) { }
+  /// Returns the input system the device belongs to
+  MacInput* GetInputSystem() const { return mSystem; }
   /// Starts the update
-  virtual void StartUpdate() = 0;
+  virtual void StartUpdate() { }
   /// Handles an input event coming from the USB HID callback
   virtual void HandleEvent( IOHIDDeviceRef dev, IOHIDElementCookie cookie, uint32_t usepage, uint32_t usage, CFIndex value) = 0;
+  /// Ends the update after all events have been handled
+  virtual void EndUpdate() { }
   /// Notifies the input device that the application has lost/gained focus.
   virtual void SetFocus( bool pHasFocus) = 0;
 protected:
@@ -79,12 +84,6 @@ protected:
 class MacMouse : public SNIIS::Mouse, public MacDevice
 {
   bool mIsTrackpad;
-  struct State
-  {
-    float axes[16], prevAxes[16];
-    uint32_t buttons, prevButtons;
-  } mState;
-
   std::vector<MacControl> mButtons, mAxes, mSecondaryButtons, mSecondaryAxes;
 
 public:
@@ -95,7 +94,7 @@ public:
 
   void StartUpdate() override;
   void HandleEvent( IOHIDDeviceRef dev, IOHIDElementCookie cookie, uint32_t usepage, uint32_t usage, CFIndex value) override;
-  void EndUpdate();
+  void EndUpdate() override;
   void SetFocus( bool pHasFocus) override;
   bool IsTrackpad() const { return mIsTrackpad; }
 
@@ -103,11 +102,6 @@ public:
   std::string GetButtonText( size_t idx) const override;
   size_t GetNumAxes() const override;
   std::string GetAxisText( size_t idx) const override;
-  bool IsButtonDown( size_t idx) const override;
-  bool WasButtonPressed( size_t idx) const override;
-  bool WasButtonReleased( size_t idx) const override;
-  float GetAxisAbsolute( size_t idx) const override;
-  float GetAxisDifference( size_t idx) const override;
   float GetMouseX() const override;
   float GetMouseY() const override;
   float GetRelMouseX() const override;
@@ -123,27 +117,19 @@ class MacKeyboard : public SNIIS::Keyboard, public MacDevice
 {
   size_t mNumKeys;
   std::vector<uint32_t> mExtraButtons;
-  std::vector<uint64_t> mState, mPrevState; ///< current and previous keystate
 
   unsigned long mDeadKeyState; // "Uint32" - lol
 
 public:
   MacKeyboard( MacInput* pSystem, size_t pId, IOHIDDeviceRef pDeviceRef);
 
-  void StartUpdate() override;
   void HandleEvent( IOHIDDeviceRef dev, IOHIDElementCookie cookie, uint32_t usepage, uint32_t usage, CFIndex value) override;
   void SetFocus( bool pHasFocus) override;
 
   size_t GetNumButtons() const override;
   std::string GetButtonText( size_t idx) const override;
-  bool IsButtonDown( size_t idx) const override;
-  bool WasButtonPressed( size_t idx) const override;
-  bool WasButtonReleased( size_t idx) const override;
 protected:
   void DoKeyboardKey(SNIIS::KeyCode kc, size_t unicode, bool isPressed);
-  void Set( size_t kc, bool set);
-  bool IsSet( size_t kc) const;
-  bool WasSet( size_t kc) const;
   size_t TranslateText( size_t kc);
 };
 
@@ -152,15 +138,10 @@ protected:
 class MacJoystick : public SNIIS::Joystick, public MacDevice
 {
   std::vector<MacControl> mButtons, mAxes;
-  struct State {
-    uint64_t buttons, prevButtons;
-    float axes[16], diffs[16];
-  } mState;
 
 public:
   MacJoystick( MacInput* pSystem, size_t pId, IOHIDDeviceRef pDeviceRef);
 
-  void StartUpdate() override;
   void HandleEvent( IOHIDDeviceRef dev, IOHIDElementCookie cookie, uint32_t usepage, uint32_t usage, CFIndex value) override;
   void SetFocus( bool pHasFocus) override;
 
@@ -168,12 +149,6 @@ public:
   std::string GetButtonText( size_t idx) const override;
   size_t GetNumAxes() const override;
   std::string GetAxisText( size_t idx) const override;
-
-  bool IsButtonDown( size_t idx) const override;
-  bool WasButtonPressed( size_t idx) const override;
-  bool WasButtonReleased( size_t idx) const override;
-  float GetAxisAbsolute( size_t idx) const override;
-  float GetAxisDifference( size_t idx) const override;
 };
 
 #endif // SNIIS_SYSTEM_MAC
@@ -11,8 +11,6 @@ using namespace SNIIS;
 MacJoystick::MacJoystick( MacInput* pSystem, size_t pId, IOHIDDeviceRef pDeviceRef)
   : Joystick( pId), MacDevice( pSystem, pDeviceRef)
 {
-  memset( &mState, 0, sizeof( mState));
-
   if( IOHIDDeviceOpen( mDevice, kIOHIDOptionsTypeNone) != kIOReturnSuccess )
     throw std::runtime_error( "Failed to open HID device");
 
@@ -37,16 +35,6 @@ MacJoystick::MacJoystick( MacInput* pSystem, size_t pId, IOHIDDeviceRef pDeviceR
   IOHIDDeviceScheduleWithRunLoop( mDevice, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
 }
 
-// --------------------------------------------------------------------------------------------------------------------
-void MacJoystick::StartUpdate()
-{
-  mState.prevButtons = mState.buttons;
-  memset( mState.diffs, 0, sizeof( mState.diffs));
-  float prevAxes[16];
-  static_assert( sizeof( prevAxes) == sizeof( mState.axes), "Hardcoded array size");
-  memcpy( prevAxes, mState.axes, sizeof( mState.axes));
-}
-
 // --------------------------------------------------------------------------------------------------------------------
 void MacJoystick::HandleEvent( IOHIDDeviceRef dev, IOHIDElementCookie cookie, uint32_t usepage, uint32_t usage, CFIndex value)
 {
@@ -64,22 +52,23 @@ void MacJoystick::HandleEvent( IOHIDDeviceRef dev, IOHIDElementCookie cookie, ui
     {
       // a hat always generates two axes
       assert( mAxes.size() > idx+2 );
-      std::tie( mState.axes[idx], mState.axes[idx+1]) = ConvertHatToAxes( axit->mMin, axit->mMax, value );
+      auto hat = ConvertHatToAxes( axit->mMin, axit->mMax, value );
+      SetAxisValue( idx, hat.first); SetAxisValue( idx+1, hat.second);
       if( !mIsFirstUpdate )
       {
-        InputSystemHelper::DoJoystickAxis( this, idx, mState.axes[idx]);
-        InputSystemHelper::DoJoystickAxis( this, idx+1, mState.axes[idx+1]);
+        InputSystemHelper::DoJoystickAxis( this, idx, hat.first);
+        InputSystemHelper::DoJoystickAxis( this, idx+1, hat.second);
       }
     }
     else
     {
       // try to tell one-sided axes apart from symmetric axes and act accordingly
       if( abs( axit->mMin) <= abs( axit->mMax) / 10 )
-        mState.axes[idx] = float( value - axit->mMin) / float( axit->mMax - axit->mMin);
+        SetAxisValue( idx, float( value - axit->mMin) / float( axit->mMax - axit->mMin));
       else
-        mState.axes[idx] = (float( value - axit->mMin) / float( axit->mMax - axit->mMin)) * 2.0f - 1.0f;
+        SetAxisValue( idx, (float( value - axit->mMin) / float( axit->mMax - axit->mMin)) * 2.0f - 1.0f);
       if( !mIsFirstUpdate )
-        InputSystemHelper::DoJoystickAxis( this, idx, mState.axes[idx]);
+        InputSystemHelper::DoJoystickAxis( this, idx, GetAxisValue( idx));
     }
   }
 
@@ -87,7 +76,7 @@ void MacJoystick::HandleEvent( IOHIDDeviceRef dev, IOHIDElementCookie cookie, ui
   {
     size_t idx = std::distance( mButtons.cbegin(), buttit);
     bool isDown = (value != 0);
-    mState.buttons = (mState.buttons & (UINT64_MAX ^ (1ull << idx))) | ((isDown ? 1ull : 0u) << idx);
+    SetButtonBit( idx, isDown);
     if( !mIsFirstUpdate )
       InputSystemHelper::DoJoystickButton( this, idx, isDown);
   }
@@ -106,20 +95,19 @@ void MacJoystick::SetFocus( bool pHasFocus)
     // zero all buttons and axes
     for( size_t a = 0; a < mAxes.size(); ++a )
     {
-      if( mState.axes[a] != 0.0f )
+      if( GetAxisValue( a) != 0.0f )
       {
-        mState.diffs[a] = -mState.axes[a];
-        mState.axes[a] = 0.0f;
+        SetAxisValue( a, 0.0f);
         InputSystemHelper::DoJoystickAxis( this, a, 0.0f);
       }
     }
 
     for( size_t a = 0; a < mButtons.size(); ++a )
     {
-      if( mState.buttons & (1ull << a) )
+      if( IsButtonBitSet( a) )
       {
-        mState.buttons &= UINT64_MAX ^ (1ull << a);
-        mState.prevButtons |= 1ull << a;
+        SetButtonBit( a, false);
+        SetPrevButtonBit( a, true);
         InputSystemHelper::DoJoystickButton( this, a, false);
       }
     }
@@ -147,46 +135,5 @@ std::string MacJoystick::GetAxisText( size_t /*idx*/) const
   return "";
 }
 
-// --------------------------------------------------------------------------------------------------------------------
-bool MacJoystick::IsButtonDown( size_t idx) const
-{
-  if( idx < mButtons.size() )
-    return (mState.buttons & (1ull << idx)) != 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool MacJoystick::WasButtonPressed( size_t idx) const
-{
-  if( idx < mButtons.size() )
-    return IsButtonDown( idx) && ((mState.prevButtons & (1ull << idx)) == 0);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool MacJoystick::WasButtonReleased( size_t idx) const
-{
-  if( idx < mButtons.size() )
-    return !IsButtonDown( idx) && ((mState.prevButtons & (1ull << idx)) != 0);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-float MacJoystick::GetAxisAbsolute( size_t idx) const
-{
-  if( idx < mAxes.size() )
-    return mState.axes[idx];
-  else
-    return 0.0f;
-}
-// --------------------------------------------------------------------------------------------------------------------
-float MacJoystick::GetAxisDifference( size_t idx) const
-{
-  if( idx < mAxes.size() )
-    return mState.diffs[idx];
-  else
-    return 0.0f;
-}
-
 #endif // SNIIS_SYSTEM_Mac
 
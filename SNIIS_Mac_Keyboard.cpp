@@ -344,14 +344,6 @@ MacKeyboard::MacKeyboard( MacInput* pSystem, size_t pId, IOHIDDeviceRef pDeviceR
   // call us if something moves
   IOHIDDeviceRegisterInputValueCallback( mDevice, &InputElementValueChangeCallback, static_cast<MacDevice*> (this));
   IOHIDDeviceScheduleWithRunLoop( mDevice, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
-
-  mState.resize( (mNumKeys+63) / 64); mPrevState.resize( mState.size());
-}
-
-// --------------------------------------------------------------------------------------------------------------------
-void MacKeyboard::StartUpdate()
-{
-  mPrevState = mState;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -434,9 +426,9 @@ void MacKeyboard::DoKeyboardKey( SNIIS::KeyCode kc, size_t unicode, bool isPress
     return;
 
   // don't signal if it isn't an actual state change
-  if( IsSet( kc) == isPressed )
+  if( IsButtonBitSet( kc) == isPressed )
     return;
-  Set( kc, isPressed);
+  SetButtonBit( kc, isPressed);
 
   InputSystemHelper::DoKeyboardButton( this, kc, unicode, isPressed);
 }
@@ -453,31 +445,15 @@ void MacKeyboard::SetFocus( bool pHasFocus)
   {
     for( size_t a = 0; a < mNumKeys; ++a )
     {
-      if( IsSet( a) )
+      if( IsButtonBitSet( a) )
       {
         DoKeyboardKey( (SNIIS::KeyCode) a, 0, false);
-        mPrevState[a/64] |= (1ull << (a&63));
+        SetPrevButtonBit( a, true);
       }
     }
   }
 }
 
-void MacKeyboard::Set( size_t kc, bool set)
-{
-  if( set )
-    mState[kc/64] |= (1ull << (kc&63));
-  else
-    mState[kc/64] &= UINT64_MAX ^ (1ull << (kc&63));
-}
-bool MacKeyboard::IsSet( size_t kc) const
-{
-  return (mState[kc/64] & (1ull << (kc&63))) != 0;
-}
-bool MacKeyboard::WasSet( size_t kc) const
-{
-  return (mPrevState[kc/64] & (1ull << (kc&63))) != 0;
-}
-
 // --------------------------------------------------------------------------------------------------------------------
 size_t MacKeyboard::GetNumButtons() const
 {
@@ -507,30 +483,6 @@ std::string MacKeyboard::GetButtonText( size_t /*idx*/) const
 */
   return "";
 }
-// --------------------------------------------------------------------------------------------------------------------
-bool MacKeyboard::IsButtonDown( size_t idx) const
-{
-  if( idx < mNumKeys )
-    return IsSet( idx);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool MacKeyboard::WasButtonPressed( size_t idx) const
-{
-  if( idx < mNumKeys )
-    return IsSet( idx) && !WasSet( idx);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool MacKeyboard::WasButtonReleased( size_t idx) const
-{
-  if( idx < mNumKeys )
-    return !IsSet( idx) && WasSet( idx);
-  else
-    return false;
-}
 
 #endif // SNIIS_SYSTEM_MAC
 
@@ -12,7 +12,6 @@ MacMouse::MacMouse( MacInput* pSystem, size_t pId, IOHIDDeviceRef pDeviceRef, bo
   : Mouse( pId), MacDevice( pSystem, pDeviceRef)
 {
   mIsTrackpad = isTrackpad;
-  memset( &mState, 0, sizeof( mState));
   mAxes.resize( 3, MacControl{ nullptr, MacControl::Type_Axis, "", 0, 0, 0, -1, 1 });
   mSecondaryAxes.resize( 3, MacControl{ nullptr, MacControl::Type_Axis, "", 0, 0, 0, -1, 1 });
 
@@ -60,6 +59,10 @@ void MacMouse::AddDevice( IOHIDDeviceRef pRef)
   // call us if something moves
   IOHIDDeviceRegisterInputValueCallback( pRef, &InputElementValueChangeCallback, static_cast<MacDevice*> (this));
   IOHIDDeviceScheduleWithRunLoop( pRef, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
+
+  // the second HID might have brought additional controls, so our part of the state arena needs to grow
+  if( mOwner )
+    InputSystemHelper::LayoutStateArena( mOwner);
 }
 
 MacMouse::~MacMouse()
@@ -74,12 +77,8 @@ MacMouse::~MacMouse()
 // --------------------------------------------------------------------------------------------------------------------
 void MacMouse::StartUpdate()
 {
-  mState.prevButtons = mState.buttons;
-
-  for( size_t a = 0; a < mAxes.size(); ++a )
-    mState.prevAxes[a] = mState.axes[a];
   // axis 2 is always mouse wheel. this one always starts at zero on every update.
-  mState.axes[2] = 0.0f;
+  SetAxisValue( 2, 0.0f);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -100,7 +99,8 @@ void MacMouse::HandleEvent(IOHIDDeviceRef dev, IOHIDElementCookie cookie, uint32
     {
       // a hat always generates two axes
       assert( axes.size() > idx+2 );
-      std::tie( mState.axes[idx], mState.axes[idx+1]) = ConvertHatToAxes( axit->mMin, axit->mMax, value );
+      auto hat = ConvertHatToAxes( axit->mMin, axit->mMax, value );
+      SetAxisValue( idx, hat.first); SetAxisValue( idx+1, hat.second);
     }
     else
     {
@@ -109,7 +109,7 @@ void MacMouse::HandleEvent(IOHIDDeviceRef dev, IOHIDElementCookie cookie, uint32
       {
         // in single mouse mode the position will be queried from the OS in EndUpdate()
         if( mSystem->IsInMultiDeviceMode() )
-          mState.axes[idx] += float( value);
+          SetAxisValue( idx, GetAxisValue( idx) + float( value));
       }
       else if( idx < 3 )
       {
@@ -119,9 +119,9 @@ void MacMouse::HandleEvent(IOHIDDeviceRef dev, IOHIDElementCookie cookie, uint32
       {
         // try to tell one-sided axes apart from symmetric axes and act accordingly
         if( abs( axit->mMin) <= abs( axit->mMax) / 10 )
-          mState.axes[idx] = float( value - axit->mMin) / float( axit->mMax - axit->mMin);
+          SetAxisValue( idx, float( value - axit->mMin) / float( axit->mMax - axit->mMin));
         else
-          mState.axes[idx] = (float( value - axit->mMin) / float( axit->mMax - axit->mMin)) * 2.0f - 1.0f;
+          SetAxisValue( idx, (float( value - axit->mMin) / float( axit->mMax - axit->mMin)) * 2.0f - 1.0f);
       }
     }
   }
@@ -158,7 +158,7 @@ void MacMouse::EndUpdate()
         float dx = lp.x - wndCenterPos.x, dy = lp.y - wndCenterPos.y;
         if( dx*dx + dy*dy > 0.7f )
         {
-          mState.axes[0] += dx; mState.axes[1] += dy;
+          SetAxisValue( 0, GetAxisValue( 0) + dx); SetAxisValue( 1, GetAxisValue( 1) + dy);
           Pos globalWndCenter = MacHelper_WinToDisplay( mSystem->GetWindowId(), wndCenterPos);
           MacHelper_SetMousePos( globalWndCenter);
         }
@@ -166,7 +166,7 @@ void MacMouse::EndUpdate()
       {
         // single mouse mode without grabbing: we're not allowed to lock the mouse like this, so we simply mirror the
         // global mouse movement to get expected mouse acceleration and such at least.
-        mState.axes[0] = lp.x; mState.axes[1] = lp.y;
+        SetAxisValue( 0, lp.x); SetAxisValue( 1, lp.y);
       }
     }
   }
@@ -174,15 +174,15 @@ void MacMouse::EndUpdate()
   if( !mIsFirstUpdate )
   {
     // send the mouse move
-    if( mState.prevAxes[0] != mState.axes[0] || mState.prevAxes[1] != mState.axes[1] )
-      InputSystemHelper::DoMouseMove( this, mState.axes[0], mState.axes[1], mState.axes[0] - mState.prevAxes[0], mState.axes[1] - mState.prevAxes[1]);
+    if( GetAxisDifference( 0) != 0.0f || GetAxisDifference( 1) != 0.0f )
+      InputSystemHelper::DoMouseMove( this, GetAxisValue( 0), GetAxisValue( 1), GetAxisDifference( 0), GetAxisDifference( 1));
     // send the mouse wheel.
-    if( mState.prevAxes[2] != mState.axes[2] )
-      InputSystemHelper::DoMouseWheel( this, mState.axes[2]);
+    if( GetAxisDifference( 2) != 0.0f )
+      InputSystemHelper::DoMouseWheel( this, GetAxisValue( 2));
     // send the other axes, if there are any
     for( size_t a = 3; a < mAxes.size(); ++a )
-      if( mState.axes[a] != mState.prevAxes[a] )
-        InputSystemHelper::DoAnalogEvent( this, a, mState.axes[a]);
+      if( GetAxisDifference( a) != 0.0f )
+        InputSystemHelper::DoAnalogEvent( this, a, GetAxisValue( a));
   }
 }
 
@@ -194,7 +194,7 @@ void MacMouse::DoMouseWheel( float wheel)
     return dynamic_cast<MacMouse*> (mSystem->GetMouseByCount( 0))->DoMouseWheel( wheel);
 
   // store change
-  mState.axes[2] += wheel;
+  SetAxisValue( 2, GetAxisValue( 2) + wheel);
 
   // callbacks are triggered from EndUpdate()
 }
@@ -207,12 +207,11 @@ void MacMouse::DoMouseButton( size_t btnIndex, bool isPressed)
     return dynamic_cast<MacMouse*> (mSystem->GetMouseByCount( 0))->DoMouseButton( btnIndex, isPressed);
 
   // don't signal if it isn't an actual state change
-  if( !!(mState.buttons & (1u << btnIndex)) == isPressed )
+  if( IsButtonBitSet( btnIndex) == isPressed )
     return;
 
   // store state change
-  uint32_t bitmask = (1 << btnIndex);
-  mState.buttons = (mState.buttons & ~bitmask) | (isPressed ? bitmask : 0);
+  SetButtonBit( btnIndex, isPressed);
 
   // and notify everyone interested
   InputSystemHelper::DoMouseButton( this, btnIndex, isPressed);
@@ -227,20 +226,20 @@ void MacMouse::SetFocus( bool pHasFocus)
     if( !mSystem->IsInMultiDeviceMode() )
     {
       Pos mp = MacHelper_GetMousePos();
-      float px = mState.axes[0], py = mState.axes[1];
-      mState.axes[0] = mp.x; mState.axes[1] = mp.y;
-      if( px != mState.axes[0] || py != mState.axes[1] )
-        InputSystemHelper::DoMouseMove( this, mState.axes[0], mState.axes[1], mState.axes[0] - px, mState.axes[1] - py);
+      float px = GetAxisValue( 0), py = GetAxisValue( 1);
+      SetAxisValue( 0, mp.x); SetAxisValue( 1, mp.y);
+      if( px != mp.x || py != mp.y )
+        InputSystemHelper::DoMouseMove( this, mp.x, mp.y, mp.x - px, mp.y - py);
     }
   }
   else
   {
     for( size_t a = 0; a < mButtons.size(); ++a )
     {
-      if( mState.buttons & (1 << a) )
+      if( IsButtonBitSet( a) )
       {
-        mState.prevButtons |= (1 << a);
-        mState.buttons &= std::numeric_limits<decltype( mState.buttons)>::max() ^ (1 << a);
+        SetPrevButtonBit( a, true);
+        SetButtonBit( a, false);
         InputSystemHelper::DoMouseButton( this, a, false);
       }
     }
@@ -268,46 +267,6 @@ std::string MacMouse::GetAxisText( size_t idx) const
   return "";
 }
 // --------------------------------------------------------------------------------------------------------------------
-bool MacMouse::IsButtonDown( size_t idx) const
-{
-  if( idx < GetNumButtons() )
-    return (mState.buttons & (1 << idx)) != 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool MacMouse::WasButtonPressed( size_t idx) const
-{
-  if( idx < GetNumButtons() )
-    return IsButtonDown( idx) && (mState.prevButtons & (1 << idx)) == 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool MacMouse::WasButtonReleased( size_t idx) const
-{
-  if( idx < GetNumButtons() )
-    return !IsButtonDown( idx) && (mState.prevButtons & (1 << idx)) != 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-float MacMouse::GetAxisAbsolute( size_t idx) const
-{
-  if( idx < GetNumAxes() )
-    return float( mState.axes[idx]);
-  else
-    return 0.0f;
-}
-// --------------------------------------------------------------------------------------------------------------------
-float MacMouse::GetAxisDifference( size_t idx) const
-{
-  if( idx < GetNumAxes() )
-    return float( mState.axes[idx] - mState.prevAxes[idx]);
-  else
-    return 0.0f;
-}
-// --------------------------------------------------------------------------------------------------------------------
 float MacMouse::GetMouseX() const { return GetAxisAbsolute( 0); }
 // --------------------------------------------------------------------------------------------------------------------
 float MacMouse::GetMouseY() const { return GetAxisAbsolute( 1); }
@@ -0,0 +1,989 @@
+/// @file SNIIS_Record.cpp
+/// Implementation of input recording and replay
+
+#include "SNIIS_Record.h"
+#include "SNIIS_Virtual.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#if SNIIS_SYSTEM_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace SNIIS;
+
+// --------------------------------------------------------------------------------------------------------------------
+InputRecorder::InputRecorder()
+{
+  mSystem = nullptr;
+  mLastTime = 0;
+  mKeyframeInterval = 10000000;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+InputRecorder::~InputRecorder()
+{
+  Stop();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Starts a new log: header, key repetition config, all devices and a keyframe with the current state
+void InputRecorder::Start( InputSystem* sys)
+{
+  if( sys->mRecorder && sys->mRecorder != this )
+    throw std::runtime_error( "Input system already has a recorder");
+  Stop();
+
+  mData.clear();
+  mKeyframes.clear();
+  mLastTime = 0;
+  for( size_t a = 0; a < 4; ++a )
+    mData.push_back( uint8_t( Magic >> (a * 8)));
+  WriteVarint( Version);
+
+  mSystem = sys;
+  BeginRecord( Rec_KeyRepeat, sys->ReadClock());
+  const auto& krc = sys->GetKeyRepeatCfg();
+  mData.push_back( krc.enable ? 1 : 0);
+  WriteFloat( krc.delay);
+  WriteFloat( krc.interval);
+  if( !sys->HasFocus() )
+    RecordFocus( false);
+
+  for( auto d : sys->GetDevices() )
+    RecordDevice( d);
+  RecordKeyframe();
+  sys->mRecorder = this;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputRecorder::Stop()
+{
+  if( !mSystem )
+    return;
+  RecordIndex();
+  mSystem->mRecorder = nullptr;
+  mSystem = nullptr;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool InputRecorder::WriteToFile( const char* path) const
+{
+  FILE* file = fopen( path, "wb");
+  if( !file )
+    return false;
+  bool isOk = fwrite( mData.data(), 1, mData.size(), file) == mData.size();
+  return fclose( file) == 0 && isOk;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// A device with its current state: pressed buttons as differences to the previous one, and all axis values
+void InputRecorder::RecordDevice( const Device* dev)
+{
+  BeginRecord( Rec_Device, mSystem->ReadClock());
+  WriteVarint( dev->GetId());
+  mData.push_back( dynamic_cast<const Mouse*> (dev) ? Kind_Mouse : dynamic_cast<const Keyboard*> (dev) ? Kind_Keyboard : Kind_Joystick);
+  WriteVarint( dev->GetNumButtons());
+  WriteVarint( dev->GetNumAxes());
+  mData.push_back( dev->IsEnabled() ? 1 : 0);
+
+  auto buttons = dev->Buttons();
+  size_t numPressed = 0;
+  for( size_t a = 0; a < dev->GetNumButtons(); ++a )
+    numPressed += buttons.Test( a) ? 1 : 0;
+  WriteVarint( numPressed);
+  for( size_t a = 0, prev = 0; a < dev->GetNumButtons(); ++a )
+  {
+    if( buttons.Test( a) )
+    {
+      WriteVarint( a - prev);
+      prev = a;
+    }
+  }
+
+  for( float v : dev->Axes() )
+    WriteFloat( v);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputRecorder::RecordFocus( bool hasFocus)
+{
+  BeginRecord( Rec_Focus, mSystem->ReadClock());
+  mData.push_back( hasFocus ? 1 : 0);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputRecorder::RecordDeviceEnabled( const Device* dev, bool enabled)
+{
+  BeginRecord( Rec_DeviceEnabled, mSystem->ReadClock());
+  WriteVarint( dev->GetId());
+  mData.push_back( enabled ? 1 : 0);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputRecorder::RecordButton( const Device* dev, size_t btnIndex, bool isPressed)
+{
+  BeginRecord( Rec_Button, mSystem->ReadClock());
+  WriteVarint( dev->GetId());
+  WriteVarint( btnIndex * 2 + (isPressed ? 1 : 0));
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputRecorder::RecordKey( const Device* dev, KeyCode kc, size_t unicode, bool isPressed)
+{
+  BeginRecord( Rec_Key, mSystem->ReadClock());
+  WriteVarint( dev->GetId());
+  WriteVarint( size_t( kc) * 2 + (isPressed ? 1 : 0));
+  WriteVarint( unicode);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputRecorder::RecordMouseMove( const Device* dev, float absx, float absy, float relx, float rely)
+{
+  BeginRecord( Rec_MouseMove, mSystem->ReadClock());
+  WriteVarint( dev->GetId());
+  WriteFloat( absx); WriteFloat( absy);
+  WriteFloat( relx); WriteFloat( rely);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputRecorder::RecordWheel( const Device* dev, float diff)
+{
+  BeginRecord( Rec_Wheel, mSystem->ReadClock());
+  WriteVarint( dev->GetId());
+  WriteFloat( diff);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputRecorder::RecordAxis( const Device* dev, size_t axisIndex, float value)
+{
+  BeginRecord( Rec_Axis, mSystem->ReadClock());
+  WriteVarint( dev->GetId());
+  WriteVarint( axisIndex);
+  WriteFloat( value);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputRecorder::RecordInputDropped( const Device* dev)
+{
+  BeginRecord( Rec_InputDropped, mSystem->ReadClock());
+  WriteVarint( dev->GetId());
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Ends the frame. Comes after all input of the Update(), but carries the time the Update() started at.
+void InputRecorder::RecordUpdate()
+{
+  BeginRecord( Rec_Update, mSystem->GetTime());
+  if( mKeyframeInterval > 0 && mSystem->GetTime() - mKeyframes.back().mTime >= mKeyframeInterval )
+    RecordKeyframe();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Writes the complete state at the end of an Update(): everything a replay needs to continue from here. Transition
+// counters, edge lists and channel modifications are left out, the next Update() resets them anyways.
+void InputRecorder::RecordKeyframe()
+{
+  const InputSystem* sys = mSystem;
+  mKeyframes.push_back( KeyframeEntry{ sys->mTime, mData.size() });
+  BeginRecord( Rec_Keyframe, sys->mTime);
+  WriteVarint( sys->mUpdateCount);
+  mData.push_back( sys->mHasFocus ? 1 : 0);
+
+  WriteVarint( sys->mDevices.size());
+  for( auto d : sys->mDevices )
+  {
+    WriteVarint( d->GetId());
+    mData.push_back( d->IsEnabled() ? 1 : 0);
+    auto buttons = d->Buttons();
+    WriteVarint( buttons.mNumWords);
+    for( size_t a = 0; a < buttons.mNumWords; ++a )
+      WriteVarint( buttons.mWords[a]);
+    auto axes = d->Axes();
+    WriteVarint( axes.size());
+    for( float v : axes )
+      WriteFloat( v);
+  }
+
+  const auto& krs = sys->mKeyRepeatState;
+  WriteVarint( krs.mSender ? krs.mSender->GetId() + 1 : 0);
+  WriteVarint( size_t( krs.mKeyCode));
+  WriteVarint( krs.mUnicodeChar);
+  WriteFloat( krs.mTimeTillRepeat);
+
+  WriteVarint( sys->mDigitalChannels.size());
+  for( const auto& dch : sys->mDigitalChannels )
+  {
+    WriteVarint( dch.first);
+    mData.push_back( dch.second.mIsPressed ? 1 : 0);
+  }
+  WriteVarint( sys->mAnalogChannels.size());
+  for( const auto& ach : sys->mAnalogChannels )
+  {
+    WriteVarint( ach.first);
+    WriteFloat( ach.second.mValue);
+  }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Finishes the log with the index of all keyframes and the trailer which points to it
+void InputRecorder::RecordIndex()
+{
+  uint64_t offset = mData.size();
+  BeginRecord( Rec_Index, mLastTime);
+  WriteVarint( mKeyframes.size());
+  KeyframeEntry prev = { 0, 0 };
+  for( const auto& kf : mKeyframes )
+  {
+    WriteVarint( kf.mTime - prev.mTime);
+    WriteVarint( kf.mOffset - prev.mOffset);
+    prev = kf;
+  }
+
+  for( size_t a = 0; a < 8; ++a )
+    mData.push_back( uint8_t( offset >> (a * 8)));
+  for( size_t a = 0; a < 4; ++a )
+    mData.push_back( uint8_t( IndexMagic >> (a * 8)));
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Writes type and time of a record. Times are stored as difference to the previous record, zigzag-encoded because the
+// end of an Update() is stamped with the start time of the Update(), which lies before the input it processed.
+void InputRecorder::BeginRecord( RecordType type, uint64_t time)
+{
+  int64_t diff = int64_t( time - mLastTime);
+  mLastTime = time;
+  mData.push_back( type);
+  WriteVarint( (uint64_t( diff) << 1) ^ uint64_t( diff >> 63));
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// LEB128: seven bits per byte, lowest first, the high bit marks that more bytes follow
+void InputRecorder::WriteVarint( uint64_t v)
+{
+  while( v >= 0x80 )
+  {
+    mData.push_back( uint8_t( v | 0x80));
+    v >>= 7;
+  }
+  mData.push_back( uint8_t( v));
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Floats are stored as their bits, little endian
+void InputRecorder::WriteFloat( float v)
+{
+  uint32_t bits;
+  memcpy( &bits, &v, sizeof( bits));
+  for( size_t a = 0; a < 4; ++a )
+    mData.push_back( uint8_t( bits >> (a * 8)));
+}
+
+// ********************************************************************************************************************
+// --------------------------------------------------------------------------------------------------------------------
+InputReplay::InputReplay( VirtualInput* pSystem, const uint8_t* pData, size_t pSize)
+  : mSystem( pSystem), mData( pData), mSize( pSize), mPos( 0), mFirstRecord( 0), mTime( 0), mIsIndexed( false)
+{
+  uint32_t magic = 0;
+  uint8_t b = 0;
+  for( size_t a = 0; a < 4 && ReadByte( b); ++a )
+    magic |= uint32_t( b) << (a * 8);
+  uint64_t version = 0;
+  if( magic != InputRecorder::Magic || !ReadVarint( version) )
+    throw std::runtime_error( "Not an input recording");
+  if( version < InputRecorder::MinVersion || version > InputRecorder::Version )
+    throw std::runtime_error( "Unsupported input recording version");
+  mFirstRecord = mPos;
+  ReadIndex();
+
+  // replay the start of the log up to the first input, so that the devices are there right away
+  while( mPos < mSize && mData[mPos] < InputRecorder::Rec_Button )
+  {
+    uint8_t type = 0;
+    if( !ReadRecordHeader( type) || !ReplayRecord( type, true) )
+      throw std::runtime_error( "Broken input recording");
+  }
+  if( mPos < mSize && mData[mPos] == InputRecorder::Rec_Keyframe )
+  {
+    uint8_t type = 0;
+    if( !ReadRecordHeader( type) || !ReplayRecord( type, true) )
+      throw std::runtime_error( "Broken input recording");
+  }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Replays all records up to the next Update()
+bool InputReplay::Step()
+{
+  while( mPos < mSize )
+  {
+    uint8_t type = 0;
+    if( !ReadRecordHeader( type) || !ReplayRecord( type, true) )
+      break;
+    if( type == InputRecorder::Rec_Update )
+      return true;
+  }
+
+  if( mPos < mSize )
+  {
+    InputSystem::Log( "SNIIS: input recording is broken at byte %zd", mPos);
+    mPos = mSize;
+  }
+  return false;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Restores the last keyframe before the given time and replays from there
+bool InputReplay::Seek( uint64_t time)
+{
+  if( !mIsIndexed )
+    BuildIndex();
+  auto it = std::upper_bound( mKeyframes.begin(), mKeyframes.end(), time,
+    []( uint64_t t, const InputRecorder::KeyframeEntry& kf) { return t < kf.mTime; });
+  if( it == mKeyframes.begin() )
+    return false;
+  --it;
+
+  mPos = size_t( it->mOffset);
+  uint8_t type = 0;
+  if( !ReadRecordHeader( type) || type != InputRecorder::Rec_Keyframe )
+  {
+    InputSystem::Log( "SNIIS: input recording has no keyframe at byte %zd", size_t( it->mOffset));
+    mPos = mSize;
+    return false;
+  }
+  mTime = it->mTime;
+  mSystem->SetTime( mTime);
+  if( !ReplayKeyframe( true) )
+  {
+    mPos = mSize;
+    return false;
+  }
+
+  // look ahead to each next Update() and replay it if it's not past the given time
+  while( mPos < mSize )
+  {
+    size_t pos = mPos;
+    uint64_t prevTime = mTime;
+    bool isFound = false;
+    while( !isFound && ReadRecordHeader( type) && ReplayRecord( type, false) )
+      isFound = (type == InputRecorder::Rec_Update);
+    uint64_t updateTime = mTime;
+    mPos = pos; mTime = prevTime;
+    if( !isFound || updateTime > time )
+      break;
+    Step();
+  }
+  return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Replays the rest with a hashing handler in front of the application's handler
+Vector<uint64_t> InputReplay::ComputeFrameHashes()
+{
+  InputHandler* prevHandler = mSystem->GetHandler();
+  HashingHandler hasher( prevHandler);
+  mSystem->SetHandler( &hasher);
+
+  Vector<uint64_t> hashes;
+  InputFrame frame;
+  while( Step() )
+  {
+    mSystem->FillFrame( frame);
+    hashes.push_back( HashFrame( frame, hasher.GetHash()));
+    hasher.Reset();
+  }
+
+  mSystem->SetHandler( prevHandler);
+  return hashes;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Reads type and time of the next record
+bool InputReplay::ReadRecordHeader( uint8_t& type)
+{
+  uint64_t zigzag = 0;
+  if( !ReadByte( type) || !ReadVarint( zigzag) )
+    return false;
+  mTime += uint64_t( int64_t( zigzag >> 1) ^ -int64_t( zigzag & 1));
+  return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Reads a single record and replays it if isApplied is set, otherwise just skips it. Returns false if it couldn't be read.
+bool InputReplay::ReplayRecord( uint8_t type, bool isApplied)
+{
+  if( isApplied )
+    mSystem->SetTime( mTime);
+
+  uint64_t id = 0, control = 0, unicode = 0;
+  uint8_t flag = 0;
+  float values[4] = {};
+  switch( type )
+  {
+    case InputRecorder::Rec_Device:
+    {
+      uint8_t kind = 0;
+      uint64_t numButtons = 0, numAxes = 0, numPressed = 0;
+      if( !ReadVarint( id) || !ReadByte( kind) || !ReadVarint( numButtons) || !ReadVarint( numAxes) || !ReadByte( flag)
+         || !ReadVarint( numPressed) || id > 0xffff || kind > InputRecorder::Kind_Joystick )
+        return false;
+      // devices are only created once, seeking back doesn't remove them
+      isApplied = isApplied && !GetDevice( id);
+      if( isApplied )
+        AddDevice( id, kind, size_t( numButtons), size_t( numAxes));
+      auto dev = GetDevice( id);
+      for( uint64_t a = 0, btn = 0; a < numPressed; ++a )
+      {
+        if( !ReadVarint( control) )
+          return false;
+        btn += control;
+        if( isApplied )
+          mSystem->PresetButton( dev, size_t( btn), true);
+      }
+      for( uint64_t a = 0; a < numAxes; ++a )
+      {
+        if( !ReadFloat( values[0]) )
+          return false;
+        if( isApplied )
+          mSystem->PresetAxis( dev, size_t( a), values[0]);
+      }
+      if( isApplied )
+        mSystem->SetDeviceEnabled( dev, flag != 0);
+      return true;
+    }
+
+    case InputRecorder::Rec_KeyRepeat:
+    {
+      KeyRepeatCfg krc;
+      if( !ReadByte( flag) || !ReadFloat( krc.delay) || !ReadFloat( krc.interval) )
+        return false;
+      krc.enable = flag != 0;
+      if( isApplied )
+        mSystem->SetKeyRepeatCfg( krc);
+      return true;
+    }
+
+    case InputRecorder::Rec_Focus:
+      if( !ReadByte( flag) )
+        return false;
+      if( isApplied )
+        mSystem->SetFocus( flag != 0);
+      return true;
+
+    case InputRecorder::Rec_DeviceEnabled:
+      if( !ReadVarint( id) || !ReadByte( flag) )
+        return false;
+      if( isApplied )
+        mSystem->SetDeviceEnabled( GetDevice( id), flag != 0);
+      return true;
+
+    case InputRecorder::Rec_Button:
+      if( !ReadVarint( id) || !ReadVarint( control) )
+        return false;
+      if( !isApplied )
+        return true;
+      if( auto m = dynamic_cast<VirtualMouse*> (GetDevice( id)) )
+        m->SetButton( size_t( control >> 1), (control & 1) != 0);
+      else if( auto j = dynamic_cast<VirtualJoystick*> (GetDevice( id)) )
+        j->SetButton( size_t( control >> 1), (control & 1) != 0);
+      return true;
+
+    case InputRecorder::Rec_Key:
+      if( !ReadVarint( id) || !ReadVarint( control) || !ReadVarint( unicode) )
+        return false;
+      if( !isApplied )
+        return true;
+      if( auto k = dynamic_cast<VirtualKeyboard*> (GetDevice( id)) )
+        k->SetKey( KeyCode( control >> 1), (control & 1) != 0, size_t( unicode));
+      return true;
+
+    case InputRecorder::Rec_MouseMove:
+      if( !ReadVarint( id) || !ReadFloat( values[0]) || !ReadFloat( values[1]) || !ReadFloat( values[2]) || !ReadFloat( values[3]) )
+        return false;
+      if( !isApplied )
+        return true;
+      if( auto m = dynamic_cast<VirtualMouse*> (GetDevice( id)) )
+        m->MoveTo( values[0], values[1], values[2], values[3]);
+      return true;
+
+    case InputRecorder::Rec_Wheel:
+      if( !ReadVarint( id) || !ReadFloat( values[0]) )
+        return false;
+      if( !isApplied )
+        return true;
+      if( auto m = dynamic_cast<VirtualMouse*> (GetDevice( id)) )
+        m->Wheel( values[0]);
+      return true;
+
+    case InputRecorder::Rec_Axis:
+      if( !ReadVarint( id) || !ReadVarint( control) || !ReadFloat( values[0]) )
+        return false;
+      if( !isApplied )
+        return true;
+      if( auto j = dynamic_cast<VirtualJoystick*> (GetDevice( id)) )
+        j->SetAxis( size_t( control), values[0]);
+      return true;
+
+    case InputRecorder::Rec_InputDropped:
+      if( !ReadVarint( id) )
+        return false;
+      if( isApplied && GetDevice( id) )
+        mSystem->DropInput( GetDevice( id));
+      return true;
+
+    case InputRecorder::Rec_Update:
+      if( isApplied )
+        mSystem->Update();
+      return true;
+
+    case InputRecorder::Rec_Keyframe:
+      return ReplayKeyframe( isApplied);
+
+    default:
+      return false;
+  }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Reads a keyframe and, if isApplied is set, puts the virtual system into that state without signalling anything.
+// Devices are enabled or disabled after their state is set, so that disabling doesn't release anything.
+bool InputReplay::ReplayKeyframe( bool isApplied)
+{
+  InputSystem* sys = mSystem;
+  uint64_t updateCount = 0, count = 0, id = 0, num = 0, word = 0;
+  uint8_t flag = 0;
+  float value = 0.0f;
+  if( !ReadVarint( updateCount) || !ReadByte( flag) || !ReadVarint( count) )
+    return false;
+  if( isApplied )
+  {
+    sys->mUpdateCount = updateCount;
+    sys->mHasFocus = flag != 0;
+    sys->mTime = mTime;
+  }
+
+  for( uint64_t a = 0; a < count; ++a )
+  {
+    uint8_t isEnabled = 0;
+    if( !ReadVarint( id) || !ReadByte( isEnabled) || !ReadVarint( num) )
+      return false;
+    Device* dev = isApplied ? GetDevice( id) : nullptr;
+    for( uint64_t w = 0; w < num; ++w )
+    {
+      if( !ReadVarint( word) )
+        return false;
+      for( size_t bit = 0; dev && bit < 64 && w * 64 + bit < dev->GetNumButtons(); ++bit )
+        mSystem->PresetButton( dev, size_t( w * 64 + bit), (word & (1ull << bit)) != 0);
+    }
+    if( !ReadVarint( num) )
+      return false;
+    for( uint64_t ax = 0; ax < num; ++ax )
+    {
+      if( !ReadFloat( value) )
+        return false;
+      if( dev )
+        mSystem->PresetAxis( dev, size_t( ax), value);
+    }
+    if( dev )
+      sys->SetDeviceEnabled( dev, isEnabled != 0);
+  }
+
+  uint64_t sender = 0, keyCode = 0, unicode = 0;
+  float timeTillRepeat = 0.0f;
+  if( !ReadVarint( sender) || !ReadVarint( keyCode) || !ReadVarint( unicode) || !ReadFloat( timeTillRepeat) )
+    return false;
+  if( isApplied )
+  {
+    auto& krs = sys->mKeyRepeatState;
+    krs.mSender = sender > 0 ? dynamic_cast<Keyboard*> (GetDevice( sender - 1)) : nullptr;
+    krs.mKeyCode = KeyCode( keyCode);
+    krs.mUnicodeChar = size_t( unicode);
+    krs.mTimeTillRepeat = krs.mSender ? timeTillRepeat : 0.0f;
+    krs.mLastTime = mTime;
+  }
+
+  if( !ReadVarint( count) )
+    return false;
+  for( uint64_t a = 0; a < count; ++a )
+  {
+    if( !ReadVarint( id) || !ReadByte( flag) )
+      return false;
+    if( isApplied )
+    {
+      auto& dch = sys->GetDigital( size_t( id));
+      dch.mIsPressed = flag != 0;
+      dch.Update();
+    }
+  }
+  if( !ReadVarint( count) )
+    return false;
+  for( uint64_t a = 0; a < count; ++a )
+  {
+    if( !ReadVarint( id) || !ReadFloat( value) )
+      return false;
+    if( isApplied )
+    {
+      auto& ach = sys->GetAnalog( size_t( id));
+      ach.mValue = value;
+      ach.Update();
+    }
+  }
+  return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Reads the keyframe index of a finished log. The records end where the index starts.
+void InputReplay::ReadIndex()
+{
+  if( mSize < mFirstRecord + InputRecorder::IndexTrailerSize )
+    return;
+  const uint8_t* trailer = mData + mSize - InputRecorder::IndexTrailerSize;
+  uint64_t offset = 0;
+  uint32_t magic = 0;
+  for( size_t a = 0; a < 8; ++a )
+    offset |= uint64_t( trailer[a]) << (a * 8);
+  for( size_t a = 0; a < 4; ++a )
+    magic |= uint32_t( trailer[8 + a]) << (a * 8);
+  if( magic != InputRecorder::IndexMagic || offset < mFirstRecord || offset >= mSize - InputRecorder::IndexTrailerSize )
+    return;
+
+  size_t pos = mPos;
+  mPos = size_t( offset);
+  uint8_t type = 0;
+  uint64_t count = 0;
+  InputRecorder::KeyframeEntry kf = { 0, 0 };
+  bool isOk = ReadRecordHeader( type) && type == InputRecorder::Rec_Index && ReadVarint( count);
+  for( uint64_t a = 0; isOk && a < count; ++a )
+  {
+    uint64_t time = 0, diff = 0;
+    isOk = ReadVarint( time) && ReadVarint( diff);
+    kf.mTime += time; kf.mOffset += diff;
+    mKeyframes.push_back( kf);
+  }
+
+  mPos = pos;
+  mTime = 0;
+  if( !isOk )
+  {
+    InputSystem::Log( "SNIIS: input recording has a broken index, ignoring it");
+    mKeyframes.clear();
+    return;
+  }
+  mSize = size_t( offset);
+  mIsIndexed = true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Collects all keyframes by skimming through the whole log, for logs without an index
+void InputReplay::BuildIndex()
+{
+  size_t pos = mPos;
+  uint64_t time = mTime;
+  mPos = mFirstRecord;
+  mTime = 0;
+  mKeyframes.clear();
+
+  uint8_t type = 0;
+  size_t start = mPos;
+  while( ReadRecordHeader( type) )
+  {
+    if( type == InputRecorder::Rec_Keyframe )
+      mKeyframes.push_back( InputRecorder::KeyframeEntry{ mTime, start });
+    if( !ReplayRecord( type, false) )
+    {
+      // a log cut off in the middle of a keyframe
+      if( type == InputRecorder::Rec_Keyframe )
+        mKeyframes.pop_back();
+      break;
+    }
+    start = mPos;
+  }
+
+  mPos = pos;
+  mTime = time;
+  mIsIndexed = true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Creates the virtual counterpart of a recorded device. The virtual system numbers its devices in order of creation,
+// just like the real backends do, so the IDs match and channel assignments work unchanged.
+void InputReplay::AddDevice( uint64_t id, uint8_t kind, size_t numButtons, size_t numAxes)
+{
+  Device* dev = nullptr;
+  switch( kind )
+  {
+    case InputRecorder::Kind_Mouse: dev = mSystem->AddMouse( numButtons, numAxes); break;
+    case InputRecorder::Kind_Keyboard: dev = mSystem->AddKeyboard( numButtons); break;
+    default: dev = mSystem->AddJoystick( numButtons, numAxes); break;
+  }
+  if( dev->GetId() != id )
+    InputSystem::Log( "SNIIS: replaying recorded device %zd as device %zd", size_t( id), dev->GetId());
+
+  if( mDevices.size() <= id )
+    mDevices.resize( size_t( id) + 1, nullptr);
+  mDevices[size_t( id)] = dev;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool InputReplay::ReadByte( uint8_t& v)
+{
+  if( mPos >= mSize )
+    return false;
+  v = mData[mPos++];
+  return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool InputReplay::ReadVarint( uint64_t& v)
+{
+  v = 0;
+  for( size_t shift = 0; shift < 64 && mPos < mSize; shift += 7 )
+  {
+    uint8_t b = mData[mPos++];
+    v |= uint64_t( b & 0x7f) << shift;
+    if( (b & 0x80) == 0 )
+      return true;
+  }
+  return false;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool InputReplay::ReadFloat( float& v)
+{
+  if( mSize - mPos < 4 )
+    return false;
+  uint32_t bits = 0;
+  for( size_t a = 0; a < 4; ++a )
+    bits |= uint32_t( mData[mPos++]) << (a * 8);
+  memcpy( &v, &bits, sizeof( v));
+  return true;
+}
+
+// ********************************************************************************************************************
+// --------------------------------------------------------------------------------------------------------------------
+// FNV-1a over the bytes of a value, lowest first
+static uint64_t MixHash( uint64_t hash, uint64_t v)
+{
+  for( size_t a = 0; a < 8; ++a )
+    hash = (hash ^ ((v >> (a * 8)) & 0xff)) * 0x100000001b3ull;
+  return hash;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static uint64_t MixHashFloat( uint64_t hash, float v)
+{
+  uint32_t bits;
+  memcpy( &bits, &v, sizeof( bits));
+  return MixHash( hash, bits);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint64_t SNIIS::HashFrame( const InputFrame& frame, uint64_t seed)
+{
+  uint64_t hash = MixHash( seed, frame.mUpdateCount);
+  for( uint64_t word : frame.mState.mData )
+    hash = MixHash( hash, word);
+  for( const auto& r : frame.mDevices )
+  {
+    hash = MixHash( hash, r.mNumPressed);
+    hash = MixHash( hash, r.mNumReleased);
+  }
+  for( size_t btn : frame.mPressedButtons )
+    hash = MixHash( hash, btn);
+  for( size_t btn : frame.mReleasedButtons )
+    hash = MixHash( hash, btn);
+  for( const auto& dch : frame.mDigitalChannels )
+  {
+    hash = MixHash( hash, dch.mId);
+    hash = MixHash( hash, uint64_t( dch.mIsOn) | uint64_t( dch.mIsModified) << 1 | uint64_t( dch.mPressCount) << 8 | uint64_t( dch.mReleaseCount) << 16);
+  }
+  for( const auto& ach : frame.mAnalogChannels )
+  {
+    hash = MixHash( hash, ach.mId);
+    hash = MixHashFloat( hash, ach.mValue);
+    hash = MixHashFloat( hash, ach.mDiff);
+  }
+  return hash;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HashingHandler::Mix( uint64_t v)
+{
+  mHash = MixHash( mHash, v);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HashingHandler::MixFloat( float v)
+{
+  mHash = MixHashFloat( mHash, v);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Each call mixes in a number for the kind of call, the device ID and the arguments
+bool HashingHandler::OnKey( Keyboard* kb, KeyCode kc, bool isPressed)
+{
+  Mix( 1); Mix( kb->GetId()); Mix( size_t( kc)); Mix( isPressed);
+  return mNext && mNext->OnKey( kb, kc, isPressed);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool HashingHandler::OnMouseMoved( Mouse* mouse, float x, float y)
+{
+  Mix( 2); Mix( mouse->GetId()); MixFloat( x); MixFloat( y);
+  return mNext && mNext->OnMouseMoved( mouse, x, y);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool HashingHandler::OnMouseButton( Mouse* mouse, size_t btnIndex, bool isPressed)
+{
+  Mix( 3); Mix( mouse->GetId()); Mix( btnIndex); Mix( isPressed);
+  return mNext && mNext->OnMouseButton( mouse, btnIndex, isPressed);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool HashingHandler::OnMouseWheel( Mouse* mouse, float diff)
+{
+  Mix( 4); Mix( mouse->GetId()); MixFloat( diff);
+  return mNext && mNext->OnMouseWheel( mouse, diff);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool HashingHandler::OnJoystickButton( Joystick* joy, size_t btnIndex, bool isPressed)
+{
+  Mix( 5); Mix( joy->GetId()); Mix( btnIndex); Mix( isPressed);
+  return mNext && mNext->OnJoystickButton( joy, btnIndex, isPressed);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool HashingHandler::OnJoystickAxis( Joystick* joy, size_t axisIndex, float value)
+{
+  Mix( 6); Mix( joy->GetId()); Mix( axisIndex); MixFloat( value);
+  return mNext && mNext->OnJoystickAxis( joy, axisIndex, value);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool HashingHandler::OnUnicode( Keyboard* kb, size_t unicode)
+{
+  Mix( 7); Mix( kb->GetId()); Mix( unicode);
+  return mNext && mNext->OnUnicode( kb, unicode);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool HashingHandler::OnDigitalEvent( Device* dev, size_t btnIndex, bool isPressed)
+{
+  Mix( 8); Mix( dev->GetId()); Mix( btnIndex); Mix( isPressed);
+  return mNext && mNext->OnDigitalEvent( dev, btnIndex, isPressed);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool HashingHandler::OnAnalogEvent( Device* dev, size_t axisIndex, float value)
+{
+  Mix( 9); Mix( dev->GetId()); Mix( axisIndex); MixFloat( value);
+  return mNext && mNext->OnAnalogEvent( dev, axisIndex, value);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HashingHandler::OnDigitalChannel( const DigitalChannel& ch)
+{
+  Mix( 10); Mix( ch.GetId()); Mix( ch.IsOn());
+  if( mNext )
+    mNext->OnDigitalChannel( ch);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HashingHandler::OnAnalogChannel( const AnalogChannel& ch)
+{
+  Mix( 11); Mix( ch.GetId()); MixFloat( ch.GetAbsolute());
+  if( mNext )
+    mNext->OnAnalogChannel( ch);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HashingHandler::OnInputDropped( Device* dev)
+{
+  Mix( 12); Mix( dev->GetId());
+  if( mNext )
+    mNext->OnInputDropped( dev);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Not hashed: it depends on how fast the application ran, which a replay doesn't reproduce
+void HashingHandler::OnOsQueueBacklog( size_t length)
+{
+  if( mNext )
+    mNext->OnOsQueueBacklog( length);
+}
+
+// ********************************************************************************************************************
+// --------------------------------------------------------------------------------------------------------------------
+MappedFile::MappedFile( const char* path)
+{
+  mData = nullptr;
+  mSize = 0;
+  mMapping = nullptr;
+
+#if SNIIS_SYSTEM_WINDOWS
+  HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if( file == INVALID_HANDLE_VALUE )
+    throw std::runtime_error( "Failed to open file");
+  LARGE_INTEGER size;
+  if( !GetFileSizeEx( file, &size) )
+  {
+    CloseHandle( file);
+    throw std::runtime_error( "Failed to get file size");
+  }
+  mSize = size_t( size.QuadPart);
+  // an empty file can't be mapped, but there's nothing to map anyways
+  if( mSize > 0 )
+  {
+    mMapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if( mMapping )
+      mData = static_cast<const uint8_t*> (MapViewOfFile( mMapping, FILE_MAP_READ, 0, 0, 0));
+  }
+  CloseHandle( file);
+  if( mSize > 0 && !mData )
+  {
+    if( mMapping )
+      CloseHandle( mMapping);
+    throw std::runtime_error( "Failed to map file");
+  }
+#else
+  int fd = open( path, O_RDONLY);
+  if( fd < 0 )
+    throw std::runtime_error( "Failed to open file");
+  struct stat st;
+  if( fstat( fd, &st) != 0 )
+  {
+    close( fd);
+    throw std::runtime_error( "Failed to get file size");
+  }
+  mSize = size_t( st.st_size);
+  // an empty file can't be mapped, but there's nothing to map anyways
+  void* ptr = mSize > 0 ? mmap( nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+  close( fd);
+  if( ptr == MAP_FAILED )
+    throw std::runtime_error( "Failed to map file");
+  mData = static_cast<const uint8_t*> (ptr);
+#endif
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+MappedFile::~MappedFile()
+{
+#if SNIIS_SYSTEM_WINDOWS
+  if( mData )
+    UnmapViewOfFile( mData);
+  if( mMapping )
+    CloseHandle( mMapping);
+#else
+  if( mData )
+    munmap( const_cast<uint8_t*> (mData), mSize);
+#endif
+}
@@ -0,0 +1,212 @@
+/// @file SNIIS_Record.h
+/// Recording of input into a compact binary log, and replaying it through the virtual input system
+
+#pragma once
+
+#include "SNIIS.h"
+
+class VirtualInput;
+
+namespace SNIIS
+{
+/// -------------------------------------------------------------------------------------------------------------------
+/// Records everything the backend hands to SNIIS: the device set with its state at the start of the recording, the key
+/// repetition config, focus changes, enabling and disabling devices, every button, key, axis and wheel input, lost
+/// input and the end of each Update(), all with timestamps. Replay the log with an InputReplay.
+/// The log is a stream of records: a type byte, the time since the previous record and the payload, all integers
+/// packed as variable-length integers. Most inputs take 4 to 8 bytes, and recording only appends to a memory buffer,
+/// so it's cheap enough to keep running all the time. Write out the log yourself or use WriteToFile().
+/// Every now and then the recorder adds a keyframe with the complete state, so that a replay can seek without going
+/// through everything before. Stopping the recording appends an index of all keyframes to the log.
+class InputRecorder
+{
+  friend class InputSystem;
+  friend struct InputSystemHelper;
+
+public:
+  InputRecorder();
+  ~InputRecorder();
+  SNIIS_CLASS_ALLOCATION
+
+  /// Starts a new log and attaches to the given system. An InputSystem can only have one recorder at a time. Set the
+  /// key repetition config before starting, changes during the recording are not recorded.
+  void Start( InputSystem* sys);
+  /// Detaches from the system and finishes the log with the keyframe index. The log stays until the next Start().
+  /// Destroying the system also stops the recording.
+  void Stop();
+  bool IsRecording() const { return mSystem != nullptr; }
+
+  /// Sets the minimum time between two keyframes in microseconds, default is 10 seconds. Zero disables keyframes
+  /// except for the one at the start.
+  void SetKeyframeInterval( uint64_t interval) { mKeyframeInterval = interval; }
+
+  /// The log so far
+  const Vector<uint8_t>& GetData() const { return mData; }
+  /// Writes the log so far to the given file. Returns false if the file couldn't be written.
+  bool WriteToFile( const char* path) const;
+
+  /// Record types, stored as the first byte of each record
+  enum RecordType : uint8_t
+  {
+    Rec_Device = 1, ///< id, kind, button count, axis count, enabled, pressed buttons, axis values
+    Rec_KeyRepeat, ///< enabled, delay, interval
+    Rec_Focus, ///< has focus
+    Rec_DeviceEnabled, ///< id, enabled
+    Rec_Button, ///< id, button index * 2 + pressed
+    Rec_Key, ///< id, key code * 2 + pressed, unicode
+    Rec_MouseMove, ///< id, absolute x/y, relative x/y
+    Rec_Wheel, ///< id, diff
+    Rec_Axis, ///< id, axis index, value
+    Rec_Update, ///< end of an Update(), the time is the time of the Update()
+    Rec_Keyframe, ///< update count, focus, each device's buttons and axes, key repetition, channels
+    Rec_Index, ///< the keyframes as time and offset, each relative to the previous one. Followed by the trailer, see IndexMagic.
+    Rec_InputDropped ///< id. Since version 2.
+  };
+  enum DeviceKind : uint8_t { Kind_Mouse, Kind_Keyboard, Kind_Joystick };
+  /// First bytes of each log, followed by the format version
+  static const uint32_t Magic = 0x52494e53; // "SNIR"
+  static const uint32_t Version = 2;
+  /// Oldest format version a replay still reads
+  static const uint32_t MinVersion = 1;
+  /// Last bytes of a finished log: the offset of the Rec_Index record as 8 bytes and these 4 bytes
+  static const uint32_t IndexMagic = 0x58494e53; // "SNIX"
+  static const size_t IndexTrailerSize = 12;
+
+  /// Position of a keyframe in the log
+  struct KeyframeEntry { uint64_t mTime; uint64_t mOffset; };
+
+private:
+  void RecordDevice( const Device* dev);
+  void RecordFocus( bool hasFocus);
+  void RecordDeviceEnabled( const Device* dev, bool enabled);
+  void RecordButton( const Device* dev, size_t btnIndex, bool isPressed);
+  void RecordKey( const Device* dev, KeyCode kc, size_t unicode, bool isPressed);
+  void RecordMouseMove( const Device* dev, float absx, float absy, float relx, float rely);
+  void RecordWheel( const Device* dev, float diff);
+  void RecordAxis( const Device* dev, size_t axisIndex, float value);
+  void RecordInputDropped( const Device* dev);
+  void RecordUpdate();
+  void RecordKeyframe();
+  void RecordIndex();
+
+  void BeginRecord( RecordType type, uint64_t time);
+  void WriteVarint( uint64_t v);
+  void WriteFloat( float v);
+
+  InputSystem* mSystem; ///< the system we're attached to, or Null
+  Vector<uint8_t> mData;
+  uint64_t mLastTime; ///< time of the last record written
+  uint64_t mKeyframeInterval;
+  Vector<KeyframeEntry> mKeyframes;
+};
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// Replays a log written by an InputRecorder through a VirtualInput. It creates the recorded devices in their recorded
+/// state, and each Step() feeds the input of the next recorded Update() with its original timestamps and then runs the
+/// Update() on the recorded clock. So key repetition, handlers, channels and the event queue see the same input in the
+/// same order at the same times as during the recording.
+class InputReplay
+{
+public:
+  /// Prepares replaying the given log into the given virtual system, which should not have any devices yet, and
+  /// creates the recorded devices. The log must stay alive while replaying; use a MappedFile to replay a file without
+  /// reading all of it. Throws if the data isn't an input log.
+  InputReplay( VirtualInput* pSystem, const uint8_t* pData, size_t pSize);
+  SNIIS_CLASS_ALLOCATION
+
+  /// Replays everything up to and including the next recorded Update(). Returns false at the end of the log, or if
+  /// the log is broken.
+  bool Step();
+  /// Jumps to the given recorded time, forwards or backwards: restores the state of the last keyframe before it and
+  /// replays all Update()s up to the given time from there. Restoring a keyframe doesn't signal anything, only the
+  /// Update()s after it do. Returns false if the log has no keyframe before the given time.
+  bool Seek( uint64_t time);
+  /// Replays the rest of the log as fast as possible and returns a hash for each Update(), covering the resulting
+  /// frame and every handler call during the Update(). Compare them to the hashes of a known good run to check that
+  /// a change to SNIIS didn't change its behaviour. An installed handler still gets called.
+  Vector<uint64_t> ComputeFrameHashes();
+  /// Returns true if everything was replayed
+  bool IsAtEnd() const { return mPos >= mSize; }
+  /// Returns the recorded time up to which we replayed, in microseconds since the recorded system was created
+  uint64_t GetTime() const { return mTime; }
+
+protected:
+  bool ReplayRecord( uint8_t type, bool isApplied);
+  bool ReplayKeyframe( bool isApplied);
+  bool ReadRecordHeader( uint8_t& type);
+  void ReadIndex();
+  void BuildIndex();
+  void AddDevice( uint64_t id, uint8_t kind, size_t numButtons, size_t numAxes);
+  Device* GetDevice( uint64_t id) const { return id < mDevices.size() ? mDevices[id] : nullptr; }
+  bool ReadByte( uint8_t& v);
+  bool ReadVarint( uint64_t& v);
+  bool ReadFloat( float& v);
+
+  VirtualInput* mSystem;
+  const uint8_t* mData;
+  size_t mSize, mPos;
+  size_t mFirstRecord; ///< position of the first record after the header
+  uint64_t mTime;
+  Vector<Device*> mDevices; ///< virtual device for each recorded device ID
+  Vector<InputRecorder::KeyframeEntry> mKeyframes;
+  bool mIsIndexed; ///< true if mKeyframes is complete, either from the log's index or from scanning the log
+};
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// Returns a 64bit FNV-1a hash of the frame's state: update count, button and axis state, edge lists and channels
+uint64_t HashFrame( const InputFrame& frame, uint64_t seed = 0xcbf29ce484222325ull);
+
+/// Input handler which hashes every call with its arguments, in order. Forwards all calls to the next handler, if any,
+/// and returns its result, so the calls continue down the levels just like without the hashing handler in between.
+class HashingHandler : public InputHandler
+{
+public:
+  explicit HashingHandler( InputHandler* pNext = nullptr) : mNext( pNext), mHash( 0xcbf29ce484222325ull) { }
+
+  uint64_t GetHash() const { return mHash; }
+  void Reset() { mHash = 0xcbf29ce484222325ull; }
+
+  bool OnKey( Keyboard* kb, KeyCode kc, bool isPressed) override;
+  bool OnMouseMoved( Mouse* mouse, float x, float y) override;
+  bool OnMouseButton( Mouse* mouse, size_t btnIndex, bool isPressed) override;
+  bool OnMouseWheel( Mouse* mouse, float diff) override;
+  bool OnJoystickButton( Joystick* joy, size_t btnIndex, bool isPressed) override;
+  bool OnJoystickAxis( Joystick* joy, size_t axisIndex, float value) override;
+  bool OnUnicode( Keyboard* kb, size_t unicode) override;
+  bool OnDigitalEvent( Device* dev, size_t btnIndex, bool isPressed) override;
+  bool OnAnalogEvent( Device* dev, size_t axisIndex, float value) override;
+  void OnDigitalChannel( const DigitalChannel& ch) override;
+  void OnAnalogChannel( const AnalogChannel& ch) override;
+  void OnInputDropped( Device* dev) override;
+  void OnOsQueueBacklog( size_t length) override;
+
+protected:
+  void Mix( uint64_t v);
+  void MixFloat( float v);
+
+  InputHandler* mNext;
+  uint64_t mHash;
+};
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// Read-only memory mapping of a whole file, so that replaying a large log only reads the parts it gets to. Throws if
+/// the file can't be opened or mapped.
+class MappedFile
+{
+public:
+  explicit MappedFile( const char* path);
+  ~MappedFile();
+  MappedFile( const MappedFile&) = delete;
+  MappedFile& operator = ( const MappedFile&) = delete;
+  SNIIS_CLASS_ALLOCATION
+
+  const uint8_t* GetData() const { return mData; }
+  size_t GetSize() const { return mSize; }
+
+protected:
+  const uint8_t* mData;
+  size_t mSize;
+  void* mMapping; ///< mapping handle on Windows
+};
+
+} // namespace SNIIS
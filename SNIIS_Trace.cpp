@@ -0,0 +1,131 @@
+/// @file SNIIS_Trace.cpp
+/// Implementation of input pipeline tracing
+
+#include "SNIIS_Trace.h"
+#include <cinttypes>
+#include <cstdio>
+#include <stdexcept>
+
+using namespace SNIIS;
+
+// --------------------------------------------------------------------------------------------------------------------
+InputTracer::InputTracer() : mNumEvents( 0), mNumDropped( 0)
+{
+  mSystem = nullptr;
+  mUpdateStart = 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+InputTracer::~InputTracer()
+{
+  Stop();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputTracer::Start( InputSystem* sys, size_t pCapacity)
+{
+  if( sys->mTracer && sys->mTracer != this )
+    throw std::runtime_error( "Input system already has a tracer");
+  Stop();
+
+  // all allocation happens here, so that adding events later never does
+  mEvents.clear();
+  mEvents.resize( pCapacity);
+  Clear();
+  mUpdateStart = 0;
+  mSystem = sys;
+  sys->mTracer = this;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputTracer::Stop()
+{
+  if( !mSystem )
+    return;
+  mSystem->mTracer = nullptr;
+  mSystem = nullptr;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputTracer::Clear()
+{
+  mNumEvents.store( 0, std::memory_order_release);
+  mNumDropped.store( 0, std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputTracer::AddZone( const char* name, uint64_t start, uint64_t end, size_t device)
+{
+  AddEvent( Event{ name, start, end - start, 0, device, 0, 0.0f, false });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputTracer::AddInput( const char* name, const Device* dev, size_t control, float value, uint64_t sourceTime)
+{
+  uint64_t now = uint64_t( std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count());
+  AddEvent( Event{ name, now, 0, sourceTime, dev->GetId(), control, value, true });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Only the thread calling Update() adds events. It fills the slot first and publishes it by advancing the count, so a
+// concurrent WriteJson() only ever reads complete events.
+void InputTracer::AddEvent( const Event& ev)
+{
+  size_t index = mNumEvents.load( std::memory_order_relaxed);
+  if( index >= mEvents.size() )
+  {
+    mNumDropped.fetch_add( 1, std::memory_order_relaxed);
+    return;
+  }
+  mEvents[index] = ev;
+  mNumEvents.store( index + 1, std::memory_order_release);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void InputTracer::WriteJson( std::string& out, uint32_t pid, uint32_t tid) const
+{
+  size_t count = mNumEvents.load( std::memory_order_acquire);
+  char buf[512];
+  snprintf( buf, sizeof( buf), "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+    "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"SNIIS\"}}", pid, tid);
+  out += buf;
+
+  // timestamps in microseconds with nanosecond digits
+  for( size_t a = 0; a < count; ++a )
+  {
+    const auto& ev = mEvents[a];
+    int len = snprintf( buf, sizeof( buf), ",\n{\"name\":\"%s\",\"cat\":\"input\",\"ph\":\"%s\",\"ts\":%" PRIu64 ".%03u,",
+      ev.mName, ev.mIsInstant ? "i\",\"s\":\"t" : "X", ev.mTime / 1000, unsigned( ev.mTime % 1000));
+    if( !ev.mIsInstant )
+      len += snprintf( buf + len, sizeof( buf) - len, "\"dur\":%" PRIu64 ".%03u,", ev.mDuration / 1000, unsigned( ev.mDuration % 1000));
+    len += snprintf( buf + len, sizeof( buf) - len, "\"pid\":%u,\"tid\":%u", pid, tid);
+
+    if( ev.mIsInstant )
+    {
+      len += snprintf( buf + len, sizeof( buf) - len, ",\"args\":{\"device\":%zu,\"control\":%zu,\"value\":%g",
+        ev.mDevice, ev.mControl, double( ev.mValue));
+      if( ev.mSourceTime != 0 )
+        len += snprintf( buf + len, sizeof( buf) - len, ",\"hardware_ts\":%" PRIu64, ev.mSourceTime);
+      len += snprintf( buf + len, sizeof( buf) - len, "}");
+    } else if( ev.mDevice != SIZE_MAX )
+    {
+      len += snprintf( buf + len, sizeof( buf) - len, ",\"args\":{\"device\":%zu}", ev.mDevice);
+    }
+    snprintf( buf + len, sizeof( buf) - len, "}");
+    out += buf;
+  }
+
+  out += "\n]}\n";
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool InputTracer::WriteToFile( const char* path, uint32_t pid, uint32_t tid) const
+{
+  std::string json;
+  WriteJson( json, pid, tid);
+  FILE* file = fopen( path, "wb");
+  if( !file )
+    return false;
+  bool isOk = fwrite( json.data(), 1, json.size(), file) == json.size();
+  return fclose( file) == 0 && isOk;
+}
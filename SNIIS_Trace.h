@@ -0,0 +1,70 @@
+/// @file SNIIS_Trace.h
+/// Tracing of the input pipeline in the Chrome trace event format, for viewing in Perfetto or chrome://tracing
+
+#pragma once
+
+#include "SNIIS.h"
+
+namespace SNIIS
+{
+/// -------------------------------------------------------------------------------------------------------------------
+/// Traces what SNIIS does during each Update(): zones for the Update() itself and its stages, for reading each device,
+/// for dispatching each input to handlers and channels and for evaluating the channels, and an instant event for each
+/// input with the device, control, value and hardware timestamp if known.
+/// Events go into a buffer allocated at Start(), so tracing neither allocates nor locks. A full buffer drops further
+/// events and counts them. Times are taken from the steady clock, which is CLOCK_MONOTONIC on Linux, so the trace lines
+/// up with other traces of the application which use that clock.
+class InputTracer
+{
+  friend struct InputSystemHelper;
+
+public:
+  InputTracer();
+  ~InputTracer();
+  SNIIS_CLASS_ALLOCATION
+
+  /// Starts a new trace with room for the given number of events and attaches to the system. An InputSystem can only
+  /// have one tracer at a time.
+  void Start( InputSystem* sys, size_t pCapacity = 65536);
+  /// Detaches from the system. The events stay until the next Start() or Clear(). Destroying the system also stops.
+  void Stop();
+  bool IsTracing() const { return mSystem != nullptr; }
+  /// Forgets all events so far. Call it on the thread which calls Update(), and not while writing the trace.
+  void Clear();
+
+  size_t GetNumEvents() const { return mNumEvents.load( std::memory_order_acquire); }
+  /// Returns the number of events lost because the buffer was full
+  uint64_t GetNumDropped() const { return mNumDropped.load( std::memory_order_relaxed); }
+
+  /// Appends all events so far to the given string as Chrome trace JSON, with the given process and thread IDs. Can
+  /// be called on any thread while the tracing goes on; it writes the events which were complete when it started.
+  void WriteJson( std::string& out, uint32_t pid = 1, uint32_t tid = 1) const;
+  /// Writes the trace to the given file. Returns false if the file couldn't be written.
+  bool WriteToFile( const char* path, uint32_t pid = 1, uint32_t tid = 1) const;
+
+  /// A zone or an instant event
+  struct Event
+  {
+    const char* mName; ///< static string
+    uint64_t mTime; ///< start in nanoseconds
+    uint64_t mDuration; ///< in nanoseconds, zero for instant events
+    uint64_t mSourceTime; ///< hardware time of an input in microseconds, or zero if unknown
+    size_t mDevice; ///< device ID, or SIZE_MAX if it's not about a single device
+    size_t mControl; ///< button, axis or key code of an input
+    float mValue; ///< value of an input
+    bool mIsInstant;
+  };
+
+private:
+  void AddZone( const char* name, uint64_t start, uint64_t end, size_t device);
+  void AddInput( const char* name, const Device* dev, size_t control, float value, uint64_t sourceTime);
+  void AddEvent( const Event& ev);
+
+  InputSystem* mSystem; ///< the system we're attached to, or Null
+  Vector<Event> mEvents; ///< preallocated, only the first mNumEvents are valid
+  std::atomic<size_t> mNumEvents;
+  std::atomic<uint64_t> mNumDropped;
+  uint64_t mUpdateStart; ///< start of the current Update(), or zero if we started tracing in the middle of it
+};
+
+} // namespace SNIIS
@@ -0,0 +1,401 @@
+/// @file SNIIS_Virtual.cpp
+/// Implementation of the virtual input system
+
+#include "SNIIS_Virtual.h"
+#include "SNIIS_Intern.h"
+
+using namespace SNIIS;
+
+// --------------------------------------------------------------------------------------------------------------------
+// Creates a virtual input system
+VirtualInput* VirtualInput::Create( const InitOptions& pOptions)
+{
+  AllocatorScope scope( pOptions.mAllocator);
+  return new VirtualInput;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Constructor
+VirtualInput::VirtualInput()
+{
+  mIsClockManual = false;
+  mManualTime = 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Destructor
+VirtualInput::~VirtualInput()
+{
+  for( auto d : mDevices )
+    delete d;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+VirtualMouse* VirtualInput::AddMouse( size_t pNumButtons, size_t pNumAxes)
+{
+  AllocatorScope scope( mAllocator);
+  auto m = new VirtualMouse( this, mDevices.size(), pNumButtons, std::max( pNumAxes, size_t( 3)));
+  InputSystemHelper::AddDevice( this, m);
+  return m;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+VirtualKeyboard* VirtualInput::AddKeyboard( size_t pNumKeys)
+{
+  AllocatorScope scope( mAllocator);
+  auto k = new VirtualKeyboard( this, mDevices.size(), pNumKeys);
+  InputSystemHelper::AddDevice( this, k);
+  return k;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+VirtualJoystick* VirtualInput::AddJoystick( size_t pNumButtons, size_t pNumAxes)
+{
+  AllocatorScope scope( mAllocator);
+  auto j = new VirtualJoystick( this, mDevices.size(), pNumButtons, pNumAxes);
+  InputSystemHelper::AddDevice( this, j);
+  return j;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Sets the state of a control without signalling. Goes to the state arena directly, for both current and previous state
+void VirtualInput::PresetButton( Device* dev, size_t pButton, bool pIsPressed)
+{
+  if( dev->GetSystem() != this || pButton >= dev->GetNumButtons() )
+    return;
+  size_t word = size_t( dev->Buttons().mWords - mState.Buttons()) + pButton / 64;
+  uint64_t mask = 1ull << (pButton & 63);
+  for( uint64_t* section : { mState.Buttons(), mState.PrevButtons() } )
+    section[word] = pIsPressed ? (section[word] | mask) : (section[word] & ~mask);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualInput::PresetAxis( Device* dev, size_t pAxis, float pValue)
+{
+  if( dev->GetSystem() != this || pAxis >= dev->GetNumAxes() )
+    return;
+  size_t slot = size_t( dev->Axes().begin() - mState.Axes()) + pAxis;
+  mState.Axes()[slot] = mState.PrevAxes()[slot] = pValue;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualInput::DropInput( Device* dev)
+{
+  if( dev->GetSystem() == this )
+    Feed( PendingInput{ dev, PendingInput::Type_InputDropped, 0, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0 });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Switches to the manual clock
+void VirtualInput::SetTime( uint64_t pTime)
+{
+  mIsClockManual = true;
+  mManualTime = pTime;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint64_t VirtualInput::ReadClock() const
+{
+  return mIsClockManual ? mManualTime : InputSystem::ReadClock();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Updates the inputs: processes all input fed since the last update
+void VirtualInput::Update()
+{
+  InputSystem::Update();
+  auto stats = InputSystemHelper::GetUpdateStats( this);
+  uint64_t stageStart = InputSystemHelper::BeginStage( this);
+
+  // wheel axis is relative, shows movements only. So zero out for each frame and start accumulating differences anew
+  for( auto d : mDevices )
+    if( auto m = dynamic_cast<VirtualMouse*> (d) )
+      m->SetAxisValue( 2, 0.0f);
+
+  // without focus nothing gets through, just like with the real backends. A manual clock runs through the times
+  // the input was fed at, so that everything signalled gets the same timestamps each time.
+  const uint64_t updateTime = mManualTime;
+  if( mHasFocus )
+  {
+    for( const auto& inp : mPendingInput )
+    {
+      mManualTime = inp.mTime;
+      Process( inp);
+    }
+  }
+  mManualTime = updateTime;
+  if( stats )
+    stats->mOsEvents += mPendingInput.size();
+  mPendingInput.clear();
+  InputSystemHelper::EndStage( this, UpdateStats::Stage_Pump, stageStart);
+
+  for( auto d : mDevices )
+    d->ResetFirstUpdateFlag();
+
+  InputSystemHelper::FinishUpdate( this);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualInput::Feed( const PendingInput& pInput)
+{
+  mPendingInput.push_back( pInput);
+  mPendingInput.back().mTime = ReadClock();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Applies a single input to the device state and signals it
+void VirtualInput::Process( const PendingInput& pInput)
+{
+  auto dev = pInput.mDevice;
+  if( !dev->IsEnabled() )
+    return;
+
+  switch( pInput.mType )
+  {
+    case PendingInput::Type_Button:
+    {
+      bool isPressed = pInput.mValue != 0.0f;
+      if( auto m = dynamic_cast<VirtualMouse*> (dev) )
+      {
+        if( pInput.mControl >= m->GetNumButtons() || m->IsButtonBitSet( pInput.mControl) == isPressed )
+          break;
+        m->SetButtonBit( pInput.mControl, isPressed);
+        InputSystemHelper::DoMouseButton( m, pInput.mControl, isPressed);
+      }
+      else if( auto j = dynamic_cast<VirtualJoystick*> (dev) )
+      {
+        if( pInput.mControl >= j->GetNumButtons() || j->IsButtonBitSet( pInput.mControl) == isPressed )
+          break;
+        j->SetButtonBit( pInput.mControl, isPressed);
+        InputSystemHelper::DoJoystickButton( j, pInput.mControl, isPressed);
+      }
+      break;
+    }
+
+    case PendingInput::Type_MouseMove:
+    {
+      auto m = static_cast<VirtualMouse*> (dev);
+      float relx = pInput.mValue - m->GetAxisValue( 0), rely = pInput.mValue2 - m->GetAxisValue( 1);
+      if( relx == 0.0f && rely == 0.0f )
+        break;
+      m->SetAxisValue( 0, pInput.mValue);
+      m->SetAxisValue( 1, pInput.mValue2);
+      InputSystemHelper::DoMouseMove( m, pInput.mValue, pInput.mValue2, relx, rely);
+      break;
+    }
+
+    case PendingInput::Type_MouseMoveRel:
+    {
+      auto m = static_cast<VirtualMouse*> (dev);
+      m->SetAxisValue( 0, pInput.mValue);
+      m->SetAxisValue( 1, pInput.mValue2);
+      InputSystemHelper::DoMouseMove( m, pInput.mValue, pInput.mValue2, pInput.mRelX, pInput.mRelY);
+      break;
+    }
+
+    case PendingInput::Type_MouseWheel:
+    {
+      auto m = static_cast<VirtualMouse*> (dev);
+      m->SetAxisValue( 2, m->GetAxisValue( 2) + pInput.mValue);
+      InputSystemHelper::DoMouseWheel( m, pInput.mValue);
+      break;
+    }
+
+    case PendingInput::Type_Key:
+    {
+      auto k = static_cast<VirtualKeyboard*> (dev);
+      bool isPressed = pInput.mValue != 0.0f;
+      if( pInput.mControl >= k->GetNumButtons() || k->IsButtonBitSet( pInput.mControl) == isPressed )
+        break;
+      k->SetButtonBit( pInput.mControl, isPressed);
+      InputSystemHelper::DoKeyboardButton( k, KeyCode( pInput.mControl), pInput.mUnicode, isPressed);
+      break;
+    }
+
+    case PendingInput::Type_Axis:
+    {
+      auto j = static_cast<VirtualJoystick*> (dev);
+      if( pInput.mControl >= j->GetNumAxes() || j->GetAxisValue( pInput.mControl) == pInput.mValue )
+        break;
+      j->SetAxisValue( pInput.mControl, pInput.mValue);
+      InputSystemHelper::DoJoystickAxis( j, pInput.mControl, pInput.mValue);
+      break;
+    }
+
+    case PendingInput::Type_InputDropped:
+      InputSystemHelper::DoInputDropped( dev);
+      break;
+  }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Notifies the input system that the application has lost/gained focus.
+void VirtualInput::InternSetFocus( bool pHasFocus)
+{
+  // Like the real backends: losing focus releases everything, gaining focus doesn't do anything
+  if( !pHasFocus )
+    for( auto d : mDevices )
+      ReleaseAll( d);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualInput::InternSetMouseGrab( bool enabled)
+{
+  // nothing to grab
+  SNIIS_UNUSED( enabled);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualInput::InternSetDeviceEnabled( Device* dev, bool enabled)
+{
+  // a disabled device releases everything as if we lost focus
+  if( !enabled )
+    ReleaseAll( dev);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Releases all buttons and centers all joystick axes of the given device, signalling each change
+void VirtualInput::ReleaseAll( Device* dev)
+{
+  for( size_t a = 0; a < dev->GetNumButtons(); ++a )
+  {
+    if( !dev->IsButtonDown( a) )
+      continue;
+    if( auto m = dynamic_cast<VirtualMouse*> (dev) )
+    {
+      m->SetButtonBit( a, false);
+      InputSystemHelper::DoMouseButton( m, a, false);
+    }
+    else if( auto k = dynamic_cast<VirtualKeyboard*> (dev) )
+    {
+      k->SetButtonBit( a, false);
+      InputSystemHelper::DoKeyboardButton( k, KeyCode( a), 0, false);
+    }
+    else if( auto j = dynamic_cast<VirtualJoystick*> (dev) )
+    {
+      j->SetButtonBit( a, false);
+      InputSystemHelper::DoJoystickButton( j, a, false);
+    }
+  }
+
+  if( auto j = dynamic_cast<VirtualJoystick*> (dev) )
+  {
+    for( size_t a = 0; a < j->GetNumAxes(); ++a )
+    {
+      if( j->GetAxisValue( a) != 0.0f )
+      {
+        j->SetAxisValue( a, 0.0f);
+        InputSystemHelper::DoJoystickAxis( j, a, 0.0f);
+      }
+    }
+  }
+}
+
+// ********************************************************************************************************************
+// --------------------------------------------------------------------------------------------------------------------
+VirtualMouse::VirtualMouse( VirtualInput* pSystem, size_t pId, size_t pNumButtons, size_t pNumAxes)
+  : Mouse( pId, false), mSystem( pSystem), mNumButtons( pNumButtons), mNumAxes( pNumAxes)
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualMouse::SetButton( size_t pButton, bool pIsPressed)
+{
+  mSystem->Feed( VirtualInput::PendingInput{ this, VirtualInput::PendingInput::Type_Button, pButton, pIsPressed ? 1.0f : 0.0f, 0.0f, 0, 0.0f, 0.0f, 0 });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualMouse::Move( float pRelX, float pRelY)
+{
+  // relative to the last position fed, which might not be processed yet
+  float x = GetAxisValue( 0), y = GetAxisValue( 1);
+  for( const auto& inp : mSystem->mPendingInput )
+  {
+    if( inp.mDevice == this && (inp.mType == VirtualInput::PendingInput::Type_MouseMove || inp.mType == VirtualInput::PendingInput::Type_MouseMoveRel) )
+    {
+      x = inp.mValue; y = inp.mValue2;
+    }
+  }
+  MoveTo( x + pRelX, y + pRelY);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualMouse::MoveTo( float pAbsX, float pAbsY)
+{
+  mSystem->Feed( VirtualInput::PendingInput{ this, VirtualInput::PendingInput::Type_MouseMove, 0, pAbsX, pAbsY, 0, 0.0f, 0.0f, 0 });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualMouse::MoveTo( float pAbsX, float pAbsY, float pRelX, float pRelY)
+{
+  mSystem->Feed( VirtualInput::PendingInput{ this, VirtualInput::PendingInput::Type_MouseMoveRel, 0, pAbsX, pAbsY, 0, pRelX, pRelY, 0 });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualMouse::Wheel( float pDiff)
+{
+  mSystem->Feed( VirtualInput::PendingInput{ this, VirtualInput::PendingInput::Type_MouseWheel, 2, pDiff, 0.0f, 0, 0.0f, 0.0f, 0 });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+std::string VirtualMouse::GetButtonText( size_t idx) const
+{
+  return idx < mNumButtons ? "Button " + std::to_string( idx + 1) : std::string();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+std::string VirtualMouse::GetAxisText( size_t idx) const
+{
+  static const char* sNames[] = { "X", "Y", "Wheel" };
+  return idx < 3 ? sNames[idx] : idx < mNumAxes ? "Axis " + std::to_string( idx + 1) : std::string();
+}
+
+// ********************************************************************************************************************
+// --------------------------------------------------------------------------------------------------------------------
+VirtualKeyboard::VirtualKeyboard( VirtualInput* pSystem, size_t pId, size_t pNumKeys)
+  : Keyboard( pId, false), mSystem( pSystem), mNumKeys( pNumKeys)
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualKeyboard::SetKey( KeyCode pKey, bool pIsPressed, size_t pUnicode)
+{
+  mSystem->Feed( VirtualInput::PendingInput{ this, VirtualInput::PendingInput::Type_Key, size_t( pKey), pIsPressed ? 1.0f : 0.0f, 0.0f, pUnicode, 0.0f, 0.0f, 0 });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+std::string VirtualKeyboard::GetButtonText( size_t idx) const
+{
+  return idx < mNumKeys ? "Key " + std::to_string( idx) : std::string();
+}
+
+// ********************************************************************************************************************
+// --------------------------------------------------------------------------------------------------------------------
+VirtualJoystick::VirtualJoystick( VirtualInput* pSystem, size_t pId, size_t pNumButtons, size_t pNumAxes)
+  : Joystick( pId), mSystem( pSystem), mNumButtons( pNumButtons), mNumAxes( pNumAxes)
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualJoystick::SetButton( size_t pButton, bool pIsPressed)
+{
+  mSystem->Feed( VirtualInput::PendingInput{ this, VirtualInput::PendingInput::Type_Button, pButton, pIsPressed ? 1.0f : 0.0f, 0.0f, 0, 0.0f, 0.0f, 0 });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void VirtualJoystick::SetAxis( size_t pAxis, float pValue)
+{
+  mSystem->Feed( VirtualInput::PendingInput{ this, VirtualInput::PendingInput::Type_Axis, pAxis, pValue, 0.0f, 0, 0.0f, 0.0f, 0 });
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+std::string VirtualJoystick::GetButtonText( size_t idx) const
+{
+  return idx < mNumButtons ? "Button " + std::to_string( idx + 1) : std::string();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+std::string VirtualJoystick::GetAxisText( size_t idx) const
+{
+  return idx < mNumAxes ? "Axis " + std::to_string( idx + 1) : std::string();
+}
@@ -0,0 +1,144 @@
+/// @file SNIIS_Virtual.h
+/// Virtual input system without any connection to the OS. Devices are created and fed by the application.
+
+#pragma once
+
+#include "SNIIS.h"
+
+class VirtualMouse;
+class VirtualKeyboard;
+class VirtualJoystick;
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// Virtual Input System. Works headless on every platform, for tests, benchmarks and simulations. Create devices with
+/// the Add*() functions and feed them input through their functions. Input fed between two updates is processed in
+/// order during the next Update() and goes through the same dispatch as input of the real backends.
+class VirtualInput : public SNIIS::InputSystem
+{
+  friend class VirtualMouse;
+  friend class VirtualKeyboard;
+  friend class VirtualJoystick;
+
+  /// input waiting for the next update
+  struct PendingInput
+  {
+    enum Type { Type_Button, Type_MouseMove, Type_MouseMoveRel, Type_MouseWheel, Type_Key, Type_Axis, Type_InputDropped };
+    SNIIS::Device* mDevice;
+    Type mType;
+    size_t mControl; ///< button, axis or key code
+    float mValue, mValue2; ///< press state, axis value or mouse position
+    size_t mUnicode;
+    float mRelX, mRelY; ///< mouse movement for Type_MouseMoveRel
+    uint64_t mTime; ///< clock at the time the input was fed
+  };
+  SNIIS::Vector<PendingInput> mPendingInput;
+  bool mIsClockManual;
+  uint64_t mManualTime;
+
+public:
+  /// Creates a virtual input system. Destroy it with InputSystem::Destroy(). It does not become gInstance; assign it
+  /// yourself if you want to drive the C interface with it.
+  static VirtualInput* Create( const SNIIS::InitOptions& pOptions = SNIIS::InitOptions());
+
+  /// Constructor
+  VirtualInput();
+  /// Destructor
+  ~VirtualInput();
+
+  /// Adds devices. The returned devices belong to the input system.
+  VirtualMouse* AddMouse( size_t pNumButtons = SNIIS::MB_Count, size_t pNumAxes = 3);
+  VirtualKeyboard* AddKeyboard( size_t pNumKeys = SNIIS::KC_FIRST_CUSTOM);
+  VirtualJoystick* AddJoystick( size_t pNumButtons, size_t pNumAxes);
+
+  /// Sets a control of a device without signalling anything, as if it had been in that state all along
+  void PresetButton( SNIIS::Device* dev, size_t pButton, bool pIsPressed);
+  void PresetAxis( SNIIS::Device* dev, size_t pAxis, float pValue);
+  /// Feeds a loss of input of the device, as if the OS had dropped some of it. It gets signalled in order with the
+  /// other input during the next Update(), see InputHandler::OnInputDropped().
+  void DropInput( SNIIS::Device* dev);
+
+  /// Switches to a manual clock and sets it to the given time in microseconds. From then on time only advances through
+  /// this function, which makes key repetition and event timestamps reproducible. Input keeps the time it was fed at.
+  void SetTime( uint64_t pTime);
+
+  /// Updates the inputs: processes all input fed since the last update
+  void Update() override;
+  /// Notifies the input system that the application has lost/gained focus.
+  void InternSetFocus( bool pHasFocus) override;
+  void InternSetMouseGrab( bool enabled) override;
+  void InternSetDeviceEnabled( SNIIS::Device* dev, bool enabled) override;
+
+protected:
+  uint64_t ReadClock() const override;
+  void Feed( const PendingInput& pInput);
+  void Process( const PendingInput& pInput);
+  void ReleaseAll( SNIIS::Device* dev);
+};
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// Virtual mouse. Axes 0 and 1 are the position, axis 2 is the wheel, further axes are up to you.
+class VirtualMouse : public SNIIS::Mouse
+{
+  friend class VirtualInput;
+  VirtualInput* mSystem;
+  size_t mNumButtons, mNumAxes;
+
+public:
+  VirtualMouse( VirtualInput* pSystem, size_t pId, size_t pNumButtons, size_t pNumAxes);
+
+  /// Feed input
+  void SetButton( size_t pButton, bool pIsPressed);
+  void Move( float pRelX, float pRelY);
+  void MoveTo( float pAbsX, float pAbsY);
+  /// Moves with an explicit relative movement that doesn't need to match the positions, like a grabbed mouse does
+  void MoveTo( float pAbsX, float pAbsY, float pRelX, float pRelY);
+  void Wheel( float pDiff);
+
+  size_t GetNumButtons() const override { return mNumButtons; }
+  std::string GetButtonText( size_t idx) const override;
+  size_t GetNumAxes() const override { return mNumAxes; }
+  std::string GetAxisText( size_t idx) const override;
+  float GetMouseX() const override { return GetAxisAbsolute( 0); }
+  float GetMouseY() const override { return GetAxisAbsolute( 1); }
+  float GetRelMouseX() const override { return GetAxisDifference( 0); }
+  float GetRelMouseY() const override { return GetAxisDifference( 1); }
+};
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// Virtual keyboard with all SNIIS key codes, and custom key codes if you ask for more keys
+class VirtualKeyboard : public SNIIS::Keyboard
+{
+  friend class VirtualInput;
+  VirtualInput* mSystem;
+  size_t mNumKeys;
+
+public:
+  VirtualKeyboard( VirtualInput* pSystem, size_t pId, size_t pNumKeys);
+
+  /// Feed input. The unicode character is what the key press types, if anything.
+  void SetKey( SNIIS::KeyCode pKey, bool pIsPressed, size_t pUnicode = 0);
+
+  size_t GetNumButtons() const override { return mNumKeys; }
+  std::string GetButtonText( size_t idx) const override;
+};
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// Virtual joystick
+class VirtualJoystick : public SNIIS::Joystick
+{
+  friend class VirtualInput;
+  VirtualInput* mSystem;
+  size_t mNumButtons, mNumAxes;
+
+public:
+  VirtualJoystick( VirtualInput* pSystem, size_t pId, size_t pNumButtons, size_t pNumAxes);
+
+  /// Feed input
+  void SetButton( size_t pButton, bool pIsPressed);
+  void SetAxis( size_t pAxis, float pValue);
+
+  size_t GetNumButtons() const override { return mNumButtons; }
+  std::string GetButtonText( size_t idx) const override;
+  size_t GetNumAxes() const override { return mNumAxes; }
+  std::string GetAxisText( size_t idx) const override;
+};
@@ -51,7 +51,10 @@ WinInput::WinInput(HWND wnd)
   // This approach is now hopefully reliable enough to catch all messages without losses, while still not interfering
   // with the game's message loop
 
+  uint64_t phaseStart = ReadClock();
   HINSTANCE hInst = GetModuleHandle(0);
+  // the hook finds us through a window property, so that several instances can hook several windows
+  SetPropW(hWnd, L"SNIIS_Instance", (HANDLE) this);
   mPreviousWndProc = SetWindowLongPtrW(hWnd, GWLP_WNDPROC, (LONG_PTR) &WinInput::WndProcHook);
 
   // Create the device
@@ -67,13 +70,22 @@ WinInput::WinInput(HWND wnd)
 
   // default-add one keyboard and one mouse to act as a global collection of all events
   auto defMouse = new WinMouse{this, mDevices.size(), nullptr};
-  InputSystemHelper::AddDevice(defMouse);
+  InputSystemHelper::AddDevice(this, defMouse);
   auto defKeyboard = new WinKeyboard{this, mDevices.size(), nullptr, mKeyboard};
-  InputSystemHelper::AddDevice(defKeyboard);
+  InputSystemHelper::AddDevice(this, defKeyboard);
+  mStartupTimings.mConnect = ReadClock() - phaseStart;
 
+  // DirectInput enumeration collects the controllers, too, so that goes to the device enumeration
+  phaseStart = ReadClock();
   EnumerateDevices();
+  mStartupTimings.mDeviceEnumeration = ReadClock() - phaseStart;
+  phaseStart = ReadClock();
   CheckXInputDevices();
+  mStartupTimings.mControllerProbing = ReadClock() - phaseStart;
+  phaseStart = ReadClock();
   RegisterForRawInput();
+  mStartupTimings.mDeviceEnumeration += ReadClock() - phaseStart;
+  mStartupTimings.mTotal = ReadClock();
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -89,6 +101,7 @@ WinInput::~WinInput()
     mDirectInput->Release();
 
   SetWindowLongPtrW(hWnd, GWLP_WNDPROC, mPreviousWndProc);
+  RemovePropW(hWnd, L"SNIIS_Instance");
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -125,7 +138,7 @@ void WinInput::EnumerateDevices()
           InputSystem::Log("Mouse%zd: \"%s\", %d buttons, %d sample rate", mMice.size(), name.c_str(), info.mouse.dwNumberOfButtons,
                            info.mouse.dwSampleRate);
           auto m = new WinMouse(this, mDevices.size(), dev.hDevice);
-          InputSystemHelper::AddDevice(m);
+          InputSystemHelper::AddDevice(this, m);
           mMice[dev.hDevice] = m;
         } catch( std::exception& ) {
           // TODO: invent logging
@@ -135,7 +148,7 @@ void WinInput::EnumerateDevices()
         try {
           InputSystem::Log("Keyboard%zd: \"%s\", %d keys", mKeyboards.size(), name.c_str(), info.keyboard.dwNumberOfKeysTotal);
           auto k = new WinKeyboard(this, mDevices.size(), dev.hDevice, mKeyboard);
-          InputSystemHelper::AddDevice(k);
+          InputSystemHelper::AddDevice(this, k);
           mKeyboards[dev.hDevice] = k;
         } catch( std::exception& ) {
           // TODO: invent logging
@@ -163,7 +176,7 @@ int CALLBACK WinInput::_DIEnumDevCallback(LPCDIDEVICEINSTANCE lpddi, LPVOID pvRe
       dt == DI8DEVTYPE_FLIGHT ) {
     try {
       auto j = new WinJoystick(_this_, _this_->mDevices.size(), _this_->mDirectInput, lpddi->guidInstance, lpddi->guidProduct);
-      InputSystemHelper::AddDevice(j);
+      InputSystemHelper::AddDevice(_this_, j);
     } catch( std::exception& ) {
       // TODO: invent logging
     }
@@ -307,8 +320,6 @@ void WinInput::Update()
   for( auto d : mDevices ) {
     if( auto mouse = dynamic_cast<WinMouse*>(d) )
       mouse->StartUpdate();
-    else if( auto keyboard = dynamic_cast<WinKeyboard*>(d) )
-      keyboard->StartUpdate();
     else if( auto joy = dynamic_cast<WinJoystick*>(d) )
       joy->StartUpdate();
   }
@@ -337,7 +348,7 @@ void WinInput::Update()
     }
   }
 
-  // update postprocessing, currently mice only
+  // update postprocessing
   for( auto d : mDevices ) {
     if( auto mouse = dynamic_cast<WinMouse*>(d) )
       mouse->EndUpdate();
@@ -345,6 +356,9 @@ void WinInput::Update()
     // from now on everything generates signals
     d->ResetFirstUpdateFlag();
   }
+
+  // list all buttons which changed during this update
+  InputSystemHelper::FinishUpdate(this);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -361,6 +375,21 @@ void WinInput::InternSetFocus(bool pHasFocus)
   }
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+void WinInput::InternSetDeviceEnabled(Device* dev, bool enabled)
+{
+  // RawInput registration is per device class, not per device, so all we can do is release what the device holds.
+  // InputSystemHelper drops everything it sends afterwards.
+  if( enabled )
+    return;
+  if( auto k = dynamic_cast<WinKeyboard*>(dev) )
+    k->SetFocus(false);
+  else if( auto m = dynamic_cast<WinMouse*>(dev) )
+    m->SetFocus(false);
+  else if( auto j = dynamic_cast<WinJoystick*>(dev) )
+    j->SetFocus(false);
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 void WinInput::InternSetMouseGrab(bool enabled)
 {
@@ -381,7 +410,7 @@ void WinInput::InternSetMouseGrab(bool enabled)
 
 LRESULT CALLBACK WinInput::WndProcHook(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
 {
-  auto that = reinterpret_cast<WinInput*>(SNIIS::gInstance);
+  auto that = reinterpret_cast<WinInput*>(GetPropW(hwnd, L"SNIIS_Instance"));
   if( msg == WM_INPUT ) {
     uint8_t buf[256];
     UINT sz = sizeof(buf);
@@ -406,31 +435,19 @@ LRESULT CALLBACK WinInput::WndProcHook(HWND hwnd, UINT msg, WPARAM wparam, LPARA
 
 // --------------------------------------------------------------------------------------------------------------------
 // --------------------------------------------------------------------------------------------------------------------
-// Initializes the input system with the given InitArgs. When successful, gInstance is not Null.
-bool InputSystem::Initialize(void* pInitArg)
+// Creates an input system with the given InitArgs, or returns Null on error
+InputSystem* InputSystem::Create(void* pInitArg, const InitOptions& pOptions)
 {
-  if( gInstance )
-    throw std::runtime_error("Input already initialized");
-
+  // everything created from here on lives in the application's memory, if it asked for that
+  AllocatorScope scope(pOptions.mAllocator);
   try {
-    gInstance = new WinInput((HWND) pInitArg);
+    return new WinInput((HWND) pInitArg);
   } catch( std::exception& e ) {
     // nope
     if( gLogCallback )
       gLogCallback((std::string("Exception while creating SNIIS instance: ") + e.what()).c_str());
-    gInstance = nullptr;
-    return false;
+    return nullptr;
   }
-
-  return true;
-}
-
-// --------------------------------------------------------------------------------------------------------------------
-// Destroys the input system. After returning gInstance is Null again
-void InputSystem::Shutdown()
-{
-  delete gInstance;
-  gInstance = nullptr;
 }
 
 #endif // SNIIS_SYSTEM_WINDOWS
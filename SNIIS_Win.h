@@ -62,6 +62,7 @@ public:
 
   void InternSetFocus( bool pHasFocus) override;
   void InternSetMouseGrab( bool enabled) override;
+  void InternSetDeviceEnabled( SNIIS::Device* dev, bool enabled) override;
 
   HWND GetWindowHandle() const { return hWnd; }
   bool IsWorkAroundEnabled() const { return mIsWorkAroundEnabled; }
@@ -75,9 +76,7 @@ class WinMouse : public SNIIS::Mouse
   HANDLE mHandle;
   struct State 
   {
-    float absX, absY, relX, relY;
-    float wheel, prevWheel;
-    uint32_t buttons, prevButtons;
+    float relX, relY; ///< movement since last update; differs from the change of the position when grabbed
   } mState;
   bool mIsInUpdate;
   float mOutOfUpdateRelX, mOutOfUpdateRelY;
@@ -94,10 +93,6 @@ public:
   std::string GetButtonText( size_t idx) const override;
   size_t GetNumAxes() const override;
   std::string GetAxisText( size_t idx) const override;
-  bool IsButtonDown( size_t idx) const override;
-  bool WasButtonPressed( size_t idx) const override;
-  bool WasButtonReleased( size_t idx) const override;
-  float GetAxisAbsolute( size_t idx) const override;
   float GetAxisDifference( size_t idx) const override;
   float GetMouseX() const override;
   float GetMouseY() const override;
@@ -117,26 +112,18 @@ class WinKeyboard : public SNIIS::Keyboard
   WinInput* mSystem;
   HANDLE mHandle;
 	IDirectInputDevice8* mKeyboard; ///< for retrieving the names of keys
-	uint64_t mState[NumKeys/64], mPrevState[NumKeys/64]; ///< current and previous keystate
 	WCHAR deadKey; ///< Stored dead key from last translation
 
 public:
   WinKeyboard( WinInput* pSystem, size_t pId, HANDLE pHandle, IDirectInputDevice8* pDirectInputKeyboard);
 
-  void StartUpdate();
   void ParseMessage( const RAWINPUT& e, bool useWorkaround);
   void SetFocus( bool pHasFocus);
 
   size_t GetNumButtons() const override;
   std::string GetButtonText( size_t idx) const override;
-  bool IsButtonDown( size_t idx) const override;
-  bool WasButtonPressed( size_t idx) const override;
-  bool WasButtonReleased( size_t idx) const override;
 protected:
   void DoKeyboardButton( SNIIS::KeyCode kc, size_t unicode, bool isPressed);
-  void Set( size_t kc, bool set);
-  bool IsSet( size_t kc) const;
-  bool WasSet( size_t kc) const;
   size_t TranslateText( uint32_t kc);
 };
 
@@ -151,10 +138,6 @@ class WinJoystick : public SNIIS::Joystick
   GUID mGuidInstance, mGuidProduct;
   size_t mXInputPadIndex;
   size_t mNumButtons, mNumAxes;
-  struct State {
-    uint64_t buttons, prevButtons;
-    float axes[16], diffs[16];
-  } mState;
   size_t mEnumAxis;
 
 public:
@@ -171,12 +154,6 @@ public:
   std::string GetButtonText( size_t idx) const override;
   size_t GetNumAxes() const override;
   std::string GetAxisText( size_t idx) const override;
-
-  bool IsButtonDown( size_t idx) const override;
-  bool WasButtonPressed( size_t idx) const override;
-  bool WasButtonReleased( size_t idx) const override;
-  float GetAxisAbsolute( size_t idx) const override;
-  float GetAxisDifference( size_t idx) const override;
 protected:
 	static int CALLBACK DIEnumDeviceObjectsCallback(LPCDIDEVICEOBJECTINSTANCE lpddoi, LPVOID pvRef);
 };
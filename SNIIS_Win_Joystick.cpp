@@ -21,7 +21,6 @@ WinJoystick::WinJoystick( WinInput* pSystem, size_t pId, IDirectInput8* pDI, GUI
 {
   mXInputPadIndex = SIZE_MAX;
   mNumButtons = mNumAxes = 0;
-  memset( &mState, 0, sizeof( mState));
 
   DIPROPDWORD dipdw;
   dipdw.diph.dwSize       = sizeof(DIPROPDWORD);
@@ -60,12 +59,6 @@ WinJoystick::WinJoystick( WinInput* pSystem, size_t pId, IDirectInput8* pDI, GUI
 // --------------------------------------------------------------------------------------------------------------------
 void WinJoystick::StartUpdate()
 {
-  mState.prevButtons = mState.buttons;
-  memset( mState.diffs, 0, sizeof( mState.diffs));
-  float prevAxes[16];
-  static_assert( sizeof( prevAxes) == sizeof( mState.axes), "Hardcoded array size");
-  memcpy( prevAxes, mState.axes, sizeof( mState.axes));
-
   if( mSystem->HasFocus() )
   {
     // handle xbox controller differently
@@ -77,30 +70,30 @@ void WinJoystick::StartUpdate()
         memset(&inputState, 0, sizeof(inputState));
 
       //Sticks and triggers
-      mState.axes[0] = std::max( -1.0f, float( inputState.Gamepad.sThumbLX) / 32767.0f);
-      mState.axes[1] = std::max( -1.0f, float( -inputState.Gamepad.sThumbLY) / 32767.0f);
-      mState.axes[2] = std::max( -1.0f, float( inputState.Gamepad.bLeftTrigger) / 127.0f);
-      mState.axes[3] = std::max( -1.0f, float( inputState.Gamepad.sThumbRX) / 32767.0f);
-      mState.axes[4] = std::max( -1.0f, float( -inputState.Gamepad.sThumbRY) / 32767.0f);
-      mState.axes[5] = std::max( -1.0f, float( inputState.Gamepad.bRightTrigger) / 127.0f);
-      mState.axes[6] = ((inputState.Gamepad.wButtons & XINPUT_GAMEPAD_DPAD_LEFT) ? -1.0f : 0.0f)
-          + ((inputState.Gamepad.wButtons & XINPUT_GAMEPAD_DPAD_RIGHT) ? 1.0f : 0.0f);
-      mState.axes[7] = ((inputState.Gamepad.wButtons & XINPUT_GAMEPAD_DPAD_UP) ? -1.0f : 0.0f)
-          + ((inputState.Gamepad.wButtons & XINPUT_GAMEPAD_DPAD_DOWN) ? 1.0f : 0.0f);
+      SetAxisValue( 0, std::max( -1.0f, float( inputState.Gamepad.sThumbLX) / 32767.0f));
+      SetAxisValue( 1, std::max( -1.0f, float( -inputState.Gamepad.sThumbLY) / 32767.0f));
+      SetAxisValue( 2, std::max( -1.0f, float( inputState.Gamepad.bLeftTrigger) / 127.0f));
+      SetAxisValue( 3, std::max( -1.0f, float( inputState.Gamepad.sThumbRX) / 32767.0f));
+      SetAxisValue( 4, std::max( -1.0f, float( -inputState.Gamepad.sThumbRY) / 32767.0f));
+      SetAxisValue( 5, std::max( -1.0f, float( inputState.Gamepad.bRightTrigger) / 127.0f));
+      SetAxisValue( 6, ((inputState.Gamepad.wButtons & XINPUT_GAMEPAD_DPAD_LEFT) ? -1.0f : 0.0f)
+          + ((inputState.Gamepad.wButtons & XINPUT_GAMEPAD_DPAD_RIGHT) ? 1.0f : 0.0f));
+      SetAxisValue( 7, ((inputState.Gamepad.wButtons & XINPUT_GAMEPAD_DPAD_UP) ? -1.0f : 0.0f)
+          + ((inputState.Gamepad.wButtons & XINPUT_GAMEPAD_DPAD_DOWN) ? 1.0f : 0.0f));
 
       // Buttons, except the lowest four which are the DPad - we map those to axis 6 and 7 to
       // match the axes reported by the USB interface
-      mState.buttons = (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_A) ? 0x0001 : 0;
-      mState.buttons |= (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_B) ? 0x0002 : 0;
-      mState.buttons |= (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_X) ? 0x0004 : 0;
-      mState.buttons |= (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_Y) ? 0x0008 : 0;
-      mState.buttons |= (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_LEFT_SHOULDER) ? 0x0010 : 0;
-      mState.buttons |= (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_RIGHT_SHOULDER) ? 0x0020 : 0;
-      mState.buttons |= (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_START) ? 0x0040 : 0;
-      mState.buttons |= (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_BACK) ? 0x0080 : 0;
-      //	mState.buttons |= (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_DAT_CENTER_THINGY) ? 0x0100 : 0;
-      mState.buttons |= (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_LEFT_THUMB) ? 0x0200 : 0;
-      mState.buttons |= (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_RIGHT_THUMB) ? 0x0400 : 0;
+      SetButtonBit( 0, (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_A) != 0);
+      SetButtonBit( 1, (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_B) != 0);
+      SetButtonBit( 2, (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_X) != 0);
+      SetButtonBit( 3, (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_Y) != 0);
+      SetButtonBit( 4, (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_LEFT_SHOULDER) != 0);
+      SetButtonBit( 5, (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_RIGHT_SHOULDER) != 0);
+      SetButtonBit( 6, (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_START) != 0);
+      SetButtonBit( 7, (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_BACK) != 0);
+      //	SetButtonBit( 8, (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_DAT_CENTER_THINGY) != 0);
+      SetButtonBit( 9, (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_LEFT_THUMB) != 0);
+      SetButtonBit( 10, (inputState.Gamepad.wButtons & XINPUT_GAMEPAD_RIGHT_THUMB) != 0);
     }
     else
     {
@@ -126,7 +119,10 @@ void WinJoystick::StartUpdate()
         if( FAILED(hr) )
         {
           entries = 0;
-          memset( &mState, 0, sizeof( mState));
+          for( size_t a = 0; a < mNumButtons; ++a )
+            SetButtonBit( a, false);
+          for( size_t a = 0; a < mNumAxes; ++a )
+            SetAxisValue( a, 0.0f);
         }
       }
 
@@ -146,14 +142,14 @@ void WinJoystick::StartUpdate()
             if( diBuff[i].dwOfs >= DIJOFS_BUTTON(0) && diBuff[i].dwOfs < DIJOFS_BUTTON(128) )
             {
               size_t btnidx = (diBuff[i].dwOfs - DIJOFS_BUTTON(0));
-              mState.buttons = (mState.buttons & (UINT64_MAX ^ (1ull << btnidx))) | (uint64_t((diBuff[i].dwData >> 7) & 1) << btnidx);
+              SetButtonBit( btnidx, ((diBuff[i].dwData >> 7) & 1) != 0);
             }
             else if( ((diBuff[i].uAppData >> 16)&0xffff) == 0x1313 )
             {
               // if it was nothing else, might be axis enumerated earlier (determined by magic number)
               size_t axis = (0x0000FFFF & diBuff[i].uAppData);
               if( axis < mNumAxes )
-                mState.axes[axis] = float( diBuff[i].dwData + MIN_AXIS) / float( MAX_AXIS - MIN_AXIS);
+                SetAxisValue( axis, float( diBuff[i].dwData + MIN_AXIS) / float( MAX_AXIS - MIN_AXIS));
             }
 
             break;
@@ -165,20 +161,16 @@ void WinJoystick::StartUpdate()
   // send events - Axes
   for( size_t i = 0; i < mNumAxes; i++ )
   {
-    if( mState.axes[i] != prevAxes[i] )
-    {
-      mState.diffs[i] = mState.axes[i] - prevAxes[i];
-      if( !mIsFirstUpdate )
-        InputSystemHelper::DoJoystickAxis( this, i, mState.axes[i]);
-    }
+    if( GetAxisValue( i) != GetPrevAxisValue( i) && !mIsFirstUpdate )
+      InputSystemHelper::DoJoystickAxis( this, i, GetAxisValue( i));
   }
 
   // send events - buttons
   for( size_t i = 0; i < mNumButtons; i++ )
   {
-    if( (mState.buttons ^ mState.prevButtons) & (1ull << i) )
+    if( IsButtonBitSet( i) != WasButtonBitSet( i) )
       if( !mIsFirstUpdate )
-        InputSystemHelper::DoJoystickButton( this, i, (mState.buttons & (1ull << i)) != 0);
+        InputSystemHelper::DoJoystickButton( this, i, IsButtonBitSet( i));
   }
 }
 
@@ -194,20 +186,19 @@ void WinJoystick::SetFocus( bool pHasFocus)
     // zero all buttons and axes
     for( size_t a = 0; a < mNumAxes; ++a )
     {
-      if( mState.axes[a] != 0.0f )
+      if( GetAxisValue( a) != 0.0f )
       {
-        mState.diffs[a] = -mState.axes[a];
-        mState.axes[a] = 0.0f;
+        SetAxisValue( a, 0.0f);
         InputSystemHelper::DoJoystickAxis( this, a, 0.0f);
       }
     }
 
     for( size_t a = 0; a < mNumButtons; ++a )
     {
-      if( mState.buttons & (1ull << a) )
+      if( IsButtonBitSet( a) )
       {
-        mState.buttons &= UINT64_MAX ^ (1ull << a);
-        mState.prevButtons |= 1ull << a;
+        SetButtonBit( a, false);
+        SetPrevButtonBit( a, true);
         InputSystemHelper::DoJoystickButton( this, a, false);
       }
     }
@@ -220,6 +211,9 @@ void WinJoystick::SetXInput( size_t pXIndex)
   mXInputPadIndex = pXIndex;
   mNumButtons = XINPUT_TRANSLATED_BUTTON_COUNT;
   mNumAxes = XINPUT_TRANSLATED_AXIS_COUNT;
+  // our controls changed, so our part of the state arena has to change, too
+  if( mOwner )
+    InputSystemHelper::LayoutStateArena( mOwner);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -279,45 +273,4 @@ std::string WinJoystick::GetAxisText( size_t idx) const
   return "";
 }
 
-// --------------------------------------------------------------------------------------------------------------------
-bool WinJoystick::IsButtonDown( size_t idx) const
-{
-  if( idx < mNumButtons )
-    return (mState.buttons & (1ull << idx)) != 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool WinJoystick::WasButtonPressed( size_t idx) const
-{
-  if( idx < mNumButtons )
-    return IsButtonDown( idx) && ((mState.prevButtons & (1ull << idx)) == 0);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool WinJoystick::WasButtonReleased( size_t idx) const
-{
-  if( idx < mNumButtons )
-    return !IsButtonDown( idx) && ((mState.prevButtons & (1ull << idx)) != 0);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-float WinJoystick::GetAxisAbsolute( size_t idx) const
-{
-  if( idx < mNumAxes )
-    return mState.axes[idx];
-  else
-    return 0.0f;
-}
-// --------------------------------------------------------------------------------------------------------------------
-float WinJoystick::GetAxisDifference( size_t idx) const
-{
-  if( idx < mNumAxes )
-    return mState.diffs[idx];
-  else
-    return 0.0f;
-}
-
 #endif // SNIIS_SYSTEM_WINDOWS
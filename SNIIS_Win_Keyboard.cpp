@@ -11,17 +11,9 @@ using namespace SNIIS;
 WinKeyboard::WinKeyboard( WinInput* pSystem, size_t pId, HANDLE pHandle, IDirectInputDevice8* pDirectInputKeyboard)
   : Keyboard( pId, !pHandle), mSystem( pSystem), mHandle( pHandle), mKeyboard( pDirectInputKeyboard)
 {
-  memset( mState, 0, sizeof( mState));
-  memset( mPrevState, 0, sizeof( mPrevState));
   deadKey = 0;
 }
 
-// --------------------------------------------------------------------------------------------------------------------
-void WinKeyboard::StartUpdate()
-{
-  memcpy( mPrevState, mState, sizeof( mState));
-}
-
 void WinKeyboard::ParseMessage( const RAWINPUT& e, bool useWorkaround)
 {
   // safety measure - should not reach us if it's not for us
@@ -112,10 +104,10 @@ void WinKeyboard::SetFocus( bool pHasFocus)
   {
     for( size_t a = 0; a < NumKeys; ++a )
     {
-      if( IsSet( a) )
+      if( IsButtonBitSet( a) )
       {
         DoKeyboardButton( (SNIIS::KeyCode) a, 0, false);
-        mPrevState[a / 64] |= (1ull << (a & 63));
+        SetPrevButtonBit( a, true);
       }
     }
   }
@@ -133,9 +125,9 @@ void WinKeyboard::DoKeyboardButton( SNIIS::KeyCode kc, size_t unicode, bool isPr
     return;
 
   // don't signal if it isn't an actual state change
-  if( IsSet(kc) == isPressed )
-    return;
-  Set( kc, isPressed);
+  if( IsButtonBitSet( kc) == isPressed )
+    return;
+  SetButtonBit( kc, isPressed);
 
   InputSystemHelper::DoKeyboardButton( this, kc, unicode, isPressed);
 }
@@ -194,22 +186,6 @@ size_t WinKeyboard::TranslateText( uint32_t kc)
 	return 0;
 }
 
-void WinKeyboard::Set( size_t kc, bool set)
-{
-  if( set )
-    mState[kc/64] |= (1ull << (kc&63));
-  else
-    mState[kc/64] &= UINT64_MAX ^ (1ull << (kc&63));
-}
-bool WinKeyboard::IsSet( size_t kc) const
-{
-  return (mState[kc/64] & (1ull << (kc&63))) != 0;
-}
-bool WinKeyboard::WasSet( size_t kc) const
-{
-  return (mPrevState[kc/64] & (1ull << (kc&63))) != 0;
-}
-
 // --------------------------------------------------------------------------------------------------------------------
 size_t WinKeyboard::GetNumButtons() const
 {
@@ -235,29 +211,4 @@ std::string WinKeyboard::GetButtonText( size_t idx) const
   return std::string( &temp[0]);
 }
 
-// --------------------------------------------------------------------------------------------------------------------
-bool WinKeyboard::IsButtonDown( size_t idx) const
-{
-  if( idx < NumKeys)
-    return IsSet( idx);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool WinKeyboard::WasButtonPressed( size_t idx) const
-{
-  if( idx < NumKeys )
-    return IsSet( idx) && !WasSet( idx);
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool WinKeyboard::WasButtonReleased( size_t idx) const
-{
-  if( idx < NumKeys )
-    return !IsSet( idx) && WasSet( idx);
-  else
-    return false;
-}
-
 #endif // SNIIS_SYSTEM_WINDOWS
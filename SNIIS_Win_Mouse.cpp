@@ -11,18 +11,9 @@ using namespace SNIIS;
 WinMouse::WinMouse( WinInput* pSystem, size_t pId, HANDLE pHandle)
   : Mouse( pId, pHandle == nullptr), mSystem( pSystem), mHandle( pHandle)
 {
-  mState.absX = mState.absY = 0.0f;
   mState.relX = mState.relY = 0.0f;
-  mState.wheel = mState.prevWheel = 0.0f;
-  mState.buttons = mState.prevButtons = 0;
   mIsInUpdate = false;
   mOutOfUpdateRelX = mOutOfUpdateRelY = 0;
-
-  // read initial position
-  POINT point;
-  GetCursorPos(&point);
-  ScreenToClient( mSystem->GetWindowHandle(), &point);
-  mState.absX = float( point.x); mState.absY = float( point.y);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -34,11 +25,19 @@ void WinMouse::StartUpdate()
   // So in order to collect and broadcast those messages, too, we reset the state in EndUpdate() and thus carry any
   // lost RawInput messages over to the Update() of next frame.
 
+  // read initial position. Our state only exists after the device was added to the system, so do it here
+  if( mIsFirstUpdate )
+  {
+    POINT point;
+    GetCursorPos(&point);
+    ScreenToClient( mSystem->GetWindowHandle(), &point);
+    SetAxisValue( 0, float( point.x)); SetAxisValue( 1, float( point.y));
+  }
+
   // except for the buttons and wheel, because that is calculated and broadcasted immediatly
-  mState.prevButtons = mState.buttons;
-  mState.prevWheel = mState.wheel; mState.wheel = 0;
+  SetAxisValue( 2, 0.0f);
   // that plops back the wheel to zero. Broadcast this as well
-  if( mState.prevWheel != 0 )
+  if( GetPrevAxisValue( 2) != 0 )
     DoMouseWheel( 0.0f);
 
   // take over the OutOfUpdate differences
@@ -82,18 +81,18 @@ void WinMouse::ParseMessage( const RAWINPUT& e, bool useWorkaround)
   {
     if( mouse.lLastX != 0 || mouse.lLastY != 0 )
     {
-      relx += float( mouse.lLastX); mState.absX += float( mouse.lLastX);
-      rely += float( mouse.lLastY); mState.absY += float( mouse.lLastY);
+      relx += float( mouse.lLastX); SetAxisValue( 0, GetAxisValue( 0) + float( mouse.lLastX));
+      rely += float( mouse.lLastY); SetAxisValue( 1, GetAxisValue( 1) + float( mouse.lLastY));
     }
   }
   else
   {
-    float preX = mState.absX, preY = mState.absY;
-    if( mState.absX != float( mouse.lLastX) || mState.absY != float( mouse.lLastY) )
+    float preX = GetAxisValue( 0), preY = GetAxisValue( 1);
+    if( preX != float( mouse.lLastX) || preY != float( mouse.lLastY) )
     {
-      mState.absX = float( mouse.lLastX); mState.absY = float( mouse.lLastY);
-      relx += mState.absX - preX;
-      rely += mState.absY - preY;
+      SetAxisValue( 0, float( mouse.lLastX)); SetAxisValue( 1, float( mouse.lLastY));
+      relx += float( mouse.lLastX) - preX;
+      rely += float( mouse.lLastY) - preY;
     }
   }
 }
@@ -118,23 +117,23 @@ void WinMouse::EndUpdate()
       POINT wndCenterPos = { (rect.right - rect.left) / 2, (rect.bottom - rect.top) / 2 };
       mState.relX = float( currMousePos.x - wndCenterPos.x);
       mState.relY = float( currMousePos.y - wndCenterPos.y);
-      mState.absX += mState.relX; mState.absY += mState.relY;
+      SetAxisValue( 0, GetAxisValue( 0) + mState.relX); SetAxisValue( 1, GetAxisValue( 1) + mState.relY);
       ClientToScreen( mSystem->GetWindowHandle(), &wndCenterPos);
       SetCursorPos( wndCenterPos.x, wndCenterPos.y);
     } else
     {
       // single mouse mode without grabbing: we're not allowed to lock the mouse like this, so we simply mirror the
       // global mouse movement to get expected mouse acceleration and such at least.
-      float prevAbsX = mState.absX, prevAbsY = mState.absY;
-      mState.absX = float( currMousePos.x); mState.absY = float( currMousePos.y);
-      mState.relX = mState.absX - prevAbsX;
-      mState.relY = mState.absY - prevAbsY;
+      float prevAbsX = GetAxisValue( 0), prevAbsY = GetAxisValue( 1);
+      SetAxisValue( 0, float( currMousePos.x)); SetAxisValue( 1, float( currMousePos.y));
+      mState.relX = GetAxisValue( 0) - prevAbsX;
+      mState.relY = GetAxisValue( 1) - prevAbsY;
     }
   }
 
   // send the mouse move
   if( mState.relX != 0 || mState.relY != 0 )
-    InputSystemHelper::DoMouseMove( this, mState.absX, mState.absY, mState.relX, mState.relY);
+    InputSystemHelper::DoMouseMove( this, GetAxisValue( 0), GetAxisValue( 1), mState.relX, mState.relY);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -145,7 +144,7 @@ void WinMouse::DoMouseWheel( float wheel)
     dynamic_cast<WinMouse*> (mSystem->GetMouseByCount(0))->DoMouseWheel( wheel);
 
   // store change
-  mState.wheel += wheel;
+  SetAxisValue( 2, GetAxisValue( 2) + wheel);
   InputSystemHelper::DoMouseWheel( this, wheel);
 }
 
@@ -158,12 +157,11 @@ void WinMouse::DoMouseButton(size_t btnIndex, bool isPressed)
     dynamic_cast<WinMouse*>(mSystem->GetMouseByCount(0))->DoMouseButton(btnIndex, isPressed);
 
   // don't signal if it isn't an actual state change
-  if (!!(mState.buttons & (1u << btnIndex)) == isPressed)
+  if( IsButtonBitSet( btnIndex) == isPressed )
     return;
 
   // store state change
-  uint32_t bitmask = (1 << btnIndex);
-  mState.buttons = (mState.buttons & ~bitmask) | (isPressed ? bitmask : 0);
+  SetButtonBit( btnIndex, isPressed);
 
   // and notify everyone interested
   InputSystemHelper::DoMouseButton(this, btnIndex, isPressed);
@@ -180,23 +178,23 @@ void WinMouse::SetFocus( bool pHasFocus)
       POINT point;
       GetCursorPos(&point);
       ScreenToClient( mSystem->GetWindowHandle(), &point);
-      float prevAbsX = mState.absX, prevAbsY = mState.absY;
-      mState.absX = float( point.x); mState.absY = float( point.y);
-      mState.relX = mState.absX - prevAbsX;
-      mState.relY = mState.absY - prevAbsY;
+      float prevAbsX = GetAxisValue( 0), prevAbsY = GetAxisValue( 1);
+      SetAxisValue( 0, float( point.x)); SetAxisValue( 1, float( point.y));
+      mState.relX = GetAxisValue( 0) - prevAbsX;
+      mState.relY = GetAxisValue( 1) - prevAbsY;
       if( !mIsFirstUpdate )
         if( mState.relX != 0 || mState.relY != 0 )
-          InputSystemHelper::DoMouseMove( this, mState.absX, mState.absY, mState.relX, mState.relY);
+          InputSystemHelper::DoMouseMove( this, GetAxisValue( 0), GetAxisValue( 1), mState.relX, mState.relY);
     }
   }
   else
   {
     for( size_t a = 0; a < MB_Count; ++a )
     {
-      if( mState.buttons & (1 << a) )
+      if( IsButtonBitSet( a) )
       {
         DoMouseButton( a, false);
-        mState.prevButtons |= (1 << a);
+        SetPrevButtonBit( a, true);
       }
     }
   }
@@ -223,55 +221,19 @@ std::string WinMouse::GetAxisText( size_t idx) const
   return "";
 }
 // --------------------------------------------------------------------------------------------------------------------
-bool WinMouse::IsButtonDown( size_t idx) const
-{
-  if( idx < MB_Count )
-    return (mState.buttons & (1 << idx)) != 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool WinMouse::WasButtonPressed( size_t idx) const
-{
-  if( idx < MB_Count )
-    return IsButtonDown( idx) && (mState.prevButtons & (1 << idx)) == 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-bool WinMouse::WasButtonReleased( size_t idx) const
-{
-  if( idx < MB_Count )
-    return !IsButtonDown( idx) && (mState.prevButtons & (1 << idx)) != 0;
-  else
-    return false;
-}
-// --------------------------------------------------------------------------------------------------------------------
-float WinMouse::GetAxisAbsolute( size_t idx) const
-{
-  switch( idx )
-  {
-    case 0: return float( mState.absX);
-    case 1: return float( mState.absY);
-    case 2: return float( mState.wheel); 
-    default: return 0.0f;
-  }
-}
-// --------------------------------------------------------------------------------------------------------------------
 float WinMouse::GetAxisDifference( size_t idx) const
 {
   switch( idx )
   {
     case 0: return float( mState.relX);
     case 1: return float( mState.relY);
-    case 2: return float( mState.wheel - mState.prevWheel);
-    default: return 0.0f;
+    default: return Mouse::GetAxisDifference( idx);
   }
 }
 // --------------------------------------------------------------------------------------------------------------------
-float WinMouse::GetMouseX() const { return mState.absX; }
+float WinMouse::GetMouseX() const { return GetAxisValue( 0); }
 // --------------------------------------------------------------------------------------------------------------------
-float WinMouse::GetMouseY() const { return mState.absY; }
+float WinMouse::GetMouseY() const { return GetAxisValue( 1); }
 // --------------------------------------------------------------------------------------------------------------------
 float WinMouse::GetRelMouseX() const { return mState.relX; }
 // --------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,46 @@
+# SNIIS sources, shared by the library and by the test and benchmark programs which build them in directly
+
+SOURCES += \
+    $$PWD/SNIIS_C.cpp \
+    $$PWD/SNIIS_Intern.cpp \
+    $$PWD/SNIIS_Win.cpp \
+    $$PWD/SNIIS_Win_Joystick.cpp \
+    $$PWD/SNIIS_Win_Keyboard.cpp \
+    $$PWD/SNIIS_Win_Mouse.cpp \
+    $$PWD/SNIIS_Linux.cpp \
+    $$PWD/SNIIS_Linux_Mouse.cpp \
+    $$PWD/SNIIS_Linux_Keyboard.cpp \
+    $$PWD/SNIIS_Linux_Joystick.cpp \
+    $$PWD/SNIIS_Mac.cpp \
+    $$PWD/SNIIS_Mac_Mouse.cpp \
+    $$PWD/SNIIS_Mac_Keyboard.cpp \
+    $$PWD/SNIIS_Mac_Joystick.cpp \
+    $$PWD/SNIIS_Virtual.cpp \
+    $$PWD/SNIIS_Record.cpp \
+    $$PWD/SNIIS_Trace.cpp
+
+HEADERS += \
+    $$PWD/SNIIS.h \
+    $$PWD/SNIIS_C.h \
+    $$PWD/SNIIS_Intern.h \
+    $$PWD/SNIIS_Linux.h \
+    $$PWD/SNIIS_Win.h \
+    $$PWD/SNIIS_Mac.h \
+    $$PWD/SNIIS_Mac_Helper.h \
+    $$PWD/SNIIS_Virtual.h \
+    $$PWD/SNIIS_Record.h \
+    $$PWD/SNIIS_Trace.h
+
+INCLUDEPATH += $$PWD
+
+macx {
+  OBJECTIVE_SOURCES += \
+    $$PWD/SNIIS_Mac_Helper.m
+}
+
+# programs linking the sources need the OS libraries as well
+!contains( TEMPLATE, lib ) {
+  unix:!macx: LIBS += -lX11 -lXi
+  macx: LIBS += -framework IOKit -framework CoreFoundation -framework Carbon -framework Cocoa
+  win32: LIBS += -ldinput8 -ldxguid -lole32 -loleaut32 -lwbemuuid -luser32
+}
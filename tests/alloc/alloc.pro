@@ -0,0 +1,10 @@
+# Checks that Update() doesn't allocate once warmed up. Run it with "make check".
+
+TEMPLATE = app
+CONFIG += console c++14 testcase
+CONFIG -= app_bundle qt
+TARGET = sniis_alloc
+
+include(../../sniis.pri)
+
+SOURCES += sniis_alloc.cpp
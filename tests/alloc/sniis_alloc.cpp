@@ -0,0 +1,246 @@
+/// @file sniis_alloc.cpp
+/// Allocation test of the update path: after a warm-up, Update() with input, handlers, channels, the event queue,
+/// frame readers and stats must not allocate anything. Counts both the global operator new, which catches the standard
+/// library and anything else outside SNIIS, and an Allocator handed to SNIIS, which catches SNIIS' own containers.
+/// On Linux a LinuxJoystick reading evdev reports from a pipe takes part as well, so the controller parser is covered.
+/// Prints the counts and fails if any allocation happened.
+
+#include "SNIIS.h"
+#include "SNIIS_Virtual.h"
+#if SNIIS_SYSTEM_LINUX
+#include "SNIIS_Linux.h"
+#include "SNIIS_Intern.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace SNIIS;
+
+namespace
+{
+/// Allocations through the global operator new while counting is on
+size_t gNumNews = 0, gNumDeletes = 0;
+bool gIsCounting = false;
+
+void* CountedNew( size_t size)
+{
+  if( gIsCounting )
+    ++gNumNews;
+  if( void* ptr = std::malloc( size > 0 ? size : 1) )
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void CountedDelete( void* ptr) noexcept
+{
+  if( ptr && gIsCounting )
+    ++gNumDeletes;
+  std::free( ptr);
+}
+} // namespace
+
+void* operator new( size_t size) { return CountedNew( size); }
+void* operator new[]( size_t size) { return CountedNew( size); }
+void* operator new( size_t size, const std::nothrow_t&) noexcept { try { return CountedNew( size); } catch( ... ) { return nullptr; } }
+void* operator new[]( size_t size, const std::nothrow_t&) noexcept { try { return CountedNew( size); } catch( ... ) { return nullptr; } }
+void operator delete( void* ptr) noexcept { CountedDelete( ptr); }
+void operator delete[]( void* ptr) noexcept { CountedDelete( ptr); }
+void operator delete( void* ptr, size_t) noexcept { CountedDelete( ptr); }
+void operator delete[]( void* ptr, size_t) noexcept { CountedDelete( ptr); }
+void operator delete( void* ptr, const std::nothrow_t&) noexcept { CountedDelete( ptr); }
+void operator delete[]( void* ptr, const std::nothrow_t&) noexcept { CountedDelete( ptr); }
+
+namespace
+{
+/// Hands SNIIS heap memory and counts what it asks for while counting is on
+class CountingAllocator : public Allocator
+{
+public:
+  size_t mNumAllocs = 0, mNumFrees = 0;
+
+  void* Allocate( size_t size, size_t) override
+  {
+    if( gIsCounting )
+      ++mNumAllocs;
+    return std::malloc( size > 0 ? size : 1);
+  }
+  void Free( void* ptr, size_t) noexcept override
+  {
+    if( gIsCounting )
+      ++mNumFrees;
+    std::free( ptr);
+  }
+};
+
+/// Lets everything through to the channels, and does a bit of work so it's not optimised away
+struct Handler : public InputHandler
+{
+  size_t mCalls = 0;
+  bool OnKey( Keyboard*, SNIIS::KeyCode, bool) override { ++mCalls; return false; }
+  bool OnMouseMoved( Mouse*, float, float) override { ++mCalls; return false; }
+  bool OnMouseButton( Mouse*, size_t, bool) override { ++mCalls; return false; }
+  bool OnMouseWheel( Mouse*, float) override { ++mCalls; return false; }
+  bool OnJoystickButton( Joystick*, size_t, bool) override { ++mCalls; return false; }
+  bool OnJoystickAxis( Joystick*, size_t, float) override { ++mCalls; return false; }
+  bool OnUnicode( Keyboard*, size_t) override { ++mCalls; return false; }
+  void OnDigitalChannel( const DigitalChannel&) override { ++mCalls; }
+  void OnAnalogChannel( const AnalogChannel&) override { ++mCalls; }
+  void OnInputDropped( Device*) override { ++mCalls; }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Feeds the input of one frame. Over 500 frames every kind of input comes along: typing, a held key repeating, mouse
+// movement, clicks and wheel, controller sticks and buttons, a controller being disabled and enabled, lost input and
+// losing focus.
+void FeedFrame( VirtualInput* sys, size_t frame, VirtualMouse* m, VirtualKeyboard* kb, VirtualJoystick* j)
+{
+  size_t f = frame % 500;
+  m->Move( float( f % 7) - 3.0f, float( f % 5) - 2.0f);
+  if( f % 3 == 0 )
+    m->Move( 1.0f, -1.0f);
+  if( f % 20 == 0 || f % 20 == 2 )
+    m->SetButton( MB_Left, f % 20 == 0);
+  if( f % 9 == 0 )
+    m->Wheel( 1.0f);
+
+  if( f < 200 && f % 2 == 0 )
+    kb->SetKey( SNIIS::KeyCode( KC_A + (f / 2) % 20), f % 4 == 0, f % 4 == 0 ? 'a' + (f / 2) % 20 : 0);
+  if( f == 250 || f == 400 )
+    kb->SetKey( KC_SPACE, f == 250, ' ');
+
+  j->SetAxis( f % 4, float( int( f % 64) - 32) / 32.0f);
+  if( f % 5 == 0 )
+    j->SetButton( (f / 5) % 8, (f / 40) % 2 == 0);
+  if( f == 300 )
+    sys->SetDeviceEnabled( j, false);
+  if( f == 320 )
+    sys->SetDeviceEnabled( j, true);
+  if( f == 330 )
+    sys->DropInput( j);
+
+  if( f == 450 )
+    sys->SetFocus( false);
+  if( f == 460 )
+    sys->SetFocus( true);
+}
+
+#if SNIIS_SYSTEM_LINUX
+// --------------------------------------------------------------------------------------------------------------------
+// Writes the evdev reports of one frame for the LinuxJoystick: a stick moving, a button now and then, and a report
+// lost to an overflow once per round. The events live on the stack, the pipe must not be what allocates.
+void FeedController( int fd, size_t frame)
+{
+  size_t f = frame % 500;
+  input_event evs[8];
+  size_t num = 0;
+  memset( evs, 0, sizeof( evs));
+  auto add = [&]( uint16_t type, uint16_t code, int32_t value)
+  {
+    evs[num].type = type; evs[num].code = code; evs[num].value = value;
+    ++num;
+  };
+  if( f == 200 )
+    add( EV_SYN, SYN_DROPPED, 0);
+  add( EV_ABS, ABS_X, int32_t( (f * 397) % 65536) - 32768);
+  add( EV_ABS, ABS_Y, int32_t( (f * 211) % 65536) - 32768);
+  if( f % 4 == 0 )
+    add( EV_KEY, BTN_SOUTH, int32_t( (f / 4) & 1));
+  add( EV_SYN, SYN_REPORT, 0);
+  if( write( fd, evs, num * sizeof( input_event)) != ssize_t( num * sizeof( input_event)) )
+    fprintf( stderr, "writing the controller reports failed\n");
+}
+#endif // SNIIS_SYSTEM_LINUX
+} // namespace
+
+// --------------------------------------------------------------------------------------------------------------------
+int main()
+{
+  const size_t NumWarmupFrames = 1000, NumFrames = 10000;
+
+  CountingAllocator allocator;
+  InitOptions options;
+  options.mAllocator = &allocator;
+  auto sys = VirtualInput::Create( options);
+  sys->SetTime( 0);
+  auto m = sys->AddMouse();
+  auto kb = sys->AddKeyboard();
+  auto j = sys->AddJoystick( 16, 6);
+
+#if SNIIS_SYSTEM_LINUX
+  int fds[2];
+  if( pipe( fds) != 0 )
+  {
+    printf( "FAIL: no pipe for the controller\n");
+    return 1;
+  }
+  fcntl( fds[0], F_SETFL, fcntl( fds[0], F_GETFL) | O_NONBLOCK);
+  Vector<LinuxJoystick::Axis> axes;
+  for( size_t a = ABS_X; a <= ABS_RZ; ++a )
+    axes.push_back( LinuxJoystick::Axis{ a, true, -32768, 32767, 128 });
+  Vector<LinuxJoystick::Button> buttons;
+  for( size_t a = BTN_SOUTH; a <= BTN_THUMBR; ++a )
+    buttons.push_back( LinuxJoystick::Button{ a });
+  auto lj = new LinuxJoystick( sys, sys->GetDevices().size(), fds[0], axes, buttons);
+  InputSystemHelper::AddDevice( sys, lj);
+  sys->GetAnalog( 16).AddAnalogSource( lj->GetId(), 0);
+  sys->GetDigital( 16).AddDigitalSource( lj->GetId(), 0);
+#endif
+
+  for( size_t c = 0; c < 16; ++c )
+  {
+    sys->GetDigital( c).AddDigitalSource( kb->GetId(), KC_A + c);
+    sys->GetDigital( c).AddDigitalSource( j->GetId(), c % 8);
+    sys->GetAnalog( c).AddAnalogSource( j->GetId(), c % 4);
+    sys->GetAnalog( c).AddDigitalSource( m->GetId(), MB_Left, 1.0f);
+  }
+  Handler handler;
+  sys->SetHandler( &handler);
+  sys->SetEventQueueCapacity( 1024);
+  sys->SetUpdateStatsEnabled( true);
+  auto reader = sys->CreateFrameReader();
+  InputEvent events[256];
+  float sum = 0.0f;
+
+  size_t numEvents = 0;
+  for( size_t a = 0; a < NumWarmupFrames + NumFrames; ++a )
+  {
+    if( a == NumWarmupFrames )
+    {
+      gIsCounting = true;
+      handler.mCalls = 0;
+    }
+
+    sys->SetTime( (a + 1) * 16000);
+    FeedFrame( sys, a, m, kb, j);
+    sys->Update();
+#if SNIIS_SYSTEM_LINUX
+    // VirtualInput doesn't know it, so its part of the update is run by hand, like LinuxInput::Update() does
+    FeedController( fds[1], a);
+    lj->StartUpdate();
+    lj->ResetFirstUpdateFlag();
+#endif
+    numEvents += sys->PollEvents( events, 256);
+    const auto& frame = reader->Acquire();
+    sum += frame.mAnalogChannels.empty() ? 0.0f : frame.mAnalogChannels[0].mValue;
+  }
+  gIsCounting = false;
+
+  size_t numCalls = handler.mCalls;
+  sys->DestroyFrameReader( reader);
+  InputSystem::Destroy( sys);
+#if SNIIS_SYSTEM_LINUX
+  close( fds[0]);
+  close( fds[1]);
+#endif
+
+  printf( "%zu updates, %zu handler calls, %zu events: %zu news, %zu deletes, %zu SNIIS allocations, %zu SNIIS frees (%g)\n",
+    NumFrames, numCalls, numEvents, gNumNews, gNumDeletes, allocator.mNumAllocs, allocator.mNumFrees, double( sum));
+  bool isOk = gNumNews == 0 && gNumDeletes == 0 && allocator.mNumAllocs == 0 && allocator.mNumFrees == 0 && numCalls > 0;
+  printf( isOk ? "ok\n" : "FAIL: the update path allocated\n");
+  return isOk ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+# Microbenchmarks of the dispatch and channel hot paths. Prints JSON, or CSV with --csv.
+
+TEMPLATE = app
+CONFIG += console c++14
+CONFIG -= app_bundle qt
+TARGET = sniis_bench
+
+include(../../sniis.pri)
+
+SOURCES += sniis_bench.cpp
+HEADERS += ../common/ResultReporter.h
@@ -0,0 +1,375 @@
+/// @file sniis_bench.cpp
+/// Microbenchmarks of the hot paths: channel evaluation depending on the number of channels and sources, the full chain
+/// from a key to the handler and the channels, Update() with idle devices, and on Linux the parsing of controller and
+/// keyboard input. Prints all results as JSON, or as CSV with --csv, in the format described in ResultReporter.h.
+/// Options: --csv, --quick for short runs, --filter <text> to only run benchmarks whose name contains the text.
+/// Everything runs on a VirtualInput. The controller parser reads synthetic evdev events from a pipe; the keyboard
+/// parser needs an X display for the keymap and is reported as skipped without one.
+
+#include "SNIIS.h"
+#include "SNIIS_Intern.h"
+#include "SNIIS_Virtual.h"
+#include "../common/ResultReporter.h"
+#if SNIIS_SYSTEM_LINUX
+#include "SNIIS_Linux.h"
+#include <X11/keysym.h>
+#include <fcntl.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace SNIIS;
+
+namespace
+{
+ResultReporter gReport( "sniis_bench");
+double gMinSeconds = 0.25;
+const char* gFilter = nullptr;
+
+double SecondsSince( std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+}
+
+bool IsWanted( const char* name)
+{
+  return !gFilter || strstr( name, gFilter) != nullptr;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Runs fn( count) with growing counts until a run takes long enough, and keeps that run. fn does count operations and
+// returns the seconds spent on the part to be measured. If fn works in batches of batchSize operations, the count is
+// rounded up to whole batches, so that it reports what was actually done.
+template <typename Fn>
+void Measure( const char* name, std::vector<ResultValue> params, Fn&& fn, uint64_t batchSize = 1)
+{
+  for( uint64_t count = 16; ; count *= 2 )
+  {
+    double seconds = fn( count);
+    if( seconds >= gMinSeconds || count >= (1ull << 36) )
+    {
+      double ops = double( (count + batchSize - 1) / batchSize * batchSize);
+      gReport.Add( TestResult{ name, std::move( params), { { "ops", ops }, { "seconds", seconds },
+        { "ns_per_op", seconds * 1e9 / ops }, { "ops_per_sec", ops / seconds } }, std::string() });
+      return;
+    }
+  }
+}
+
+void Skip( const char* name, const char* reason)
+{
+  gReport.Skip( name, {}, reason);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Evaluation of the channels when a key changes. Each channel kind gets numChannels channels with numSources sources on
+// a controller; if isHit, the key is the last source of every channel, otherwise no channel uses it.
+void BenchUpdateChannels()
+{
+  if( !IsWanted( "update_channels") )
+    return;
+
+  for( size_t numChannels : { 1, 16, 256 } )
+  {
+    for( size_t numSources : { 1, 4, 16 } )
+    {
+      for( bool isHit : { false, true } )
+      {
+        auto sys = VirtualInput::Create();
+        auto kb = sys->AddKeyboard();
+        auto joy = sys->AddJoystick( 32, 8);
+        for( size_t c = 0; c < numChannels; ++c )
+        {
+          auto& dch = sys->GetDigital( c);
+          auto& ach = sys->GetAnalog( c);
+          for( size_t s = 0; s + 1 < numSources; ++s )
+          {
+            dch.AddDigitalSource( joy->GetId(), s);
+            if( s < 8 )
+              ach.AddAnalogSource( joy->GetId(), s);
+            else
+              ach.AddDigitalSource( joy->GetId(), s, 1.0f);
+          }
+          if( isHit )
+          {
+            dch.AddDigitalSource( kb->GetId(), KC_A);
+            ach.AddDigitalSource( kb->GetId(), KC_A, 1.0f);
+          } else
+          {
+            dch.AddDigitalSource( joy->GetId(), 31);
+            ach.AddDigitalSource( joy->GetId(), 31, 1.0f);
+          }
+        }
+        sys->Update();
+
+        Measure( "update_channels", { { "channels", double( numChannels) }, { "sources", double( numSources) },
+            { "hit", isHit ? 1.0 : 0.0 } }, [&]( uint64_t count)
+        {
+          auto start = std::chrono::steady_clock::now();
+          for( uint64_t a = 0; a < count; ++a )
+            InputSystemHelper::UpdateChannels( kb, KC_A, false);
+          return SecondsSince( start);
+        });
+        InputSystem::Destroy( sys);
+      }
+    }
+  }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Counts the calls so that none of them can be left out, but passes everything on to the next level
+struct CountingHandler : public InputHandler
+{
+  uint64_t mCalls = 0;
+  bool OnKey( Keyboard*, SNIIS::KeyCode, bool) override { ++mCalls; return false; }
+  bool OnUnicode( Keyboard*, size_t) override { ++mCalls; return false; }
+  bool OnDigitalEvent( Device*, size_t, bool) override { ++mCalls; return false; }
+  void OnDigitalChannel( const DigitalChannel&) override { ++mCalls; }
+  void OnAnalogChannel( const AnalogChannel&) override { ++mCalls; }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// A key going down and up through DoKeyboardButton(): handler, key repetition, event queue and the channels using the
+// key. Each operation is one press or release. The key's state is set first, like a backend does.
+void BenchKeyboardChain()
+{
+  if( !IsWanted( "keyboard_chain") )
+    return;
+
+  for( size_t numChannels : { 0, 16, 256 } )
+  {
+    for( bool hasHandler : { false, true } )
+    {
+      for( bool hasQueue : { false, true } )
+      {
+        auto sys = VirtualInput::Create();
+        auto kb = sys->AddKeyboard();
+        CountingHandler handler;
+        if( hasHandler )
+          sys->SetHandler( &handler);
+        for( size_t c = 0; c < numChannels; ++c )
+        {
+          sys->GetDigital( c).AddDigitalSource( kb->GetId(), KC_A);
+          sys->GetAnalog( c).AddDigitalSource( kb->GetId(), KC_A, 1.0f);
+        }
+        InputEvent events[64];
+        if( hasQueue )
+          sys->SetEventQueueCapacity( 1024);
+        sys->Update();
+
+        Measure( "keyboard_chain", { { "channels", double( numChannels) }, { "handler", hasHandler ? 1.0 : 0.0 },
+            { "queue", hasQueue ? 1.0 : 0.0 } }, [&]( uint64_t count)
+        {
+          auto start = std::chrono::steady_clock::now();
+          for( uint64_t a = 0; a < count; ++a )
+          {
+            bool isPressed = (a & 1) == 0;
+            sys->PresetButton( kb, KC_A, isPressed);
+            InputSystemHelper::DoKeyboardButton( kb, KC_A, 'a', isPressed);
+            // drain like an application would, so the queue doesn't just count drops
+            if( hasQueue && (a & 31) == 31 )
+              sys->PollEvents( events, 64);
+          }
+          return SecondsSince( start);
+        });
+        InputSystem::Destroy( sys);
+      }
+    }
+  }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// The fixed cost of Update() with the given number of devices which don't do anything: a third each of mice,
+// keyboards and controllers
+void BenchIdleUpdate()
+{
+  if( !IsWanted( "update_idle") )
+    return;
+
+  for( size_t numDevices : { 0, 3, 30, 300 } )
+  {
+    auto sys = VirtualInput::Create();
+    for( size_t a = 0; a < numDevices; ++a )
+    {
+      if( a % 3 == 0 )
+        sys->AddMouse();
+      else if( a % 3 == 1 )
+        sys->AddKeyboard();
+      else
+        sys->AddJoystick( 16, 6);
+    }
+    sys->Update();
+
+    Measure( "update_idle", { { "devices", double( numDevices) } }, [&]( uint64_t count)
+    {
+      auto start = std::chrono::steady_clock::now();
+      for( uint64_t a = 0; a < count; ++a )
+        sys->Update();
+      return SecondsSince( start);
+    });
+    InputSystem::Destroy( sys);
+  }
+}
+
+#if SNIIS_SYSTEM_LINUX
+// --------------------------------------------------------------------------------------------------------------------
+// LinuxJoystick::StartUpdate() reading synthetic evdev reports from a pipe: each report moves both axes of a stick,
+// every fourth one also presses or releases a button. Each operation is one input_event, SYN_REPORTs included. Only
+// the reading and parsing is timed, not filling the pipe.
+void BenchLinuxJoystick()
+{
+  if( !IsWanted( "linux_joystick_parse") )
+    return;
+
+  for( bool isEachReport : { false, true } )
+  {
+    int fds[2];
+    if( pipe( fds) != 0 )
+    {
+      Skip( "linux_joystick_parse", "no pipe");
+      return;
+    }
+    fcntl( fds[0], F_SETFL, fcntl( fds[0], F_GETFL) | O_NONBLOCK);
+
+    auto sys = VirtualInput::Create();
+    sys->SetReportMode( isEachReport ? Report_Each : Report_Latest);
+    Vector<LinuxJoystick::Axis> axes;
+    for( size_t a = ABS_X; a <= ABS_RZ; ++a )
+      axes.push_back( LinuxJoystick::Axis{ a, true, -32768, 32767, 128 });
+    Vector<LinuxJoystick::Button> buttons;
+    for( size_t a = BTN_SOUTH; a <= BTN_THUMBR; ++a )
+      buttons.push_back( LinuxJoystick::Button{ a });
+    auto joy = new LinuxJoystick( sys, sys->GetDevices().size(), fds[0], axes, buttons);
+    InputSystemHelper::AddDevice( sys, joy);
+    joy->ResetFirstUpdateFlag();
+
+    // stays below the 64k a pipe holds by default, so that a single write never blocks
+    std::vector<input_event> traffic;
+    for( int r = 0; r < 600; ++r )
+    {
+      input_event ev;
+      memset( &ev, 0, sizeof( ev));
+      ev.type = EV_ABS; ev.code = ABS_X; ev.value = (r * 397) % 65536 - 32768;
+      traffic.push_back( ev);
+      ev.code = ABS_Y; ev.value = (r * 211) % 65536 - 32768;
+      traffic.push_back( ev);
+      if( r % 4 == 0 )
+      {
+        ev.type = EV_KEY; ev.code = BTN_SOUTH; ev.value = (r / 4) & 1;
+        traffic.push_back( ev);
+      }
+      ev.type = EV_SYN; ev.code = SYN_REPORT; ev.value = 0;
+      traffic.push_back( ev);
+    }
+    size_t numBytes = traffic.size() * sizeof( input_event);
+
+    Measure( "linux_joystick_parse", { { "report_each", isEachReport ? 1.0 : 0.0 } }, [&]( uint64_t count)
+    {
+      double seconds = 0.0;
+      for( uint64_t done = 0; done < count; done += traffic.size() )
+      {
+        if( write( fds[1], traffic.data(), numBytes) != ssize_t( numBytes) )
+          break;
+        auto start = std::chrono::steady_clock::now();
+        joy->StartUpdate();
+        seconds += SecondsSince( start);
+      }
+      return seconds;
+    }, traffic.size());
+
+    InputSystem::Destroy( sys);
+    close( fds[0]);
+    close( fds[1]);
+  }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// LinuxKeyboard::HandleEvent() translating raw XI2 key events of the letter A, alternating press and release. Needs an
+// X display for the keymap; the XTEST keyboard of a virtual X server does fine.
+void BenchLinuxKeyboard()
+{
+  if( !IsWanted( "linux_keyboard_translate") )
+    return;
+
+  Display* dpy = XOpenDisplay( nullptr);
+  if( !dpy )
+    return Skip( "linux_keyboard_translate", "no X display");
+  Window wnd = XCreateSimpleWindow( dpy, DefaultRootWindow( dpy), 0, 0, 64, 64, 0, 0, 0);
+  XFlush( dpy);
+
+  InitOptions options;
+  options.mUseSyntheticDevices = true;
+  auto sys = dynamic_cast<LinuxInput*> (InputSystem::Create( (void*) wnd, options));
+  LinuxKeyboard* kb = nullptr;
+  if( sys )
+    for( auto d : sys->GetDevices() )
+      if( !kb )
+        kb = dynamic_cast<LinuxKeyboard*> (d);
+
+  if( !kb )
+  {
+    Skip( "linux_keyboard_translate", sys ? "no X keyboard" : "no XInput2");
+  } else
+  {
+    kb->ResetFirstUpdateFlag();
+    XIRawEvent ev;
+    memset( &ev, 0, sizeof( ev));
+    ev.detail = XKeysymToKeycode( sys->GetDisplay(), XK_a);
+
+    Measure( "linux_keyboard_translate", {}, [&]( uint64_t count)
+    {
+      auto start = std::chrono::steady_clock::now();
+      for( uint64_t a = 0; a < count; ++a )
+      {
+        ev.evtype = (a & 1) == 0 ? XI_RawKeyPress : XI_RawKeyRelease;
+        kb->HandleEvent( ev);
+      }
+      return SecondsSince( start);
+    });
+  }
+
+  if( sys )
+    InputSystem::Destroy( sys);
+  XDestroyWindow( dpy, wnd);
+  XCloseDisplay( dpy);
+}
+#endif // SNIIS_SYSTEM_LINUX
+
+} // namespace
+
+// --------------------------------------------------------------------------------------------------------------------
+int main( int argc, char** argv)
+{
+  bool isCsv = false;
+  for( int a = 1; a < argc; ++a )
+  {
+    if( strcmp( argv[a], "--csv") == 0 )
+      isCsv = true;
+    else if( strcmp( argv[a], "--quick") == 0 )
+      gMinSeconds = 0.02;
+    else if( strcmp( argv[a], "--filter") == 0 && a + 1 < argc )
+      gFilter = argv[++a];
+    else
+    {
+      fprintf( stderr, "Usage: %s [--csv] [--quick] [--filter <text>]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  BenchUpdateChannels();
+  BenchKeyboardChain();
+  BenchIdleUpdate();
+#if SNIIS_SYSTEM_LINUX
+  BenchLinuxJoystick();
+  BenchLinuxKeyboard();
+#endif
+
+  if( isCsv )
+    gReport.PrintCsv();
+  else
+    gReport.PrintJson();
+  return 0;
+}
@@ -0,0 +1,158 @@
+/// @file ResultReporter.h
+/// Collects the results of the test and benchmark programs and prints them as JSON or CSV, so that all of them share
+/// one machine-readable format. Everything is header-only so each program can just include it.
+///
+/// JSON: { "program": <name>, "settings": { <name>: <number or string>, ... }, "results": [ { "name": <name>,
+///   "params": { <name>: <number>, ... }, "values": { <name>: <number>, ... } }, ... ] }. A skipped result has
+///   "skipped": <reason> instead of "values".
+/// CSV: the header "name,params,value,number,skipped" and one line per value, with the params as "a=1;b=2". A skipped
+///   result is one line with only name, params and the reason.
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// A named number, a parameter or a measurement
+struct ResultValue
+{
+  std::string mName;
+  double mValue;
+};
+
+/// One measurement or check. Params describe what was measured, e.g. the number of devices, values are the results.
+struct TestResult
+{
+  std::string mName;
+  std::vector<ResultValue> mParams;
+  std::vector<ResultValue> mValues;
+  std::string mSkipReason; ///< empty if it ran
+};
+
+/// -------------------------------------------------------------------------------------------------------------------
+class ResultReporter
+{
+  std::string mProgram;
+  std::vector<std::pair<std::string, std::string>> mSettings; ///< name and the value as JSON
+  std::vector<TestResult> mResults;
+
+public:
+  explicit ResultReporter( const std::string& pProgram) : mProgram( pProgram) { }
+
+  /// Settings of the whole run, e.g. the number of runs per measurement. Only printed in JSON.
+  void AddSetting( const std::string& pName, double pValue) { mSettings.emplace_back( pName, Number( pValue)); }
+  void AddSetting( const std::string& pName, const std::string& pValue)
+  {
+    mSettings.emplace_back( pName, JsonString( pValue));
+  }
+
+  void Add( TestResult pResult) { mResults.push_back( std::move( pResult)); }
+  void Skip( const std::string& pName, std::vector<ResultValue> pParams, const std::string& pReason)
+  {
+    mResults.push_back( TestResult{ pName, std::move( pParams), {}, pReason.empty() ? "skipped" : pReason });
+  }
+  /// The result added last, for adding to it afterwards
+  TestResult& Back() { return mResults.back(); }
+  const std::vector<TestResult>& GetResults() const { return mResults; }
+
+  void PrintJson( FILE* pFile = stdout) const
+  {
+    fprintf( pFile, "{\n  \"program\": %s,\n  \"settings\": {", JsonString( mProgram).c_str());
+    for( size_t a = 0; a < mSettings.size(); ++a )
+      fprintf( pFile, "%s %s: %s", a > 0 ? "," : "", JsonString( mSettings[a].first).c_str(),
+        mSettings[a].second.c_str());
+    fprintf( pFile, " },\n  \"results\": [");
+    for( size_t a = 0; a < mResults.size(); ++a )
+    {
+      const auto& r = mResults[a];
+      fprintf( pFile, "%s\n    { \"name\": %s, \"params\": %s", a > 0 ? "," : "", JsonString( r.mName).c_str(),
+        JsonObject( r.mParams).c_str());
+      if( !r.mSkipReason.empty() )
+        fprintf( pFile, ", \"skipped\": %s }", JsonString( r.mSkipReason).c_str());
+      else
+        fprintf( pFile, ", \"values\": %s }", JsonObject( r.mValues).c_str());
+    }
+    fprintf( pFile, "\n  ]\n}\n");
+  }
+
+  void PrintCsv( FILE* pFile = stdout) const
+  {
+    fprintf( pFile, "name,params,value,number,skipped\n");
+    for( const auto& r : mResults )
+    {
+      std::string params;
+      for( const auto& p : r.mParams )
+        params += (params.empty() ? "" : ";") + p.mName + "=" + Number( p.mValue);
+      std::string prefix = CsvField( r.mName) + "," + CsvField( params) + ",";
+      if( !r.mSkipReason.empty() )
+        fprintf( pFile, "%s,,%s\n", prefix.c_str(), CsvField( r.mSkipReason).c_str());
+      for( const auto& v : r.mValues )
+        if( r.mSkipReason.empty() )
+          fprintf( pFile, "%s%s,%s,\n", prefix.c_str(), CsvField( v.mName).c_str(),
+            std::isfinite( v.mValue) ? Number( v.mValue).c_str() : "");
+    }
+  }
+
+  /// Formats a number for both formats: integers without fraction, everything else with ten significant digits.
+  /// JSON has no infinity or NaN, those become null, and an empty field in CSV.
+  static std::string Number( double pValue)
+  {
+    if( !std::isfinite( pValue) )
+      return "null";
+    char buf[32];
+    snprintf( buf, sizeof( buf), "%.10g", pValue);
+    return buf;
+  }
+
+  /// Quotes a string for JSON, escaping quotes, backslashes and control characters
+  static std::string JsonString( const std::string& pText)
+  {
+    std::string res = "\"";
+    for( char c : pText )
+    {
+      if( c == '"' || c == '\\' )
+        res += '\\', res += c;
+      else if( c == '\n' )
+        res += "\\n";
+      else if( c == '\t' )
+        res += "\\t";
+      else if( static_cast<unsigned char> (c) < 0x20 )
+      {
+        char buf[8];
+        snprintf( buf, sizeof( buf), "\\u%04x", unsigned( c));
+        res += buf;
+      }
+      else
+        res += c;
+    }
+    return res + "\"";
+  }
+
+  /// Quotes a CSV field if it contains a separator, a quote or a line break, doubling the quotes inside
+  static std::string CsvField( const std::string& pText)
+  {
+    if( pText.find_first_of( ",\"\r\n") == std::string::npos )
+      return pText;
+    std::string res = "\"";
+    for( char c : pText )
+    {
+      if( c == '"' )
+        res += '"';
+      res += c;
+    }
+    return res + "\"";
+  }
+
+protected:
+  static std::string JsonObject( const std::vector<ResultValue>& pValues)
+  {
+    std::string res = "{";
+    for( size_t a = 0; a < pValues.size(); ++a )
+      res += (a > 0 ? ", " : " ") + JsonString( pValues[a].mName) + ": " + Number( pValues[a].mValue);
+    return res + (pValues.empty() ? "}" : " }");
+  }
+};
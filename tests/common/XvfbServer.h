@@ -0,0 +1,109 @@
+/// @file XvfbServer.h
+/// Starts a private virtual X server for the test programs that need a display, and stops it again on destruction.
+/// Linux only. Everything is header-only so each test program can just include it.
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/// -------------------------------------------------------------------------------------------------------------------
+/// A running Xvfb. Start() picks a free display number through -displayfd and points DISPLAY at it, so that everything
+/// opening the default display afterwards - LinuxInput included - talks to that server.
+class XvfbServer
+{
+  pid_t mPid = -1;
+  std::string mDisplay;
+
+public:
+  ~XvfbServer() { Stop(); }
+
+  /// Starts the server and waits until it accepts connections. Returns false with a reason if Xvfb is not installed or
+  /// doesn't come up within the timeout.
+  bool Start( std::string& pError, int pTimeoutMs = 5000)
+  {
+    int fds[2];
+    if( pipe( fds) != 0 )
+      return pError = "no pipe", false;
+
+    mPid = fork();
+    if( mPid < 0 )
+    {
+      close( fds[0]); close( fds[1]);
+      return pError = "fork failed", false;
+    }
+    if( mPid == 0 )
+    {
+      close( fds[0]);
+      int devNull = open( "/dev/null", O_WRONLY);
+      if( devNull >= 0 )
+      {
+        dup2( devNull, STDOUT_FILENO);
+        dup2( devNull, STDERR_FILENO);
+      }
+      std::string displayFd = std::to_string( fds[1]);
+      execlp( "Xvfb", "Xvfb", "-displayfd", displayFd.c_str(), "-nolisten", "tcp", "-screen", "0", "1024x768x24",
+        (char*) nullptr);
+      _exit( 127);
+    }
+    close( fds[1]);
+
+    // Xvfb writes the display number once it is ready. EOF without a number means it didn't start.
+    char number[16] = { 0 };
+    size_t length = 0;
+    bool isEof = false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( pTimeoutMs);
+    while( length + 1 < sizeof( number) && (length == 0 || number[length-1] != '\n') )
+    {
+      int left = int( std::chrono::duration_cast<std::chrono::milliseconds> (deadline - std::chrono::steady_clock::now()).count());
+      pollfd pfd = { fds[0], POLLIN, 0 };
+      if( left <= 0 || poll( &pfd, 1, left) <= 0 )
+        break;
+      ssize_t got = read( fds[0], number + length, sizeof( number) - 1 - length);
+      if( got <= 0 )
+      {
+        isEof = true;
+        break;
+      }
+      length += size_t( got);
+    }
+    close( fds[0]);
+
+    if( length == 0 || number[length-1] != '\n' )
+    {
+      int status = 0;
+      // EOF means the child closed everything, so it is gone or about to be
+      bool hasExited = waitpid( mPid, &status, isEof ? 0 : WNOHANG) == mPid;
+      pError = hasExited && WIFEXITED( status) && WEXITSTATUS( status) == 127 ? "Xvfb not found" : "Xvfb did not start";
+      if( hasExited )
+        mPid = -1;
+      Stop();
+      return false;
+    }
+
+    number[length-1] = 0;
+    mDisplay = std::string( ":") + number;
+    setenv( "DISPLAY", mDisplay.c_str(), 1);
+    return true;
+  }
+
+  /// Terminates the server if it is running
+  void Stop()
+  {
+    if( mPid <= 0 )
+      return;
+    kill( mPid, SIGTERM);
+    waitpid( mPid, nullptr, 0);
+    mPid = -1;
+  }
+
+  const std::string& GetDisplay() const { return mDisplay; }
+};
@@ -0,0 +1,12 @@
+# Golden trace test: replays the logs in corpus/ and compares the frame hashes. Run it with "make check", regenerate
+# the corpus with "sniis_golden --regenerate".
+
+TEMPLATE = app
+CONFIG += console c++14 testcase
+CONFIG -= app_bundle qt
+TARGET = sniis_golden
+
+include(../../sniis.pri)
+
+DEFINES += SNIIS_GOLDEN_CORPUS=\\\"$$PWD/corpus\\\"
+SOURCES += sniis_golden.cpp
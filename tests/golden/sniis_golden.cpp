@@ -0,0 +1,411 @@
+/// @file sniis_golden.cpp
+/// Golden trace test: replays the input logs in corpus/ and compares the hash of every replayed frame and its handler
+/// calls with the known good hashes next to each log. Fails on the first differing frame of each log and prints how
+/// fast the replay ran.
+/// The logs are made by driving a VirtualInput through scripted scenarios with an InputRecorder attached. After a
+/// change that is meant to change behaviour, run with --regenerate to rewrite logs and hashes, and review the diff.
+/// Options: --corpus <dir>, default is the corpus directory of the source tree with qmake, or corpus/ in the working
+/// directory otherwise; --regenerate.
+
+#include "SNIIS.h"
+#include "SNIIS_Record.h"
+#include "SNIIS_Virtual.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+#ifndef SNIIS_GOLDEN_CORPUS
+#define SNIIS_GOLDEN_CORPUS "corpus"
+#endif
+
+using namespace SNIIS;
+
+namespace
+{
+/// Drives one frame of a scenario: feeds input for the given frame number, the caller does the Update() afterwards
+typedef void (*ScenarioFrame)( VirtualInput* sys, size_t frame);
+/// Adds the devices of a scenario and sets its key repetition, before the recording starts
+typedef void (*ScenarioSetup)( VirtualInput* sys);
+/// Sets up what a log doesn't carry: channels and the event queue. Runs on the recording and on the replaying system,
+/// after the devices are there.
+typedef void (*ScenarioConfig)( InputSystem* sys);
+
+struct Scenario
+{
+  const char* mName;
+  size_t mNumFrames;
+  uint64_t mKeyframeInterval;
+  ScenarioSetup mSetup;
+  ScenarioConfig mConfig;
+  ScenarioFrame mFrame;
+};
+
+/// All frames are 10ms apart on the manual clock
+const uint64_t FrameTime = 10000;
+
+// --------------------------------------------------------------------------------------------------------------------
+// Typing on a keyboard: short taps with unicode, a held key running into key repetition, modifiers, and a few channels
+// on keys
+void SetupTyping( VirtualInput* sys)
+{
+  sys->AddKeyboard();
+  KeyRepeatCfg krc;
+  krc.delay = 0.3f; krc.interval = 0.05f;
+  sys->SetKeyRepeatCfg( krc);
+}
+
+void ConfigTyping( InputSystem* sys)
+{
+  sys->GetDigital( 0).AddDigitalSource( 0, KC_SPACE);
+  sys->GetDigital( 1).AddDigitalSource( 0, KC_LSHIFT);
+  sys->GetDigital( 1).AddDigitalSource( 0, KC_RSHIFT);
+  sys->GetAnalog( 0).AddDigitalSource( 0, KC_D, 1.0f);
+  sys->GetAnalog( 0).AddDigitalSource( 0, KC_A, -1.0f);
+}
+
+void FrameTyping( VirtualInput* sys, size_t frame)
+{
+  auto kb = static_cast<VirtualKeyboard*> (sys->GetDevices()[0]);
+  static const char sText[] = "the quick brown fox jumps over the lazy dog ";
+  static const KeyCode sLetterKeys[26] = { KC_A, KC_B, KC_C, KC_D, KC_E, KC_F, KC_G, KC_H, KC_I, KC_J, KC_K, KC_L, KC_M,
+    KC_N, KC_O, KC_P, KC_Q, KC_R, KC_S, KC_T, KC_U, KC_V, KC_W, KC_X, KC_Y, KC_Z };
+
+  // a tap every 3 frames: down on the first, up on the second
+  size_t tap = frame / 3, phase = frame % 3;
+  if( frame < 300 && phase < 2 )
+  {
+    char c = sText[tap % (sizeof( sText) - 1)];
+    KeyCode kc = c == ' ' ? KC_SPACE : sLetterKeys[c - 'a'];
+    bool isShifted = (tap % 11) == 0 && c != ' ';
+    if( isShifted && phase == 0 )
+      kb->SetKey( KC_LSHIFT, true);
+    kb->SetKey( kc, phase == 0, phase == 0 ? size_t( isShifted ? c - 'a' + 'A' : c) : 0);
+    if( isShifted && phase == 1 )
+      kb->SetKey( KC_LSHIFT, false);
+  }
+
+  // then hold D for a second, so that it repeats, and tap A while it's held
+  if( frame == 320 )
+    kb->SetKey( KC_D, true, 'd');
+  if( frame == 350 || frame == 360 )
+    kb->SetKey( KC_A, frame == 350, frame == 350 ? 'a' : 0);
+  if( frame == 420 )
+    kb->SetKey( KC_D, false);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Two mice: circles, relative movement while grabbed, clicks, drags and the wheel, with analog channels on the axes
+// and losing focus in the middle of a drag
+void SetupMouse( VirtualInput* sys)
+{
+  sys->AddMouse();
+  sys->AddMouse( 3, 3);
+}
+
+void ConfigMouse( InputSystem* sys)
+{
+  sys->GetAnalog( 0).AddAnalogSource( 0, 0);
+  sys->GetAnalog( 1).AddAnalogSource( 0, 1);
+  sys->GetAnalog( 2).AddAnalogSource( 1, 2);
+  sys->GetDigital( 0).AddDigitalSource( 0, MB_Left);
+  sys->GetDigital( 0).AddDigitalSource( 1, MB_Left);
+  sys->GetDigital( 1).AddDigitalSource( 0, MB_Right);
+}
+
+void FrameMouse( VirtualInput* sys, size_t frame)
+{
+  auto m = static_cast<VirtualMouse*> (sys->GetDevices()[0]);
+  auto m2 = static_cast<VirtualMouse*> (sys->GetDevices()[1]);
+
+  // a polygon with a vertex per frame, several moves per frame now and then
+  static const float sDirs[8][2] = { { 4, 0 }, { 3, 3 }, { 0, 4 }, { -3, 3 }, { -4, 0 }, { -3, -3 }, { 0, -4 }, { 3, -3 } };
+  const float* dir = sDirs[(frame / 5) % 8];
+  m->Move( dir[0], dir[1]);
+  if( frame % 7 == 0 )
+    m->Move( dir[1] * 0.5f, -dir[0] * 0.5f);
+  if( frame >= 200 && frame < 260 )
+    m->MoveTo( m->GetMouseX(), m->GetMouseY(), float( frame % 5) - 2.0f, 1.5f);
+
+  if( frame % 40 == 10 || frame % 40 == 12 )
+    m->SetButton( MB_Left, frame % 40 == 10);
+  if( frame % 90 == 30 )
+    m->SetButton( MB_Right, true);
+  if( frame % 90 == 75 )
+    m->SetButton( MB_Right, false);
+  if( frame % 13 == 0 )
+    m->Wheel( frame % 26 == 0 ? 1.0f : -2.0f);
+
+  // the second mouse drags across the focus loss
+  if( frame == 100 )
+    m2->SetButton( MB_Left, true);
+  if( frame >= 100 && frame < 180 )
+    m2->MoveTo( 100.0f + float( frame), 50.0f);
+  if( frame == 140 )
+    sys->SetFocus( false);
+  if( frame == 150 )
+    sys->SetFocus( true);
+  if( frame == 180 )
+    m2->SetButton( MB_Left, false);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Two controllers: sweeping sticks and triggers, button mashing, a controller being disabled and enabled again, and
+// input getting lost
+void SetupControllers( VirtualInput* sys)
+{
+  sys->AddJoystick( 12, 6);
+  sys->AddJoystick( 8, 4);
+}
+
+void ConfigControllers( InputSystem* sys)
+{
+  sys->GetAnalog( 0).AddAnalogSource( 0, 0);
+  sys->GetAnalog( 0).AddAnalogSource( 1, 0);
+  sys->GetAnalog( 1).AddAnalogSource( 0, 4);
+  sys->GetAnalog( 1).AddDigitalSource( 0, 5, 1.0f);
+  sys->GetDigital( 0).AddDigitalSource( 0, 0);
+  sys->GetDigital( 0).AddDigitalSource( 1, 0);
+  sys->GetDigital( 1).AddAnalogSource( 0, 1, 0.5f);
+  sys->SetEventQueueCapacity( 256);
+}
+
+void FrameControllers( VirtualInput* sys, size_t frame)
+{
+  auto j = static_cast<VirtualJoystick*> (sys->GetDevices()[0]);
+  auto j2 = static_cast<VirtualJoystick*> (sys->GetDevices()[1]);
+
+  // a triangle wave on the sticks, quantised like a real controller reports it
+  float t = float( (frame * 3) % 200) / 100.0f;
+  float wave = float( int( (t < 1.0f ? t : 2.0f - t) * 2.0f * 255.0f) - 255) / 255.0f;
+  j->SetAxis( 0, wave);
+  j->SetAxis( 1, -wave);
+  if( frame % 4 == 0 )
+    j->SetAxis( 4, float( frame % 64) / 63.0f);
+  j2->SetAxis( frame % 4, wave * 0.5f);
+
+  j->SetButton( frame % 12, (frame / 12) % 2 == 0);
+  if( frame % 6 == 0 )
+    j2->SetButton( (frame / 6) % 8, (frame / 48) % 2 == 0);
+
+  if( frame == 150 )
+    sys->SetDeviceEnabled( j2, false);
+  if( frame == 210 )
+    sys->SetDeviceEnabled( j2, true);
+  if( frame % 97 == 50 )
+    sys->DropInput( j);
+  if( frame == 180 )
+    sys->DropInput( j2); // disabled at this point, so nothing happens
+
+  // keep the queue from filling up
+  InputEvent events[64];
+  while( sys->PollEvents( events, 64) == 64 ) { }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Everything at once for a long time, with keyframes, as a throughput measurement. Input is pseudo-random.
+uint32_t gRandom = 1;
+uint32_t NextRandom()
+{
+  gRandom ^= gRandom << 13; gRandom ^= gRandom >> 17; gRandom ^= gRandom << 5;
+  return gRandom;
+}
+
+void SetupMixed( VirtualInput* sys)
+{
+  gRandom = 0x5eed;
+  sys->AddMouse();
+  sys->AddKeyboard();
+  sys->AddJoystick( 16, 6);
+}
+
+void ConfigMixed( InputSystem* sys)
+{
+  for( size_t c = 0; c < 8; ++c )
+  {
+    sys->GetDigital( c).AddDigitalSource( 1, KC_1 + c);
+    sys->GetDigital( c).AddDigitalSource( 2, c);
+    sys->GetAnalog( c).AddAnalogSource( 2, c % 6);
+    sys->GetAnalog( c).AddAnalogSource( 0, c % 2);
+  }
+}
+
+void FrameMixed( VirtualInput* sys, size_t frame)
+{
+  auto m = static_cast<VirtualMouse*> (sys->GetDevices()[0]);
+  auto kb = static_cast<VirtualKeyboard*> (sys->GetDevices()[1]);
+  auto j = static_cast<VirtualJoystick*> (sys->GetDevices()[2]);
+
+  for( uint32_t n = NextRandom() % 4; n > 0; --n )
+    m->Move( float( int( NextRandom() % 21) - 10), float( int( NextRandom() % 21) - 10));
+  if( NextRandom() % 8 == 0 )
+    m->SetButton( NextRandom() % 3, NextRandom() % 2 == 0);
+  if( NextRandom() % 16 == 0 )
+    kb->SetKey( KeyCode( KC_1 + NextRandom() % 10), NextRandom() % 2 == 0, '1' + frame % 10);
+  for( uint32_t n = NextRandom() % 6; n > 0; --n )
+    j->SetAxis( NextRandom() % 6, float( int( NextRandom() % 511) - 255) / 255.0f);
+  if( NextRandom() % 4 == 0 )
+    j->SetButton( NextRandom() % 16, NextRandom() % 2 == 0);
+}
+
+const Scenario gScenarios[] = {
+  { "typing", 500, 0, &SetupTyping, &ConfigTyping, &FrameTyping },
+  { "mouse", 400, 0, &SetupMouse, &ConfigMouse, &FrameMouse },
+  { "controllers", 400, 1000000, &SetupControllers, &ConfigControllers, &FrameControllers },
+  { "mixed", 3000, 5000000, &SetupMixed, &ConfigMixed, &FrameMixed },
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+std::string LogPath( const std::string& dir, const Scenario& sc) { return dir + "/" + sc.mName + ".snir"; }
+std::string HashPath( const std::string& dir, const Scenario& sc) { return dir + "/" + sc.mName + ".hashes"; }
+
+bool WriteHashes( const std::string& path, const Scenario& sc, const Vector<uint64_t>& hashes)
+{
+  FILE* f = fopen( path.c_str(), "wb");
+  if( !f )
+    return false;
+  fprintf( f, "# %s: hash of each replayed frame and its handler calls, see InputReplay::ComputeFrameHashes()\n", sc.mName);
+  for( auto h : hashes )
+    fprintf( f, "%016" PRIx64 "\n", h);
+  return fclose( f) == 0;
+}
+
+bool ReadHashes( const std::string& path, std::vector<uint64_t>& hashes)
+{
+  FILE* f = fopen( path.c_str(), "rb");
+  if( !f )
+    return false;
+  char line[256];
+  while( fgets( line, sizeof( line), f) )
+  {
+    if( line[0] == '#' || line[0] == '\n' )
+      continue;
+    uint64_t h = 0;
+    if( sscanf( line, "%" SCNx64, &h) == 1 )
+      hashes.push_back( h);
+  }
+  fclose( f);
+  return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Runs the scenario live with a recorder attached, writes the log, and writes the hashes of replaying the log. Checks
+// that the replay matches the live run, otherwise the log wouldn't be worth anything.
+bool Regenerate( const std::string& dir, const Scenario& sc)
+{
+  auto sys = VirtualInput::Create();
+  sys->SetTime( 0);
+  sc.mSetup( sys);
+  sc.mConfig( sys);
+  sys->Update();
+
+  InputRecorder recorder;
+  recorder.SetKeyframeInterval( sc.mKeyframeInterval);
+  recorder.Start( sys);
+  HashingHandler hasher;
+  sys->SetHandler( &hasher);
+  Vector<uint64_t> liveHashes;
+  InputFrame frame;
+  for( size_t a = 0; a < sc.mNumFrames; ++a )
+  {
+    sys->SetTime( (a + 1) * FrameTime);
+    sc.mFrame( sys, a);
+    sys->Update();
+    sys->FillFrame( frame);
+    liveHashes.push_back( HashFrame( frame, hasher.GetHash()));
+    hasher.Reset();
+  }
+  recorder.Stop();
+  InputSystem::Destroy( sys);
+
+  if( !recorder.WriteToFile( LogPath( dir, sc).c_str()) )
+    return printf( "%s: can't write %s\n", sc.mName, LogPath( dir, sc).c_str()), false;
+
+  auto replaySys = VirtualInput::Create();
+  InputReplay replay( replaySys, recorder.GetData().data(), recorder.GetData().size());
+  sc.mConfig( replaySys);
+  auto hashes = replay.ComputeFrameHashes();
+  InputSystem::Destroy( replaySys);
+  if( hashes != liveHashes )
+  {
+    size_t a = 0;
+    while( a < hashes.size() && a < liveHashes.size() && hashes[a] == liveHashes[a] )
+      ++a;
+    return printf( "%s: the replay doesn't match the live run from frame %zu on\n", sc.mName, a), false;
+  }
+
+  if( !WriteHashes( HashPath( dir, sc), sc, hashes) )
+    return printf( "%s: can't write %s\n", sc.mName, HashPath( dir, sc).c_str()), false;
+  printf( "%s: %zu frames, %zu bytes\n", sc.mName, hashes.size(), recorder.GetData().size());
+  return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Replays the log of the scenario and compares the hashes with the golden ones
+bool Check( const std::string& dir, const Scenario& sc)
+{
+  std::vector<uint64_t> golden;
+  if( !ReadHashes( HashPath( dir, sc), golden) )
+    return printf( "FAIL %s: can't read %s\n", sc.mName, HashPath( dir, sc).c_str()), false;
+
+  try
+  {
+    MappedFile file( LogPath( dir, sc).c_str());
+    auto sys = VirtualInput::Create();
+    auto start = std::chrono::steady_clock::now();
+    InputReplay replay( sys, file.GetData(), file.GetSize());
+    sc.mConfig( sys);
+    auto hashes = replay.ComputeFrameHashes();
+    double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+    InputSystem::Destroy( sys);
+
+    for( size_t a = 0; a < hashes.size() && a < golden.size(); ++a )
+    {
+      if( hashes[a] != golden[a] )
+        return printf( "FAIL %s: frame %zu differs, hash %016" PRIx64 " instead of %016" PRIx64 "\n", sc.mName, a,
+          hashes[a], golden[a]), false;
+    }
+    if( hashes.size() != golden.size() )
+      return printf( "FAIL %s: %zu frames instead of %zu\n", sc.mName, hashes.size(), golden.size()), false;
+
+    printf( "ok   %s: %zu frames in %.3f ms, %.0f frames/s\n", sc.mName, hashes.size(), seconds * 1000.0,
+      seconds > 0.0 ? double( hashes.size()) / seconds : 0.0);
+    return true;
+  } catch( std::exception& e)
+  {
+    return printf( "FAIL %s: %s\n", sc.mName, e.what()), false;
+  }
+}
+} // namespace
+
+// --------------------------------------------------------------------------------------------------------------------
+int main( int argc, char** argv)
+{
+  std::string dir = SNIIS_GOLDEN_CORPUS;
+  bool isRegenerating = false;
+  for( int a = 1; a < argc; ++a )
+  {
+    if( strcmp( argv[a], "--regenerate") == 0 )
+      isRegenerating = true;
+    else if( strcmp( argv[a], "--corpus") == 0 && a + 1 < argc )
+      dir = argv[++a];
+    else
+    {
+      fprintf( stderr, "Usage: %s [--corpus <dir>] [--regenerate]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  size_t numFailed = 0;
+  for( const auto& sc : gScenarios )
+    if( !(isRegenerating ? Regenerate( dir, sc) : Check( dir, sc)) )
+      ++numFailed;
+
+  if( numFailed > 0 )
+    printf( "%zu of %zu failed\n", numFailed, sizeof( gScenarios) / sizeof( gScenarios[0]));
+  return numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+/// @file sniis_startup.cpp
+/// Measures creating and destroying input systems and prints the timings in microseconds as JSON, or as CSV with
+/// --csv, in the format described in ResultReporter.h.
+/// - A VirtualInput with growing numbers of devices. Every added device lays out the state arena anew, so the time to
+///   add the last device grows with the number of devices already there, and adding all of them grows quadratically.
+/// - On Linux a LinuxInput on the current X display, with the phases from InputSystem::GetStartupTimings(). With
+///   --xvfb a private Xvfb is started for it. Reported as skipped if there's no display to connect to.
+/// Options: --csv, --xvfb, --runs <n> runs per measurement of which the fastest is kept, default 5.
+
+#include "SNIIS.h"
+#include "SNIIS_Virtual.h"
+#include "../common/ResultReporter.h"
+#if SNIIS_SYSTEM_LINUX
+#include "../common/XvfbServer.h"
+#include <X11/Xlib.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace SNIIS;
+
+namespace
+{
+ResultReporter gReport( "sniis_startup");
+int gNumRuns = 5;
+
+double MicrosecondsSince( std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro> (std::chrono::steady_clock::now() - start).count();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Adds a device to a virtual system: a third each of mice, keyboards and controllers
+void AddVirtualDevice( VirtualInput* sys, size_t idx)
+{
+  if( idx % 3 == 0 )
+    sys->AddMouse();
+  else if( idx % 3 == 1 )
+    sys->AddKeyboard();
+  else
+    sys->AddJoystick( 16, 6);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Creating a VirtualInput, adding numDevices devices, the first Update() and destroying it. "last_device_us" is the
+// time to add one more device to the full system.
+void MeasureVirtual()
+{
+  for( size_t numDevices : { 10, 50, 100, 200, 400, 800 } )
+  {
+    double create = 1e30, add = 1e30, lastDevice = 1e30, update = 1e30, destroy = 1e30;
+    for( int run = 0; run < gNumRuns; ++run )
+    {
+      auto start = std::chrono::steady_clock::now();
+      auto sys = VirtualInput::Create();
+      create = std::min( create, MicrosecondsSince( start));
+
+      start = std::chrono::steady_clock::now();
+      for( size_t a = 0; a < numDevices; ++a )
+        AddVirtualDevice( sys, a);
+      add = std::min( add, MicrosecondsSince( start));
+
+      start = std::chrono::steady_clock::now();
+      AddVirtualDevice( sys, numDevices);
+      lastDevice = std::min( lastDevice, MicrosecondsSince( start));
+
+      start = std::chrono::steady_clock::now();
+      sys->Update();
+      update = std::min( update, MicrosecondsSince( start));
+
+      start = std::chrono::steady_clock::now();
+      InputSystem::Destroy( sys);
+      destroy = std::min( destroy, MicrosecondsSince( start));
+    }
+
+    gReport.Add( TestResult{ "virtual_startup", { { "devices", double( numDevices) } }, { { "create_us", create },
+      { "add_devices_us", add }, { "last_device_us", lastDevice }, { "first_update_us", update },
+      { "destroy_us", destroy } }, std::string() });
+  }
+}
+
+#if SNIIS_SYSTEM_LINUX
+// --------------------------------------------------------------------------------------------------------------------
+// Creating and destroying a LinuxInput on the current display. The phases come from the system's own StartupTimings,
+// "create_us" is the whole InputSystem::Create() call as seen from outside.
+void MeasureLinux( bool useXvfb)
+{
+  XvfbServer xvfb;
+  std::string error;
+  if( useXvfb && !xvfb.Start( error) )
+    return gReport.Skip( "linux_startup", {}, error);
+
+  Display* dpy = XOpenDisplay( nullptr);
+  if( !dpy )
+    return gReport.Skip( "linux_startup", {}, "no X display");
+  Window wnd = XCreateSimpleWindow( dpy, DefaultRootWindow( dpy), 0, 0, 64, 64, 0, 0, 0);
+  XFlush( dpy);
+
+  double create = 1e30, destroy = 1e30;
+  StartupTimings best;
+  size_t numDevices = 0;
+  for( int run = 0; run < gNumRuns; ++run )
+  {
+    auto start = std::chrono::steady_clock::now();
+    auto sys = InputSystem::Create( (void*) wnd);
+    double took = MicrosecondsSince( start);
+    if( !sys )
+    {
+      error = "creating the input system failed";
+      break;
+    }
+
+    // keep the phases of the fastest run, so they add up
+    if( took < create )
+    {
+      create = took;
+      best = sys->GetStartupTimings();
+      numDevices = sys->GetDevices().size();
+    }
+
+    start = std::chrono::steady_clock::now();
+    InputSystem::Destroy( sys);
+    destroy = std::min( destroy, MicrosecondsSince( start));
+  }
+
+  XDestroyWindow( dpy, wnd);
+  XCloseDisplay( dpy);
+
+  if( !error.empty() )
+    gReport.Skip( "linux_startup", {}, error);
+  else
+    gReport.Add( TestResult{ "linux_startup", { { "devices", double( numDevices) } }, { { "create_us", create },
+      { "connect_us", double( best.mConnect) }, { "device_enumeration_us", double( best.mDeviceEnumeration) },
+      { "keyboard_tables_us", double( best.mKeyboardTables) }, { "controller_probing_us", double( best.mControllerProbing) },
+      { "total_us", double( best.mTotal) }, { "destroy_us", destroy } }, std::string() });
+}
+#endif // SNIIS_SYSTEM_LINUX
+
+} // namespace
+
+// --------------------------------------------------------------------------------------------------------------------
+int main( int argc, char** argv)
+{
+  bool isCsv = false, useXvfb = false;
+  for( int a = 1; a < argc; ++a )
+  {
+    if( strcmp( argv[a], "--csv") == 0 )
+      isCsv = true;
+    else if( strcmp( argv[a], "--xvfb") == 0 )
+      useXvfb = true;
+    else if( strcmp( argv[a], "--runs") == 0 && a + 1 < argc && atoi( argv[a+1]) > 0 )
+      gNumRuns = atoi( argv[++a]);
+    else
+    {
+      fprintf( stderr, "Usage: %s [--csv] [--xvfb] [--runs <n>]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  gReport.AddSetting( "runs", gNumRuns);
+  MeasureVirtual();
+#if SNIIS_SYSTEM_LINUX
+  MeasureLinux( useXvfb);
+#else
+  (void) useXvfb;
+#endif
+
+  if( isCsv )
+    gReport.PrintCsv();
+  else
+    gReport.PrintJson();
+  return 0;
+}
@@ -0,0 +1,13 @@
+# Timings of creating and destroying input systems. Prints JSON, or CSV with --csv. Pass --xvfb to measure LinuxInput
+# on a private Xvfb.
+
+TEMPLATE = app
+CONFIG += console c++14
+CONFIG -= app_bundle qt
+TARGET = sniis_startup
+
+include(../../sniis.pri)
+
+SOURCES += sniis_startup.cpp
+HEADERS += ../common/ResultReporter.h
+unix:!macx: HEADERS += ../common/XvfbServer.h
@@ -0,0 +1,12 @@
+# Test and benchmark programs. Each one builds the SNIIS sources in directly, see sniis.pri.
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    alloc \
+    bench \
+    golden \
+    startup
+
+# Opt-in, needs Xvfb at runtime and libXtst to build
+unix:!macx:sniis_xvfb: SUBDIRS += xvfb
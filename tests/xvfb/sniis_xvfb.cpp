@@ -0,0 +1,243 @@
+/// @file sniis_xvfb.cpp
+/// End-to-end measurement of the Linux backend on a private Xvfb: injects bursts of key presses, mouse clicks and
+/// mouse movement through XTest, runs LinuxInput::Update() until all of it arrived at the handler, and reports events
+/// per second and the latency from injection to the handler call as percentiles, in a LatencyHistogram. Also reports
+/// SNIIS' own latency tracking from the X server timestamps. Prints JSON in the format described in ResultReporter.h.
+/// Opt-in: it needs Xvfb and the XTest extension, and exits with 77 (skipped) if they're not there.
+/// Options: --bursts <n> bursts per kind of input, default 20; --burst-size <n> events per burst, default 100;
+/// --display to use the current $DISPLAY instead of starting Xvfb.
+
+#include "SNIIS.h"
+#include "SNIIS_Linux.h"
+#include "../common/ResultReporter.h"
+#include "../common/XvfbServer.h"
+
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace SNIIS;
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+const int SkipExitCode = 77;
+const double BurstTimeout = 2.0; ///< seconds to wait for a burst to arrive before counting the rest as lost
+
+/// Notes the time each input arrives at, per kind of input. Movement counts each pixel as one arrival, because the
+/// backend merges all movement of an Update() into one call.
+struct Handler : public InputHandler
+{
+  std::vector<Clock::time_point> mKeys, mButtons, mMotion;
+  double mMotionSum = 0.0; ///< pixels moved in total, for splitting the calls into single pixels
+
+  bool OnKey( Keyboard*, SNIIS::KeyCode, bool) override { mKeys.push_back( Clock::now()); return true; }
+  bool OnMouseButton( Mouse*, size_t btnIndex, bool) override
+  {
+    if( btnIndex == MB_Left )
+      mButtons.push_back( Clock::now());
+    return true;
+  }
+  bool OnMouseMoved( Mouse* mouse, float, float) override
+  {
+    auto now = Clock::now();
+    mMotionSum += std::fabs( mouse->GetRelMouseX());
+    while( double( mMotion.size()) + 0.5 < mMotionSum )
+      mMotion.push_back( now);
+    return true;
+  }
+};
+
+struct Result
+{
+  const char* mName;
+  size_t mNumInjected = 0, mNumArrived = 0;
+  double mSeconds = 0.0; ///< from the first injection to the last arrival, summed over all bursts
+  double mUpdateSeconds = 0.0; ///< time spent in Update() only
+  LatencyHistogram mLatency; ///< injection to handler call, in microseconds
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Injects one burst through inject( i) for i in [0, count), then updates until all of it arrived in the given list of
+// arrival times, or until the timeout. Arrivals are matched to injections in order.
+template <typename Inject>
+void RunBurst( Display* dpy, LinuxInput* sys, Result& res, std::vector<Clock::time_point>& arrivals, size_t count,
+  Inject&& inject)
+{
+  arrivals.clear();
+  std::vector<Clock::time_point> injected( count);
+  auto start = Clock::now();
+  for( size_t a = 0; a < count; ++a )
+  {
+    injected[a] = Clock::now();
+    inject( a);
+  }
+  XFlush( dpy);
+
+  while( arrivals.size() < count && std::chrono::duration<double> (Clock::now() - start).count() < BurstTimeout )
+  {
+    auto updateStart = Clock::now();
+    sys->Update();
+    res.mUpdateSeconds += std::chrono::duration<double> (Clock::now() - updateStart).count();
+  }
+
+  size_t numArrived = std::min( arrivals.size(), count);
+  for( size_t a = 0; a < numArrived; ++a )
+    res.mLatency.Add( uint64_t( std::chrono::duration_cast<std::chrono::microseconds> (arrivals[a] - injected[a]).count()));
+  if( numArrived > 0 )
+    res.mSeconds += std::chrono::duration<double> (arrivals[numArrived-1] - start).count();
+  res.mNumInjected += count;
+  res.mNumArrived += numArrived;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Appends sample count and percentiles of a histogram as values named prefix_samples, prefix_p50 and so on
+void AddHistogram( std::vector<ResultValue>& values, const std::string& prefix, const LatencyHistogram& hist)
+{
+  values.push_back( ResultValue{ prefix + "_samples", double( hist.GetNumSamples()) });
+  values.push_back( ResultValue{ prefix + "_p50", double( hist.GetPercentile( 0.5)) });
+  values.push_back( ResultValue{ prefix + "_p90", double( hist.GetPercentile( 0.9)) });
+  values.push_back( ResultValue{ prefix + "_p99", double( hist.GetPercentile( 0.99)) });
+  values.push_back( ResultValue{ prefix + "_max", double( hist.GetMax()) });
+}
+
+int Skip( ResultReporter& report, const std::string& reason)
+{
+  report.Skip( "xvfb", {}, reason);
+  report.PrintJson();
+  return SkipExitCode;
+}
+} // namespace
+
+// --------------------------------------------------------------------------------------------------------------------
+int main( int argc, char** argv)
+{
+  size_t numBursts = 20, burstSize = 100;
+  bool useCurrentDisplay = false;
+  for( int a = 1; a < argc; ++a )
+  {
+    if( strcmp( argv[a], "--bursts") == 0 && a + 1 < argc && atoi( argv[a+1]) > 0 )
+      numBursts = size_t( atoi( argv[++a]));
+    else if( strcmp( argv[a], "--burst-size") == 0 && a + 1 < argc && atoi( argv[a+1]) > 1 )
+      burstSize = size_t( atoi( argv[++a])) & ~size_t( 1);
+    else if( strcmp( argv[a], "--display") == 0 )
+      useCurrentDisplay = true;
+    else
+    {
+      fprintf( stderr, "Usage: %s [--bursts <n>] [--burst-size <n>] [--display]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  ResultReporter report( "sniis_xvfb");
+  report.AddSetting( "bursts", double( numBursts));
+  report.AddSetting( "burst_size", double( burstSize));
+  XvfbServer xvfb;
+  std::string error;
+  if( !useCurrentDisplay && !xvfb.Start( error) )
+    return Skip( report, error);
+
+  // our own connection for injecting, LinuxInput opens its own
+  Display* dpy = XOpenDisplay( nullptr);
+  if( !dpy )
+    return Skip( report, "can't open the X display");
+  int eventBase = 0, errorBase = 0, major = 0, minor = 0;
+  if( !XTestQueryExtension( dpy, &eventBase, &errorBase, &major, &minor) )
+  {
+    XCloseDisplay( dpy);
+    return Skip( report, "no XTest extension");
+  }
+  Window wnd = XCreateSimpleWindow( dpy, DefaultRootWindow( dpy), 0, 0, 64, 64, 0, 0, 0);
+  XMapWindow( dpy, wnd);
+  XFlush( dpy);
+
+  InitOptions options;
+  options.mUseSyntheticDevices = true;
+  auto sys = dynamic_cast<LinuxInput*> (InputSystem::Create( (void*) wnd, options));
+  if( !sys || sys->GetNumMice() == 0 || sys->GetNumKeyboards() == 0 )
+  {
+    if( sys )
+      InputSystem::Destroy( sys);
+    XDestroyWindow( dpy, wnd);
+    XCloseDisplay( dpy);
+    return Skip( report, "no XTest mouse and keyboard found");
+  }
+
+  KeyRepeatCfg krc;
+  krc.enable = false;
+  sys->SetKeyRepeatCfg( krc);
+  sys->SetLatencyTrackingEnabled( true);
+  Handler handler;
+  sys->SetHandler( &handler);
+  // devices ignore whatever they find during their first update
+  sys->Update();
+  sys->Update();
+  sys->ClearLatencyHistograms();
+
+  ::KeyCode keycode = XKeysymToKeycode( dpy, XK_a);
+  int screenWidth = DisplayWidth( dpy, DefaultScreen( dpy));
+  Result keys, buttons, motion;
+  keys.mName = "keys"; buttons.mName = "buttons"; motion.mName = "motion";
+
+  for( size_t burst = 0; burst < numBursts; ++burst )
+  {
+    RunBurst( dpy, sys, keys, handler.mKeys, burstSize, [&]( size_t i)
+    {
+      XTestFakeKeyEvent( dpy, keycode, (i & 1) == 0, CurrentTime);
+    });
+    RunBurst( dpy, sys, buttons, handler.mButtons, burstSize, [&]( size_t i)
+    {
+      XTestFakeButtonEvent( dpy, 1, (i & 1) == 0, CurrentTime);
+    });
+
+    // single pixel steps from the left edge to the right, so that the screen edge never swallows one. Wait for the
+    // server to have moved the pointer, so the jump isn't counted as part of the burst.
+    XTestFakeMotionEvent( dpy, -1, 0, 100, CurrentTime);
+    XSync( dpy, False);
+    for( int a = 0; a < 3; ++a )
+      sys->Update();
+    handler.mMotionSum = 0.0;
+    size_t steps = std::min( burstSize, size_t( screenWidth - 1));
+    RunBurst( dpy, sys, motion, handler.mMotion, steps, [&]( size_t)
+    {
+      XTestFakeRelativeMotionEvent( dpy, 1, 0, CurrentTime);
+    });
+  }
+
+  report.AddSetting( "display", std::string( DisplayString( dpy)));
+  bool isComplete = true;
+  for( const Result* r : { &keys, &buttons, &motion } )
+  {
+    std::vector<ResultValue> values = { { "injected", double( r->mNumInjected) },
+      { "arrived", double( r->mNumArrived) }, { "seconds", r->mSeconds }, { "events_per_sec", r->mSeconds > 0.0 ? double( r->mNumArrived) / r->mSeconds : 0.0 },
+      { "update_seconds", r->mUpdateSeconds },
+      { "events_per_update_sec", r->mUpdateSeconds > 0.0 ? double( r->mNumArrived) / r->mUpdateSeconds : 0.0 } };
+    AddHistogram( values, "latency_us", r->mLatency);
+    report.Add( TestResult{ r->mName, {}, std::move( values), std::string() });
+    isComplete = isComplete && r->mNumArrived == r->mNumInjected;
+  }
+  // SNIIS' own measurement, from the X server timestamp of each input to it being signalled. Mouse covers both the
+  // clicks and the movement.
+  for( auto kind : { DeviceKind_Keyboard, DeviceKind_Mouse } )
+  {
+    std::vector<ResultValue> values;
+    AddHistogram( values, "latency_us", sys->GetLatencyHistogram( kind, Latency_Dispatch));
+    report.Add( TestResult{ kind == DeviceKind_Keyboard ? "sniis_dispatch_keyboard" : "sniis_dispatch_mouse", {},
+      std::move( values), std::string() });
+  }
+  report.PrintJson();
+
+  InputSystem::Destroy( sys);
+  XDestroyWindow( dpy, wnd);
+  XCloseDisplay( dpy);
+  return isComplete ? 0 : 1;
+}
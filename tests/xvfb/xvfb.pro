@@ -0,0 +1,13 @@
+# End-to-end throughput and latency of the Linux backend, driven through XTest on a private Xvfb. Prints JSON and
+# exits with 77 if Xvfb or XTest is missing. Needs libXtst; only built with "qmake CONFIG+=sniis_xvfb".
+
+TEMPLATE = app
+CONFIG += console c++14
+CONFIG -= app_bundle qt
+TARGET = sniis_xvfb
+
+include(../../sniis.pri)
+
+SOURCES += sniis_xvfb.cpp
+HEADERS += ../common/ResultReporter.h ../common/XvfbServer.h
+LIBS += -lXtst